@@ -0,0 +1,174 @@
+/**
+ * @file bench_runner.cpp
+ * @brief Times Scheme programs and reports the results as JSON
+ *
+ * Usage: bench_runner [--warmup N] [--reps N] file.scm...
+ *
+ * Each program is evaluated (without printing) in a fresh Interpreter
+ * N warmup times, which are not reported, and then --reps times (default
+ * 1 and 5). Only evaluation is timed: the file is read once up front, and
+ * creating and destroying the interpreter happens outside the clock. For
+ * every program the median, minimum and maximum wall time are printed,
+ * with the allocations and bytes of the last run (see stats.hpp; CMake
+ * links this program to a copy of libscheme built with SCHEME_STATS, and
+ * both are null when linked to one without the counters) and the printed
+ * value of its last form, so a change that breaks a program does not go
+ * unnoticed.
+ * The `bench` CMake target runs the suite in this directory; it refuses to
+ * run unless CMAKE_BUILD_TYPE is Release or RelWithDebInfo.
+ */
+
+#include "../src/interpreter.hpp"
+#include "../src/RE.hpp"
+#include "../src/stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Result {
+    std::string name;
+    std::vector<double> ms;
+    unsigned long long allocated;
+    unsigned long long bytes;
+    std::string value;
+    bool failed;
+};
+
+static bool readFile(const std::string &path, std::string &text) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+// "bench/fib.scm" -> "fib"
+static std::string baseName(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// 求值一次；只有求值本身计时
+static bool runOnce(const std::string &code, double &ms, StatTotals &allocs, std::string &value) {
+    Interpreter interp(-1);
+    StatTotals before = statTotals();
+    auto start = std::chrono::steady_clock::now();
+    Value v(nullptr);
+    try {
+        v = interp.eval(code);
+    } catch (const RuntimeError &e) {
+        value = "RuntimeError: " + e.message();
+        return false;
+    }
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    StatTotals after = statTotals();
+    allocs.allocated = after.allocated - before.allocated;
+    allocs.bytes = after.bytes - before.bytes;
+    std::ostringstream os;
+    v.show(os);
+    value = os.str();
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--warmup N] [--reps N] file.scm...\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int warmup = 1;
+    int reps = 5;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            reps = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Result> results;
+    bool all_ok = true;
+    for (const std::string &path : files) {
+        Result r;
+        r.name = baseName(path);
+        r.failed = false;
+        std::string code;
+        if (!readFile(path, code)) {
+            fprintf(stderr, "%s: cannot read %s\n", argv[0], path.c_str());
+            return 1;
+        }
+        fprintf(stderr, "%s ...\n", r.name.c_str());
+        for (int k = 0; k < warmup + reps && !r.failed; k++) {
+            double ms = 0;
+            StatTotals allocs = {0, 0};
+            r.failed = !runOnce(code, ms, allocs, r.value);
+            if (k >= warmup && !r.failed) {
+                r.ms.push_back(ms);
+                r.allocated = allocs.allocated;
+                r.bytes = allocs.bytes;
+            }
+        }
+        all_ok = all_ok && !r.failed;
+        results.push_back(r);
+    }
+
+    printf("{\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"benchmarks\": [\n", warmup, reps);
+    for (size_t i = 0; i < results.size(); i++) {
+        Result &r = results[i];
+        printf("    {\"name\": %s, ", jsonString(r.name).c_str());
+        if (r.failed) {
+            printf("\"error\": %s}", jsonString(r.value).c_str());
+        } else {
+            std::sort(r.ms.begin(), r.ms.end());
+            size_t n = r.ms.size();
+            double median = n % 2 ? r.ms[n / 2] : (r.ms[n / 2 - 1] + r.ms[n / 2]) / 2;
+            printf("\"median_ms\": %.3f, \"min_ms\": %.3f, \"max_ms\": %.3f, ", median, r.ms.front(), r.ms.back());
+            if (statsEnabled()) {
+                printf("\"allocations\": %llu, \"bytes\": %llu, ", r.allocated, r.bytes);
+            } else {
+                printf("\"allocations\": null, \"bytes\": null, ");
+            }
+            printf("\"result\": %s}", jsonString(r.value).c_str());
+        }
+        printf("%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+;; Closure-heavy code: counters, composition and higher-order list functions
+
+(define (make-counter)
+  (let ((n 0))
+    (lambda () (set! n (+ n 1)) n)))
+
+(define (compose f g) (lambda (x) (f (g x))))
+(define (adder k) (lambda (x) (+ x k)))
+
+(define (pipeline k)
+  (if (= k 0)
+      (lambda (x) x)
+      (compose (adder k) (pipeline (- k 1)))))
+
+(define (iota n)
+  (if (= n 0) '() (cons n (iota (- n 1)))))
+
+(define numbers (iota 500))
+
+(define (run n counter total)
+  (if (= n 0)
+      (list (counter) total)
+      (let ((f (pipeline 20)))
+        (counter)
+        (run (- n 1) counter
+             (+ total (fold-left + 0 (map f (filter (lambda (x) (< (modulo x 3) 2)) numbers))))))))
+
+(run 60 (make-counter) 0)
@@ -0,0 +1,18 @@
+;; Deep list building: long lists built and walked by non-tail recursion
+
+(define (build n)
+  (if (= n 0) '() (cons n (build (- n 1)))))
+
+(define (sum l)
+  (if (null? l) 0 (+ (car l) (sum (cdr l)))))
+
+(define (copy l)
+  (if (null? l) '() (cons (car l) (copy (cdr l)))))
+
+(define (round n total)
+  (if (= n 0)
+      total
+      (let ((l (build 8000)))
+        (round (- n 1) (+ total (sum (copy (reverse l))) (length l))))))
+
+(round 4 0)
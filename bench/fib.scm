@@ -0,0 +1,8 @@
+;; Doubly recursive fib: procedure calls and small-integer arithmetic
+
+(define (fib n)
+  (if (< n 2)
+      n
+      (+ (fib (- n 1)) (fib (- n 2)))))
+
+(fib 25)
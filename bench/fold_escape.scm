@@ -0,0 +1,25 @@
+;; Early exit from a deep recursive fold with call/ec
+;; The element searched for sits at the bottom of a 5000-deep recursion;
+;; the continuation unwinds all the pending (+ x ...) frames at once.
+;; Compare with fold_flags.scm, which returns a marker through every frame.
+
+(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))
+(define data (range 5000))
+
+(define (fold-until l stop k)
+  (if (null? l)
+      0
+      (if (= (car l) stop)
+          (k 'found)
+          (+ (car l) (fold-until (cdr l) stop k)))))
+
+(define (search stop) (call/ec (lambda (k) (fold-until data stop k))))
+
+(define (repeat n)
+  (if (= n 0)
+      'done
+      (begin (search 1) (repeat (- n 1)))))
+
+(repeat 200)
+(search 1)
+(search 0)
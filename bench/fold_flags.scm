@@ -0,0 +1,27 @@
+;; Early exit from a deep recursive fold without continuations
+;; Same search as fold_escape.scm, but the marker is checked and passed
+;; back by every one of the 5000 pending frames.
+
+(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))
+(define data (range 5000))
+
+(define (fold-until l stop)
+  (if (null? l)
+      0
+      (if (= (car l) stop)
+          'found
+          (let ((rest (fold-until (cdr l) stop)))
+            (if (eq? rest 'found)
+                'found
+                (+ (car l) rest))))))
+
+(define (search stop) (fold-until data stop))
+
+(define (repeat n)
+  (if (= n 0)
+      'done
+      (begin (search 1) (repeat (- n 1)))))
+
+(repeat 200)
+(search 1)
+(search 0)
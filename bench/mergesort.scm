@@ -0,0 +1,53 @@
+;; The merge sort of score/data/114.in on a longer pseudo-random list
+
+(define (random-list n seed)
+  (if (= n 0)
+      '()
+      (cons seed (random-list (- n 1) (modulo (+ (* seed 1103) 12345) 65536)))))
+
+(define data (random-list 3000 42))
+
+(define (sorted l)
+  (letrec ((merge (lambda (ls ls2)
+                    (if (null? ls)
+                        ls2
+                        (if (null? ls2)
+                            ls
+                            (if (< (car ls) (car ls2))
+                                (cons (car ls) (merge (cdr ls) ls2))
+                                (cons (car ls2) (merge ls (cdr ls2))))))))
+           (sort (lambda (ls)
+                   (if (null? ls)
+                       ls
+                       (if (null? (cdr ls))
+                           ls
+                           (let ((halves (halves
+                                           ls
+                                           (quote ())
+                                           (quote ())
+                                           #t)))
+                             (let ((first (car halves))
+                                   (second (car (cdr halves))))
+                               (merge (sort first) (sort second))))))))
+           (halves (lambda (ls first second first?)
+                     (if (null? ls)
+                         (cons first (cons second (quote ())))
+                         (if first?
+                             (halves
+                               (cdr ls)
+                               (cons (car ls) first)
+                               second
+                               #f)
+                             (halves
+                               (cdr ls)
+                               first
+                               (cons (car ls) second)
+                               #t))))))
+    (sort l)))
+
+(define (repeat n)
+  (if (= n 1)
+      (sorted data)
+      (begin (sorted data) (repeat (- n 1)))))
+
+(car (repeat 3))
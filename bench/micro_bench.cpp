@@ -0,0 +1,273 @@
+/**
+ * @file micro_bench.cpp
+ * @brief Microbenchmarks of interpreter internals: ns/op and allocations/op
+ *
+ * Usage: micro_bench [--time MS] [--list] [filter...]
+ *
+ * Runs every benchmark whose name contains one of the filters (all of them
+ * when none is given). Each one is calibrated by doubling its iteration
+ * count, then run for about MS milliseconds (default 200); the table gives
+ * nanoseconds and value allocations (see stats.hpp; CMake links this
+ * program to a copy of libscheme built with SCHEME_STATS, "-" when linked
+ * to one without the counters) per operation. Building the inputs of a benchmark is
+ * neither timed nor counted. For readSyntax an operation is one KB
+ * of input and for Pair::show one list element.
+ *
+ * For an A/B comparison build both trees and run the same filter, e.g.
+ *   micro_bench find extend
+ */
+
+#include "../src/interpreter.hpp"
+#include "../src/expr.hpp"
+#include "../src/syntax.hpp"
+#include "../src/stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::function<void(long)> Body;   ///< Runs the operation n times
+
+struct Bench {
+    std::string name;
+    double items;                       ///< Operations per iteration of the body
+    std::function<Body()> setup;        ///< Builds the inputs (untimed) and returns the body
+};
+
+// 结果写到这里，免得被优化掉
+static Value sink(nullptr);
+
+// 丢弃一切输出的 streambuf
+struct NullBuf : std::streambuf {
+    virtual int overflow(int c) override { return c; }
+    virtual std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+static Expr parseOne(const std::string &code, Assoc &env) {
+    MemoryStreamBuf buf(code.data(), code.size());
+    std::istream is(&buf);
+    return readSyntax(is)->parse(env);
+}
+
+// 名字 v0..v(n-1) 依次绑定，v0 在链尾
+static Assoc chain(int n) {
+    Assoc env = empty();
+    for (int i = 0; i < n; i++) {
+        env = extend("v" + std::to_string(i), IntegerV(i), env);
+    }
+    return env;
+}
+
+static void addEnvBenches(std::vector<Bench> &benches) {
+    for (int n : {1, 8, 64, 512}) {
+        benches.push_back(Bench{"find/" + std::to_string(n), 1, [n]() -> Body {
+            Assoc env = chain(n);
+            std::string deepest = "v0";
+            return [env, deepest](long iters) mutable {
+                for (long i = 0; i < iters; i++) {
+                    sink = find(deepest, env);
+                }
+            };
+        }});
+        benches.push_back(Bench{"extend/" + std::to_string(n), 1, [n]() -> Body {
+            Assoc env = chain(n);
+            Value v = IntegerV(1);
+            return [env, v](long iters) mutable {
+                for (long i = 0; i < iters; i++) {
+                    Assoc e = extend("x", v, env);
+                }
+            };
+        }});
+    }
+}
+
+static void addApplyBenches(std::vector<Bench> &benches, Interpreter &interp) {
+    interp.eval("(define (f0) 0) (define (f1 a) a) (define (f2 a b) a)"
+                "(define (f3 a b c) a) (define (f4 a b c d) a)");
+    const char *calls[] = {"(f0)", "(f1 1)", "(f2 1 2)", "(f3 1 2 3)", "(f4 1 2 3 4)"};
+    for (int k = 0; k <= 4; k++) {
+        std::string code = calls[k];
+        benches.push_back(Bench{"apply/" + std::to_string(k), 1, [&interp, code]() -> Body {
+            Expr call = parseOne(code, interp.global_env);
+            return [&interp, call](long iters) {
+                Assoc &env = interp.global_env;
+                for (long i = 0; i < iters; i++) {
+                    sink = call->eval(env);
+                }
+            };
+        }});
+    }
+}
+
+static void addPlusBenches(std::vector<Bench> &benches) {
+    benches.push_back(Bench{"plus/int+int", 1, []() -> Body {
+        std::shared_ptr<Plus> plus = std::make_shared<Plus>(Expr(new Var("a")), Expr(new Var("b")));
+        Value a = IntegerV(3), b = IntegerV(4);
+        return [plus, a, b](long iters) {
+            for (long i = 0; i < iters; i++) {
+                sink = plus->evalRator(a, b);
+            }
+        };
+    }});
+    benches.push_back(Bench{"plus/int+rational", 1, []() -> Body {
+        std::shared_ptr<Plus> plus = std::make_shared<Plus>(Expr(new Var("a")), Expr(new Var("b")));
+        Value a = IntegerV(3), b = RationalV(1, 3);
+        return [plus, a, b](long iters) {
+            for (long i = 0; i < iters; i++) {
+                sink = plus->evalRator(a, b);
+            }
+        };
+    }});
+}
+
+static void addQuoteBenches(std::vector<Bench> &benches, Interpreter &interp) {
+    const char *quotes[][2] = {
+        {"quote/flat-8", "(quote (1 2 3 4 5 6 7 8))"},
+        {"quote/nested", "(quote ((1 2) (3 (4 5)) (a (b (c (d)))) \"s\" #t ((((6))))))"},
+    };
+    for (auto &q : quotes) {
+        std::string code = q[1];
+        benches.push_back(Bench{q[0], 1, [&interp, code]() -> Body {
+            Expr quote = parseOne(code, interp.global_env);
+            return [&interp, quote](long iters) {
+                for (long i = 0; i < iters; i++) {
+                    sink = quote->eval(interp.global_env);
+                }
+            };
+        }});
+    }
+}
+
+// 约 1 KB 的典型源代码
+static std::string sourceKB() {
+    std::string one = "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+                      "(let ((xs (quote (1 2 3 \"four\" #t five)))) (map car (list xs xs)))\n";
+    std::string text;
+    while (text.size() + one.size() <= 1024) {
+        text += one;
+    }
+    return text;
+}
+
+static void addReadBenches(std::vector<Bench> &benches) {
+    static const std::string text = sourceKB();
+    benches.push_back(Bench{"readSyntax/KB", text.size() / 1024.0, []() -> Body {
+        return [](long iters) {
+            for (long i = 0; i < iters; i++) {
+                MemoryStreamBuf buf(text.data(), text.size());
+                std::istream is(&buf);
+                while (readSpace(is).peek() != EOF) {
+                    Syntax stx = readSyntax(is);
+                }
+            }
+        };
+    }});
+}
+
+static void addShowBenches(std::vector<Bench> &benches) {
+    const int n = 1000;
+    benches.push_back(Bench{"show/pair-element", n, [n]() -> Body {
+        Value list = NullV();
+        for (int i = 0; i < n; i++) {
+            list = PairV(IntegerV(i), list);
+        }
+        return [list](long iters) mutable {
+            NullBuf buf;
+            std::ostream os(&buf);
+            for (long i = 0; i < iters; i++) {
+                list.show(os);
+            }
+        };
+    }});
+}
+
+static bool selected(const std::string &name, const std::vector<std::string> &filters) {
+    if (filters.empty()) {
+        return true;
+    }
+    for (const std::string &f : filters) {
+        if (name.find(f) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static double elapsedNs(const Body &body, long iters) {
+    auto start = std::chrono::steady_clock::now();
+    body(iters);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--time MS] [--list] [filter...]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    double target_ms = 200;
+    bool list = false;
+    std::vector<std::string> filters;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            target_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    Interpreter interp(-1);
+    InterpreterScope scope(interp);
+    std::vector<Bench> benches;
+    addEnvBenches(benches);
+    addApplyBenches(benches, interp);
+    addPlusBenches(benches);
+    addQuoteBenches(benches, interp);
+    addReadBenches(benches);
+    addShowBenches(benches);
+
+    if (!list) {
+        printf("%-22s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+    }
+    for (const Bench &b : benches) {
+        if (!selected(b.name, filters)) {
+            continue;
+        }
+        if (list) {
+            printf("%s\n", b.name.c_str());
+            continue;
+        }
+        // 准备输入不计时，也不计入分配；之后每次只运行 body
+        Body body = b.setup();
+        // 迭代次数翻倍直到够长，再按比例放大到目标时间
+        long iters = 1;
+        double ns = elapsedNs(body, iters);
+        while (ns < target_ms * 1e5 && iters < (1L << 40)) {
+            iters *= 2;
+            ns = elapsedNs(body, iters);
+        }
+        iters = std::max(1L, static_cast<long>(iters * (target_ms * 1e6 / ns)));
+        StatTotals before = statTotals();
+        ns = elapsedNs(body, iters);
+        StatTotals after = statTotals();
+        double ops = iters * b.items;
+        printf("%-22s %12ld %12.1f", b.name.c_str(), iters, ns / ops);
+        if (statsEnabled()) {
+            printf(" %12.2f\n", (after.allocated - before.allocated) / ops);
+        } else {
+            printf(" %12s\n", "-");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+;; Counts the solutions of the n-queens problem by backtracking over lists
+
+(define (ok? row dist placed)
+  (if (null? placed)
+      #t
+      (and (not (= (car placed) (+ row dist)))
+           (not (= (car placed) (- row dist)))
+           (ok? row (+ dist 1) (cdr placed)))))
+
+(define (queens n)
+  (letrec ((try-rows (lambda (rows left placed)
+                       (if (null? rows)
+                           0
+                           (+ (if (ok? (car rows) 1 placed)
+                                  (place (append left (cdr rows)) (cons (car rows) placed))
+                                  0)
+                              (try-rows (cdr rows) (cons (car rows) left) placed)))))
+           (place (lambda (rows placed)
+                    (if (null? rows)
+                        1
+                        (try-rows rows '() placed))))
+           (iota (lambda (k)
+                   (if (= k 0) '() (cons k (iota (- k 1)))))))
+    (place (iota n) '())))
+
+(queens 9)
@@ -0,0 +1,33 @@
+;; String building: appends, number->string and substring in nested loops
+;; (the loops are nested because recursion is not tail-call optimized)
+
+(define (line i)
+  (string-append "item-" (number->string i) ";"))
+
+(define (build-row i n acc)
+  (if (= n 0)
+      acc
+      (build-row (+ i 1) (- n 1) (string-append acc (line i)))))
+
+(define (build rows acc)
+  (if (= rows 0)
+      acc
+      (build (- rows 1) (build-row (* rows 1000) 200 acc))))
+
+(define text (build 40 ""))
+
+(define (count-semis s i n)
+  (if (= i (string-length s))
+      n
+      (count-semis s (+ i 1) (if (string=? (substring s i (+ i 1)) ";") (+ n 1) n))))
+
+(define (min-end s n)
+  (if (> n (string-length s)) (string-length s) n))
+
+(define (check s from)
+  (if (>= from (string-length s))
+      0
+      (+ (count-semis (substring s from (min-end s (+ from 2000))) 0 0)
+         (check s (+ from 2000)))))
+
+(list (string-length text) (check text 0))
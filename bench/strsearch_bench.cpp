@@ -0,0 +1,95 @@
+/**
+ * @file strsearch_bench.cpp
+ * @brief Compares the string kernels with plain byte loops on large inputs
+ *
+ * Usage: strsearch_bench [megabytes]   (default 8)
+ *
+ * The haystack is pseudo-random lowercase text with the searched byte and
+ * pattern placed only at the very end, so every run scans the whole input.
+ */
+
+#include "../src/strsearch.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static size_t loopFindByte(const char *p, size_t n, char c) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == c) return i;
+    }
+    return std::string::npos;
+}
+
+static size_t loopFindBytes(const char *hay, size_t n, const char *needle, size_t m) {
+    for (size_t i = 0; i + m <= n; i++) {
+        size_t j = 0;
+        while (j < m && hay[i + j] == needle[j]) j++;
+        if (j == m) return i;
+    }
+    return std::string::npos;
+}
+
+static bool loopEqual(const char *a, const char *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+// 取若干次运行中最快的一次，返回 GB/s
+template <typename F>
+static double bestRate(size_t bytes, F f) {
+    double best = 1e30;
+    for (int rep = 0; rep < 7; rep++) {
+        auto t0 = std::chrono::steady_clock::now();
+        volatile size_t sink = f();
+        (void)sink;
+        auto t1 = std::chrono::steady_clock::now();
+        double s = std::chrono::duration<double>(t1 - t0).count();
+        if (s < best) best = s;
+    }
+    return bytes / best / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    size_t mb = argc > 1 ? strtoul(argv[1], nullptr, 10) : 8;
+    size_t n = mb << 20;
+    std::string hay(n, 'a');
+    unsigned seed = 12345;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        hay[i] = 'a' + (seed >> 16) % 26;
+    }
+    const std::string needle = "needle-in-a-haystack";
+    hay.replace(n - needle.size(), needle.size(), needle);
+    std::string copy = hay;
+    const char *h = hay.data();
+
+    printf("input: %zu MB, default kernels: %s\n", mb, stringKernelName());
+    printf("%-10s %14s %14s %14s\n", "kernel", "index GB/s", "search GB/s", "equal GB/s");
+    printf("%-10s %14.2f %14.2f %14.2f\n", "byte-loop",
+           bestRate(n, [&]() { return loopFindByte(h, n, '-'); }),
+           bestRate(n, [&]() { return loopFindBytes(h, n, needle.data(), needle.size()); }),
+           bestRate(n, [&]() { return (size_t)loopEqual(h, copy.data(), n); }));
+    const char *names[] = {"scalar", "sse2", "avx2"};
+    for (const char *name : names) {
+        if (!selectStringKernels(name)) {
+            printf("%-10s %14s\n", name, "unsupported");
+            continue;
+        }
+        size_t a = findByte(h, n, '-');
+        size_t b = findBytes(h, n, needle.data(), needle.size());
+        if (a != n - needle.size() + 6 || b != n - needle.size() || !bytesEqual(h, copy.data(), n)) {
+            printf("%-10s wrong result\n", name);
+            return 1;
+        }
+        printf("%-10s %14.2f %14.2f %14.2f\n", name,
+               bestRate(n, [&]() { return findByte(h, n, '-'); }),
+               bestRate(n, [&]() { return findBytes(h, n, needle.data(), needle.size()); }),
+               bestRate(n, [&]() { return (size_t)bytesEqual(h, copy.data(), n); }));
+    }
+    return 0;
+}
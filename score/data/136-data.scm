@@ -0,0 +1,4 @@
+; data for read
+(define (f x) [list x "s]t" 'q])
+42 -7/3 #t sym "a\"b"
+(1 (2 (3 (4 . 5))) ())
@@ -0,0 +1,148 @@
+/**
+ * @file embed_test.cpp
+ * @brief Tests of the embedding API (interpreter.hpp) through libscheme
+ *
+ * Usage: embed_test
+ *
+ * Checks eval, lookup, call, define and defineNative, errors thrown out of
+ * each, that a quiet evalBuffer reports no errors (not even those of event
+ * callbacks and green threads), and that two instances do not share
+ * globals. Prints each failed
+ * check and exits with status 1 if there was any.
+ */
+
+#include "../src/interpreter.hpp"
+#include "../src/RE.hpp"
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static std::string show(Value v) {
+    std::ostringstream os;
+    v.show(os);
+    return os.str();
+}
+
+static void expectText(const std::string &what, const std::string &got, const std::string &expected) {
+    if (got != expected) {
+        printf("FAIL %s: expected %s, got %s\n", what.c_str(), expected.c_str(), got.c_str());
+        failures++;
+    }
+}
+
+static void expect(const std::string &what, const Value &v, const std::string &printed) {
+    expectText(what, show(v), printed);
+}
+
+// f 应当抛出 RuntimeError
+template <typename F>
+static void expectError(const std::string &what, F f) {
+    try {
+        f();
+    } catch (const RuntimeError &) {
+        return;
+    }
+    printf("FAIL %s: no RuntimeError\n", what.c_str());
+    failures++;
+}
+
+static void testEval() {
+    Interpreter interp(-1);
+    expect("eval returns the last value", interp.eval("(define x 20) (+ x 22)"), "42");
+    expect("eval keeps globals", interp.eval("x"), "20");
+    expect("eval of nothing", interp.eval(""), "#<void>");
+    expectError("eval of an unbound variable", [&]() { interp.eval("undefined-name"); });
+    expectError("eval of an unterminated form", [&]() { interp.eval("(+ 1"); });
+    expectError("eval of a stray )", [&]() { interp.eval("1 )"); });
+    expectText("eval prints nothing", interp.output(), "");
+    interp.eval("(display \"hi\")");
+    expectText("display goes to the string port", interp.output(), "hi");
+}
+
+static void testQuiet() {
+    const std::string code = "(after 0 (lambda () (car '()))) (spawn (lambda () (car '()))) (car '()) 1";
+    Interpreter loud(-1), quiet(-1);
+    {
+        InterpreterScope scope(loud);
+        loud.evalBuffer(code.data(), code.size(), false);
+    }
+    {
+        InterpreterScope scope(quiet);
+        quiet.evalBuffer(code.data(), code.size(), true);
+    }
+    expectText("errors are reported", loud.output(), "\n\nRuntimeError\n1\nRuntimeError\nRuntimeError\n");
+    expectText("quiet reports no errors", quiet.output(), "");
+}
+
+static void testCall() {
+    Interpreter interp(-1);
+    interp.eval("(define (add a b) (+ a b)) (define (boom) (car '()))");
+    std::vector<Value> args;
+    args.push_back(IntegerV(1));
+    args.push_back(IntegerV(2));
+    expect("call by name", interp.call("add", args), "3");
+    const std::vector<Value> &same = args;
+    expect("call a procedure value", interp.call(interp.lookup("add"), same), "3");
+    expect("call a primitive", interp.call(interp.lookup("*"), same), "2");
+    expect("arguments are left alone", args[0], "1");
+    expectError("call with too few arguments", [&]() { interp.call("add", std::vector<Value>()); });
+    expectError("call of an unbound name", [&]() { interp.call("nope", args); });
+    expectError("error inside the callee", [&]() { interp.call("boom", std::vector<Value>()); });
+    expectError("call of a non-procedure", [&]() { interp.call(IntegerV(3), args); });
+}
+
+static void testNative() {
+    Interpreter interp(-1);
+    int calls = 0;
+    interp.defineNative("c-sum", 0, -1, [&calls](const Value *args, size_t n) -> Value {
+        calls++;
+        int sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (args[i]->v_type != V_INT) {
+                throw RuntimeError("c-sum: integers expected");
+            }
+            sum += static_cast<Integer*>(args[i].get())->n;
+        }
+        return IntegerV(sum);
+    });
+    interp.defineNative("c-nothing", 1, 1, [](const Value *, size_t) { return Value(nullptr); });
+    expect("native with no arguments", interp.eval("(c-sum)"), "0");
+    expect("native from Scheme", interp.eval("(c-sum 1 2 3 4)"), "10");
+    expect("native passed to map", interp.eval("(map c-sum '(1 2) '(10 20))"), "(11 22)");
+    expect("native returning null", interp.eval("(c-nothing 1)"), "#<void>");
+    if (calls != 4) {
+        printf("FAIL native call count: expected 4, got %d\n", calls);
+        failures++;
+    }
+    expectError("native arity", [&]() { interp.eval("(c-nothing)"); });
+    expectError("native throwing", [&]() { interp.eval("(c-sum 1 #t)"); });
+    expect("native can be redefined from Scheme", interp.eval("(define (c-sum x) 'scheme) (c-sum 1)"), "scheme");
+}
+
+static void testInstances() {
+    Interpreter a(-1), b(-1);
+    a.eval("(define shared 'a)");
+    b.define("shared", IntegerV(2));
+    b.defineNative("only-in-b", 0, 0, [](const Value *, size_t) { return IntegerV(1); });
+    expect("instance a keeps its binding", a.eval("shared"), "a");
+    expect("instance b keeps its binding", b.eval("shared"), "2");
+    expectError("natives stay in their instance", [&]() { a.eval("(only-in-b)"); });
+    a.eval("(display 1)");
+    b.eval("(display 2)");
+    expectText("outputs stay apart", a.output() + b.output(), "12");
+}
+
+int main() {
+    testEval();
+    testQuiet();
+    testCall();
+    testNative();
+    testInstances();
+    if (failures == 0) {
+        printf("embed_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file pipeline_test.cpp
+ * @brief Tests of the parse-ahead pipeline (pipeline.hpp) through libscheme
+ *
+ * Usage: pipeline_test
+ *
+ * Evaluates generated sources large enough for the pipeline (4 KiB and up)
+ * once serially and once with parse_ahead, and sources of 1 MiB and more
+ * also with reader threads (loader.hpp), and checks that the outputs are
+ * the same: brackets inside strings, [ ] lists, a global that shadows a
+ * primitive after forms using it were parsed ahead, and input that ends
+ * in a form that does not read. Prints each failed check and exits with
+ * status 1 if there was any.
+ */
+
+#include "../src/interpreter.hpp"
+#include <cstdio>
+#include <string>
+
+static int failures = 0;
+
+static void check(const std::string &what, bool ok) {
+    if (!ok) {
+        printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// 用给定的设置求值 code，返回全部输出
+static std::string run(const std::string &code, bool parse_ahead, unsigned read_threads = 0) {
+    Interpreter interp(-1);
+    InterpreterScope scope(interp);
+    interp.parse_ahead = parse_ahead;
+    interp.read_threads = read_threads;
+    interp.evalBuffer(code.data(), code.size(), false);
+    return interp.output();
+}
+
+// 约 bytes 字节的普通表达式，字符串里夹着括号
+static std::string filler(size_t bytes) {
+    std::string text = "(define (sq x) (* x x))\n";
+    for (int i = 0; text.size() < bytes; i++) {
+        std::string n = std::to_string(i);
+        text += "(sq " + n + ") (display \"]" + n + ")(\") (newline) (car '[" + n + "])\n";
+    }
+    return text;
+}
+
+static void expectSame(const std::string &what, const std::string &code) {
+    std::string serial = run(code, false);
+    check(what + ": parse-ahead output differs", run(code, true) == serial);
+    if (code.size() >= (1 << 20)) {
+        check(what + ": reader-thread output differs", run(code, true, 2) == serial);
+    }
+    check(what + ": empty output", !serial.empty());
+}
+
+int main() {
+    std::string body = filler(1 << 13);
+    expectSame("plain forms", body);
+    expectSame("shadowed primitive",
+               body + "(define (f) (car '(1 2)))\n(f)\n(define (car x) 'mine)\n(f) (car 1)\n" + body);
+
+    std::string stray = body + "(display \"before\")\n)\n(display \"after\")\n" + body;
+    expectSame("stray )", stray);
+    std::string out = run(stray, true);
+    check("stray ): reported", out.find("before\nRuntimeError\n") != std::string::npos);
+    check("stray ): input ends there", out.find("after") == std::string::npos);
+
+    expectSame("unterminated list", body + "(display (+ 1");
+    expectSame("unterminated string", body + "(display \"abc");
+    check("unterminated list: reported", run(body + "(+ 1", true).find("RuntimeError") != std::string::npos);
+
+    std::string big = filler((1 << 20) + (1 << 16));
+    expectSame("parallel read", big);
+    expectSame("parallel read, stray ) at the end", big + ")\n(display \"after\")\n");
+    expectSame("parallel read, unterminated", big + "(display \"abc");
+    // 括号是配平的，照常切块；最后一块读到一半出错
+    expectSame("parallel read, quote at the end", big + "(display 1) '");
+    // 不配对的右括号落在某一块中间：整个输入交给一个读取线程
+    expectSame("parallel read, stray ) inside", big + ")\n" + big);
+
+    if (failures == 0) {
+        printf("pipeline_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
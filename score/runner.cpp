@@ -0,0 +1,148 @@
+/**
+ * @file runner.cpp
+ * @brief Runs test scripts concurrently, one interpreter instance each
+ *
+ * Usage: runner [-j threads] dir...
+ *
+ * Every dir/N.in that has a matching dir/N.out is evaluated in its own
+ * Interpreter with output captured in a string port, and the output is
+ * compared with N.out the way diff -b does (runs of blanks are equal,
+ * trailing blanks are ignored). Tests run on a pool of threads (default:
+ * one per core) inside this single process, instead of one process each.
+ * (command-line) in a test is its script path, as when run by code.
+ */
+
+#include "../src/interpreter.hpp"
+#include "../src/RE.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Test {
+    std::string name;   // dir/N
+    long number;
+    bool passed;
+};
+
+// 逐行比较，行内空白串视为一个空格，忽略行尾空白（同 diff -b）
+static std::vector<std::string> normalizedLines(const std::string &text) {
+    std::vector<std::string> lines;
+    std::string line;
+    bool blank = false;
+    for (size_t i = 0; i <= text.size(); i++) {
+        char c = i < text.size() ? text[i] : '\n';
+        if (c == '\n') {
+            lines.push_back(line);
+            line.clear();
+            blank = false;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            blank = true;
+        } else {
+            if (blank && !line.empty()) line.push_back(' ');
+            blank = false;
+            line.push_back(c);
+        }
+    }
+    if (!lines.empty() && lines.back().empty() && !text.empty() && text.back() == '\n')
+        lines.pop_back();
+    return lines;
+}
+
+static bool readFile(const std::string &path, std::string &text) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+static bool runTest(const Test &test) {
+    std::string expected;
+    if (!readFile(test.name + ".out", expected)) return false;
+    Interpreter interp(-1);
+    InterpreterScope scope(interp);
+    interp.command_line = PairV(StringV(test.name + ".in"), NullV()); // 同 code 的 (command-line)
+    try {
+        Value script = OpenInputFileV(test.name + ".in");
+        InputPort *port = static_cast<InputPort*>(script.get());
+        interp.evalBuffer(port->data, port->size, false);
+    } catch (const RuntimeError &) {
+        return false;
+    }
+    return normalizedLines(interp.output()) == normalizedLines(expected);
+}
+
+static void collect(const std::string &dir, std::vector<Test> &tests) {
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) {
+        std::fprintf(stderr, "runner: cannot open %s\n", dir.c_str());
+        return;
+    }
+    std::vector<Test> found;
+    while (dirent *e = readdir(d)) {
+        std::string file = e->d_name;
+        if (file.size() < 4 || file.compare(file.size() - 3, 3, ".in") != 0) continue;
+        Test test;
+        test.name = dir + "/" + file.substr(0, file.size() - 3);
+        test.number = std::strtol(file.c_str(), nullptr, 10);
+        test.passed = false;
+        std::ifstream out((test.name + ".out").c_str());
+        if (out) found.push_back(test);
+    }
+    closedir(d);
+    std::sort(found.begin(), found.end(), [](const Test &a, const Test &b) {
+        return a.number != b.number ? a.number < b.number : a.name < b.name;
+    });
+    tests.insert(tests.end(), found.begin(), found.end());
+}
+
+int main(int argc, char *argv[]) {
+    std::ios::sync_with_stdio(false);
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> dirs;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else {
+            dirs.push_back(argv[i]);
+        }
+    }
+    if (dirs.empty()) {
+        std::fprintf(stderr, "usage: %s [-j threads] dir...\n", argv[0]);
+        return 2;
+    }
+    std::vector<Test> tests;
+    for (auto &dir : dirs) collect(dir, tests);
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < tests.size())
+            tests[i].passed = runTest(tests[i]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads && t < tests.size(); t++)
+        pool.push_back(std::thread(work));
+    work();
+    for (auto &t : pool) t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t passed = 0;
+    for (auto &test : tests) {
+        if (test.passed) passed++;
+        else std::printf("Wrong answer in %s\n", test.name.c_str());
+    }
+    std::printf("passed %zu/%zu in %.3f s on %u threads\n", passed, tests.size(), secs, threads);
+    return passed == tests.size() ? 0 : 1;
+}
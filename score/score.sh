@@ -7,7 +7,7 @@ echo "--------------------------------------------------------------------------
 cd "$(dirname "$0")"
 
 L=1
-R=118
+R=136
 for ((i = $L; i <= $R; i = i + 1))
 do
     echo ""
@@ -21,14 +21,7 @@ do
         echo "Output file data/$i.out not found, skipping TEST $i"
         continue
     fi
-    ../build/code << EOF > scm.out
-    $(cat data/$i.in)
-    (exit)
-EOF
-    sed '$d' scm.out > scm_cleaned.out
-    mv scm_cleaned.out scm.out
-    sed 's/scm> //' scm.out > scm_cleaned.out
-    mv scm_cleaned.out scm.out
+    ../build/code data/$i.in > scm.out
     diff -b scm.out data/$i.out > diff_output.txt
     if [ $? -ne 0 ]; then
         echo "Wrong answer in TEST" $i
@@ -55,14 +48,7 @@ do
         echo "Output file more-tests/$i.out not found, skipping EXTRA TEST $i"
         continue
     fi
-    ../build/code << EOF > scm.out
-    $(cat more-tests/$i.in)
-    (exit)
-EOF
-    sed '$d' scm.out > scm_cleaned.out
-    mv scm_cleaned.out scm.out
-    sed 's/scm> //' scm.out > scm_cleaned.out
-    mv scm_cleaned.out scm.out
+    ../build/code more-tests/$i.in > scm.out
     diff -b scm.out more-tests/$i.out > diff_output.txt
     if [ $? -ne 0 ]; then
         echo "Wrong answer in EXTRA TEST" $i
@@ -0,0 +1,231 @@
+/**
+ * @file serve_test.cpp
+ * @brief Tests of the evaluation server (server.hpp) through libscheme
+ *
+ * Usage: serve_test
+ *
+ * Starts serveUnixSocket in a child process, in fork mode and in process,
+ * and talks to it over the socket: plain requests, a job killed while it
+ * waits (the client must get a SERVE_JOB_FAILED reply and keep its
+ * connection), recursion deep enough to overflow the C++ stack, malformed
+ * requests (an unfinished list, a stray ")", nesting too deep to read), a
+ * request that runs past the time limit, and in fork mode a job stuck past
+ * it (stopped, so that only the server killing it can answer). Prints each failed check and exits
+ * with status 1 if there was any.
+ */
+
+#include "../src/interpreter.hpp"
+#include "../src/server.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+static void check(const std::string &what, bool ok) {
+    if (!ok) {
+        printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static int connectTo(const std::string &path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    for (int tries = 0; tries < 500; tries++) { // 等服务进程开始监听，最多 5 秒
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+static bool sendRequest(int fd, const std::string &code) {
+    unsigned char header[4];
+    putLength(header, code.size());
+    return writeFull(fd, header, 4) && writeFull(fd, code.data(), code.size());
+}
+
+// 最多等 seconds 秒读回一个响应
+static bool receive(int fd, std::string &reply, unsigned char &status, int seconds) {
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, seconds * 1000) != 1) {
+        return false;
+    }
+    unsigned char header[5];
+    if (!readFull(fd, header, 5)) {
+        return false;
+    }
+    reply.resize(getLength(header));
+    status = header[4];
+    return reply.empty() || readFull(fd, &reply[0], reply.size());
+}
+
+static void expectReply(int fd, const std::string &what, const std::string &code,
+                        const std::string &output, unsigned char status, int seconds = 10) {
+    std::string reply;
+    unsigned char got = 0xff;
+    if (!sendRequest(fd, code) || !receive(fd, reply, got, seconds)) {
+        check(what + ": no reply", false);
+        return;
+    }
+    check(what + ": status " + std::to_string(got), got == status);
+    check(what + ": output \"" + reply + "\"", reply == output);
+}
+
+// 读不完的请求：回复 RuntimeError，连接照常可用
+static void expectMalformed(int fd, const std::string &mode) {
+    expectReply(fd, "unfinished list" + mode, "(display 1) (+ 1", "1\nRuntimeError\n", SERVE_OK);
+    expectReply(fd, "stray )" + mode, "(+ 1 2) ) (+ 3 4)", "3\nRuntimeError\n", SERVE_OK);
+    expectReply(fd, "unterminated string" + mode, "\"abc", "RuntimeError\n", SERVE_OK);
+    expectReply(fd, "nesting too deep" + mode, std::string(1 << 20, '(') + std::string(1 << 20, ')'),
+                "RuntimeError\n", SERVE_OK);
+    expectReply(fd, "after malformed requests" + mode, "(+ 1 2)", "3\n", SERVE_OK);
+}
+
+static pid_t startServer(const std::string &path, bool fork_jobs, double timeout) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        Interpreter interp(-1);
+        InterpreterScope scope(interp);
+        interp.eval("(define (f n) (if (= n 0) 0 (+ 1 (f (- n 1)))))"
+                    "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+        _exit(serveUnixSocket(interp, path, fork_jobs, false, timeout));
+    }
+    return pid;
+}
+
+static void stopServer(pid_t pid) {
+    kill(pid, SIGTERM);
+    int status;
+    waitpid(pid, &status, 0);
+    check("server exits cleanly", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+// 服务进程的第一个子进程（正在回答请求的 job），没有时为 0
+static pid_t firstJob(pid_t server) {
+    std::string file = "/proc/" + std::to_string(server) + "/task/" + std::to_string(server) + "/children";
+    std::ifstream in(file.c_str());
+    long pid = 0;
+    return in >> pid && pid > 0 ? static_cast<pid_t>(pid) : 0;
+}
+
+// 等 firstJob 满足 want，最多 5 秒
+template <typename F>
+static pid_t waitForJob(pid_t server, F want) {
+    for (int tries = 0; tries < 500; tries++) {
+        pid_t job = firstJob(server);
+        if (want(job)) {
+            return job;
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+static void testForkMode(const std::string &path) {
+    pid_t server = startServer(path, true, 0);
+    int fd = connectTo(path);
+    check("connect (fork mode)", fd >= 0);
+    if (fd < 0) {
+        kill(server, SIGKILL);
+        waitpid(server, nullptr, 0);
+        return;
+    }
+    expectReply(fd, "plain request", "(+ 1 2)", "3\n", SERVE_OK);
+
+    // job 等一个一分钟后才到的事件时被杀掉：客户端仍要收到回复。
+    // 先等上一个 job 被回收，免得找到的是它
+    check("previous job reaped", waitForJob(server, [](pid_t job) { return job == 0; }) == 0);
+    check("send waiting request", sendRequest(fd, "(after 60000 (lambda () 1))"));
+    pid_t job = waitForJob(server, [](pid_t job) { return job > 0; });
+    check("find the job", job > 0);
+    if (job > 0) {
+        kill(job, SIGKILL);
+        std::string reply;
+        unsigned char status = 0xff;
+        check("killed job gets a reply", receive(fd, reply, status, 10));
+        check("killed job: status", status == SERVE_JOB_FAILED);
+        check("killed job: output", reply == "RuntimeError\n");
+    }
+    expectReply(fd, "connection still usable", "(* 6 7)", "42\n", SERVE_OK);
+    expectReply(fd, "deep recursion in a job", "(f 1000000) (f 10)", "RuntimeError\n10\n", SERVE_OK);
+    expectMalformed(fd, " (fork mode)");
+    close(fd);
+    stopServer(server);
+}
+
+static void testForkTimeout(const std::string &path) {
+    pid_t server = startServer(path, true, 1);
+    int fd = connectTo(path);
+    check("connect (fork mode, time limit)", fd >= 0);
+    if (fd < 0) {
+        kill(server, SIGKILL);
+        waitpid(server, nullptr, 0);
+        return;
+    }
+    expectReply(fd, "time limit in a job", "(display 1) (fib 60)", "1\nRuntimeError\n", SERVE_OK);
+    check("timed-out job reaped", waitForJob(server, [](pid_t job) { return job == 0; }) == 0);
+    check("send request to stop", sendRequest(fd, "(after 60000 (lambda () 1))"));
+    pid_t job = waitForJob(server, [](pid_t job) { return job > 0; });
+    check("find the job to stop", job > 0);
+    if (job > 0) {
+        kill(job, SIGSTOP); // 它自己的定时器不再起作用
+        std::string reply;
+        unsigned char status = 0xff;
+        check("stuck job gets a reply", receive(fd, reply, status, 10));
+        check("stuck job: status", status == SERVE_JOB_FAILED);
+        check("stuck job: output", reply == "RuntimeError\n");
+    }
+    expectReply(fd, "after a stuck job", "(fib 10)", "55\n", SERVE_OK);
+    close(fd);
+    stopServer(server);
+}
+
+static void testInProcess(const std::string &path) {
+    pid_t server = startServer(path, false, 1);
+    int fd = connectTo(path);
+    check("connect (in process)", fd >= 0);
+    if (fd < 0) {
+        kill(server, SIGKILL);
+        waitpid(server, nullptr, 0);
+        return;
+    }
+    expectReply(fd, "deep recursion", "(f 1000000) (f 10)", "RuntimeError\n10\n", SERVE_OK);
+    expectReply(fd, "time limit", "(fib 60)", "RuntimeError\n", SERVE_OK);
+    expectMalformed(fd, " (in process)");
+    close(fd);
+    int other = connectTo(path);
+    check("server still accepts connections", other >= 0);
+    if (other >= 0) {
+        expectReply(other, "after the time limit", "(fib 10)", "55\n", SERVE_OK);
+        close(other);
+    }
+    stopServer(server);
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+    std::string path = "/tmp/serve_test." + std::to_string(getpid()) + ".sock";
+    testForkMode(path);
+    testForkTimeout(path);
+    testInProcess(path);
+    unlink(path.c_str());
+    if (failures == 0) {
+        printf("serve_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -19,13 +19,24 @@
  * Categories:
  * - Arithmetic: +, -, *, /, modulo, expt
  * - Comparison: <, <=, =, >=, >
- * - List operations: cons, car, cdr, list, set-car!, set-cdr!
+ * - List operations: cons, car, cdr, list, set-car!, set-cdr!, length, append,
+ *   reverse, list-tail, list-ref, memq, assq, assoc
+ * - Higher-order: map, for-each, filter, fold-left, fold-right, apply, sort, sort!
  * - Logic: not, and, or (and/or support short-circuit evaluation)
  * - Type predicates: eq?, boolean?, number?, null?, pair?, procedure?, symbol?, list?, string?
- * - I/O: display
+ * - I/O: display, write, newline, flush-output, current-output-port,
+ *   open-output-string, get-output-string, with-output-to-string,
+ *   open-input-file, close-input-port, call-with-input-file, read-line,
+ *   read-char, peek-char, read, eof-object, eof-object?, command-line
  * - Control: void, exit
+ * - Persistent maps: hash-map, hash-map-ref, hash-map-set, hash-map-remove, ...
+ * - Persistent vectors: pvector, pvector-ref, pvector-set, pvector-push, ...
+ * - Transients: transient, persistent! and the *! update forms
+ * - Strings: string-length, string-ref, substring, string-append, string=?,
+ *   string<?, string->symbol, symbol->string, number->string, string->number,
+ *   string-search-forward, string-index, string-contains
  */
-std::map<std::string, ExprType> primitives = { // transfer the formal char to the specific char in Scheme
+extern const std::map<std::string, ExprType> primitives = { // transfer the formal char to the specific char in Scheme
     // Arithmetic operations
     {"+",        E_PLUS},
     {"-",        E_MINUS},
@@ -48,6 +59,24 @@ std::map<std::string, ExprType> primitives = { // transfer the formal char to th
     {"list",      E_LIST},
     {"set-car!",  E_SETCAR},
     {"set-cdr!",  E_SETCDR},
+    {"length",    E_LENGTH},
+    {"append",    E_APPEND},
+    {"reverse",   E_REVERSE},
+    {"list-tail", E_LIST_TAIL},
+    {"list-ref",  E_LIST_REF},
+    {"memq",      E_MEMQ},
+    {"assq",      E_ASSQ},
+    {"assoc",     E_ASSOC},
+
+    // Higher-order procedures
+    {"map",        E_MAP},
+    {"for-each",   E_FOR_EACH},
+    {"filter",     E_FILTER},
+    {"fold-left",  E_FOLD_LEFT},
+    {"fold-right", E_FOLD_RIGHT},
+    {"apply",      E_APPLY_PROC},
+    {"sort",       E_SORT},
+    {"sort!",      E_SORT_BANG},
 
     // Logic operations
     {"not",       E_NOT},
@@ -67,10 +96,101 @@ std::map<std::string, ExprType> primitives = { // transfer the formal char to th
     
     // I/O operations
     {"display",   E_DISPLAY},
+    {"write",     E_WRITE},
+    {"newline",   E_NEWLINE},
+    {"flush-output",          E_FLUSH_OUTPUT},
+    {"current-output-port",   E_CURRENT_OUTPUT_PORT},
+    {"open-output-string",    E_OPEN_OUTPUT_STRING},
+    {"get-output-string",     E_GET_OUTPUT_STRING},
+    {"with-output-to-string", E_WITH_OUTPUT_TO_STRING},
+    {"open-input-file",       E_OPEN_INPUT_FILE},
+    {"close-input-port",      E_CLOSE_INPUT_PORT},
+    {"call-with-input-file",  E_CALL_WITH_INPUT_FILE},
+    {"read-line",             E_READ_LINE},
+    {"read-char",             E_READ_CHAR},
+    {"peek-char",             E_PEEK_CHAR},
+    {"read",                  E_READ},
+    {"eof-object",            E_EOF_OBJECT},
+    {"eof-object?",           E_EOF_OBJECTQ},
+    {"command-line",          E_COMMAND_LINE},
     
     // Special values and control
     {"void",      E_VOID},
-    {"exit",      E_EXIT}
+    {"exit",      E_EXIT},
+
+    // Persistent hash maps
+    {"hash-map",           E_HASHMAP},
+    {"hash-map?",          E_HASHMAPQ},
+    {"hash-map-ref",       E_HASHMAP_REF},
+    {"hash-map-set",       E_HASHMAP_SET},
+    {"hash-map-remove",    E_HASHMAP_REMOVE},
+    {"hash-map-contains?", E_HASHMAP_CONTAINSQ},
+    {"hash-map-count",     E_HASHMAP_COUNT},
+    {"hash-map->alist",    E_HASHMAP_TO_LIST},
+    {"hash-map-set!",      E_HASHMAP_SET_BANG},
+    {"hash-map-remove!",   E_HASHMAP_REMOVE_BANG},
+
+    // Persistent vectors
+    {"pvector",            E_PVECTOR},
+    {"pvector?",           E_PVECTORQ},
+    {"pvector-ref",        E_PVECTOR_REF},
+    {"pvector-set",        E_PVECTOR_SET},
+    {"pvector-push",       E_PVECTOR_PUSH},
+    {"pvector-length",     E_PVECTOR_LENGTH},
+    {"pvector->list",      E_PVECTOR_TO_LIST},
+    {"list->pvector",      E_LIST_TO_PVECTOR},
+    {"pvector-set!",       E_PVECTOR_SET_BANG},
+    {"pvector-push!",      E_PVECTOR_PUSH_BANG},
+
+    // Transient batch updates
+    {"transient",          E_TRANSIENT},
+    {"persistent!",        E_PERSISTENT},
+
+    // Strings
+    {"string-length",      E_STRING_LENGTH},
+    {"string-ref",         E_STRING_REF},
+    {"substring",          E_SUBSTRING},
+    {"string-append",      E_STRING_APPEND},
+    {"string=?",           E_STRING_EQ},
+    {"string<?",           E_STRING_LT},
+    {"string->symbol",     E_STRING_TO_SYMBOL},
+    {"symbol->string",     E_SYMBOL_TO_STRING},
+    {"number->string",     E_NUMBER_TO_STRING},
+    {"string->number",     E_STRING_TO_NUMBER},
+    {"string-search-forward", E_STRING_SEARCH_FORWARD},
+    {"string-index",       E_STRING_INDEX},
+    {"string-contains",    E_STRING_CONTAINS},
+
+    // Futures and parallel map
+    {"touch",              E_TOUCH},
+    {"pmap",               E_PMAP},
+    {"pfor-each",          E_PFOR_EACH},
+
+    // Green threads and channels
+    {"spawn",              E_SPAWN},
+    {"yield",              E_YIELD},
+    {"make-channel",       E_MAKE_CHANNEL},
+    {"channel-put",        E_CHANNEL_PUT},
+    {"channel-get",        E_CHANNEL_GET},
+
+    // Escaping (one-shot) continuations
+    {"call/ec",            E_CALLEC},
+    {"call-with-escape-continuation",  E_CALLEC},
+    {"call/cc",            E_CALLEC},
+    {"call-with-current-continuation", E_CALLEC},
+
+    // Event loop
+    {"after",              E_AFTER},
+    {"read-file-async",    E_READ_FILE_ASYNC},
+    {"on-readable",        E_ON_READABLE},
+    {"run-event-loop",     E_RUN_EVENT_LOOP},
+
+    // Profiler
+    {"profile-start",      E_PROFILE_START},
+    {"profile-stop",       E_PROFILE_STOP},
+
+    // Runtime statistics
+    {"runtime-stats",      E_RUNTIME_STATS}
 };
 
 /**
@@ -87,11 +207,12 @@ std::map<std::string, ExprType> primitives = { // transfer the formal char to th
  * - Variable and function definition: define
  * - Binding constructs: let, letrec
  * - Assignment: set!
+ * - Futures: future
  * 
  * Note: and/or have been moved to primitives to support function-style usage
  * while maintaining their short-circuit evaluation behavior.
  */
-std::map<std::string, ExprType> reserved_words = {
+extern const std::map<std::string, ExprType> reserved_words = {
     // Control flow constructs
     {"begin",   E_BEGIN},    
     {"quote",   E_QUOTE},    
@@ -111,5 +232,11 @@ std::map<std::string, ExprType> reserved_words = {
     {"letrec",  E_LETREC},   
     
     // Assignment
-    {"set!",    E_SET}      
+    {"set!",    E_SET},
+
+    // Futures
+    {"future",  E_FUTURE},
+
+    // Runtime statistics
+    {"time",    E_TIME}
 };
@@ -61,6 +61,25 @@ enum ExprType {
     E_LIST,             
     E_SETCAR,          
     E_SETCDR,          
+    E_LENGTH,
+    E_APPEND,
+    E_REVERSE,
+    E_LIST_TAIL,
+    E_LIST_REF,
+    E_MEMQ,
+    E_ASSQ,
+    E_ASSOC,
+
+    // Higher-order procedures
+    E_MAP,
+    E_FOR_EACH,
+    E_FILTER,
+    E_FOLD_LEFT,
+    E_FOLD_RIGHT,
+    E_APPLY_PROC,
+    E_SORT,
+    E_SORT_BANG,
+    E_PIPELINE,
 
     // Logic operations
     E_NOT,              
@@ -91,6 +110,7 @@ enum ExprType {
     E_APPLY,           
     E_LAMBDA,         
     E_DEFINE,          
+    E_NATIVE,           // C++ function registered through Interpreter::defineNative
 
     // Binding constructs
     E_LET,            
@@ -101,6 +121,97 @@ enum ExprType {
 
     // I/O operations
     E_DISPLAY,         
+    E_WRITE,
+    E_NEWLINE,
+    E_FLUSH_OUTPUT,
+    E_CURRENT_OUTPUT_PORT,
+    E_OPEN_OUTPUT_STRING,
+    E_GET_OUTPUT_STRING,
+    E_WITH_OUTPUT_TO_STRING,
+    E_OPEN_INPUT_FILE,
+    E_CLOSE_INPUT_PORT,
+    E_CALL_WITH_INPUT_FILE,
+    E_READ_LINE,
+    E_READ_CHAR,
+    E_PEEK_CHAR,
+    E_READ,
+    E_EOF_OBJECT,
+    E_EOF_OBJECTQ,
+    E_COMMAND_LINE,
+
+    // Persistent hash maps
+    E_HASHMAP,
+    E_HASHMAPQ,
+    E_HASHMAP_REF,
+    E_HASHMAP_SET,
+    E_HASHMAP_REMOVE,
+    E_HASHMAP_CONTAINSQ,
+    E_HASHMAP_COUNT,
+    E_HASHMAP_TO_LIST,
+    E_HASHMAP_SET_BANG,
+    E_HASHMAP_REMOVE_BANG,
+
+    // Persistent vectors
+    E_PVECTOR,
+    E_PVECTORQ,
+    E_PVECTOR_REF,
+    E_PVECTOR_SET,
+    E_PVECTOR_PUSH,
+    E_PVECTOR_LENGTH,
+    E_PVECTOR_TO_LIST,
+    E_LIST_TO_PVECTOR,
+    E_PVECTOR_SET_BANG,
+    E_PVECTOR_PUSH_BANG,
+
+    // Transient batch updates
+    E_TRANSIENT,
+    E_PERSISTENT,
+
+    // Strings
+    E_STRING_LENGTH,
+    E_STRING_REF,
+    E_SUBSTRING,
+    E_STRING_APPEND,
+    E_STRING_EQ,
+    E_STRING_LT,
+    E_STRING_TO_SYMBOL,
+    E_SYMBOL_TO_STRING,
+    E_NUMBER_TO_STRING,
+    E_STRING_TO_NUMBER,
+    E_STRING_SEARCH_FORWARD,
+    E_STRING_INDEX,
+    E_STRING_CONTAINS,
+
+    // Futures and parallel map (parallel.hpp)
+    E_FUTURE,
+    E_TOUCH,
+    E_PMAP,
+    E_PFOR_EACH,
+
+    // Green threads and channels (green.hpp)
+    E_SPAWN,
+    E_YIELD,
+    E_MAKE_CHANNEL,
+    E_CHANNEL_PUT,
+    E_CHANNEL_GET,
+
+    // Escaping continuations
+    E_CALLEC,
+    E_CONTINUATION,     // body of a continuation procedure
+
+    // Event loop (events.hpp)
+    E_AFTER,
+    E_READ_FILE_ASYNC,
+    E_ON_READABLE,
+    E_RUN_EVENT_LOOP,
+
+    // Profiler (profile.hpp)
+    E_PROFILE_START,
+    E_PROFILE_STOP,
+
+    // Runtime statistics (stats.hpp)
+    E_RUNTIME_STATS,
+    E_TIME,
 };
 
 /**
@@ -119,7 +230,14 @@ enum ValueType {
     V_PAIR,             
     V_PROC,             
     V_VOID,            
-    V_TERMINATE        
+    V_TERMINATE,
+    V_HASHMAP,
+    V_PVECTOR,
+    V_OUTPUT_PORT,
+    V_INPUT_PORT,
+    V_EOF,
+    V_FUTURE,
+    V_CHANNEL
 };
 
 #endif // DEF_HPP
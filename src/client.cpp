@@ -0,0 +1,135 @@
+/**
+ * @file client.cpp
+ * @brief Client for the evaluation server (code --serve SOCKET)
+ *
+ * Usage: scheme-client [-n count] SOCKET [-e EXPR | file]
+ *
+ * Sends the expression, the file, or standard input as one request and
+ * prints the server's output. With -n the same request is sent count times
+ * over one connection and latency percentiles are reported on stderr.
+ * Exits with 0, 3 if the request called (exit), or 4 if the server's job
+ * for it died before answering (--fork).
+ */
+
+#include "server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void usage(const char *prog) {
+    std::cerr << "usage: " << prog << " [-n count] SOCKET [-e EXPR | file]\n";
+}
+
+static int connectTo(const std::string &path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 发送一个请求并读回响应；连接出错时返回 false
+static bool request(int fd, const std::string &code, std::string &reply, unsigned char &status) {
+    unsigned char header[5];
+    putLength(header, code.size());
+    if (!writeFull(fd, header, 4) || !writeFull(fd, code.data(), code.size())) return false;
+    if (!readFull(fd, header, 5)) return false;
+    reply.resize(getLength(header));
+    status = header[4];
+    return reply.empty() || readFull(fd, &reply[0], reply.size());
+}
+
+int main(int argc, char *argv[]) {
+    long count = 1;
+    std::string socket_path, code;
+    bool have_code = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            count = std::max(1L, std::atol(argv[++i]));
+        } else if (arg == "-e" && i + 1 < argc) {
+            code = argv[++i];
+            have_code = true;
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (socket_path.empty()) {
+            socket_path = arg;
+        } else if (!have_code) {
+            std::ifstream in(arg.c_str(), std::ios::binary);
+            if (!in) {
+                std::cerr << argv[0] << ": cannot read " << arg << "\n";
+                return 1;
+            }
+            std::ostringstream ss;
+            ss << in.rdbuf();
+            code = ss.str();
+            have_code = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (socket_path.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!have_code) {
+        std::ostringstream ss;
+        ss << std::cin.rdbuf();
+        code = ss.str();
+    }
+    if (code.size() > SERVE_MAX_REQUEST) {
+        std::cerr << argv[0] << ": request too large\n";
+        return 1;
+    }
+
+    int fd = connectTo(socket_path);
+    if (fd < 0) {
+        std::cerr << argv[0] << ": cannot connect to " << socket_path << "\n";
+        return 1;
+    }
+    std::string reply;
+    unsigned char status = SERVE_OK;
+    std::vector<double> micros;
+    micros.reserve(count);
+    for (long k = 0; k < count; k++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!request(fd, code, reply, status)) {
+            std::cerr << argv[0] << ": connection lost\n";
+            close(fd);
+            return 1;
+        }
+        micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    close(fd);
+    std::fwrite(reply.data(), 1, reply.size(), stdout);
+    if (count > 1) {
+        std::sort(micros.begin(), micros.end());
+        auto at = [&](double q) { return micros[std::min(micros.size() - 1, size_t(q * micros.size()))]; };
+        std::fprintf(stderr, "%ld requests: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+                     count, at(0.50), at(0.99), micros.back());
+    }
+    if (status == SERVE_JOB_FAILED) {
+        std::cerr << argv[0] << ": the job answering the request died\n";
+        return 4;
+    }
+    return status == SERVE_EXIT ? 3 : 0;
+}
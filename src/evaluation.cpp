@@ -12,13 +12,29 @@
 #include "expr.hpp" 
 #include "RE.hpp"
 #include "syntax.hpp"
+#include "persistent.hpp"
+#include "optimize.hpp"
+#include "strsearch.hpp"
+#include "interpreter.hpp"
+#include "parallel.hpp"
+#include "green.hpp"
+#include "events.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
 #include <cstring>
+#include <pthread.h>
 #include <vector>
 #include <map>
 #include <climits>
-
-extern std::map<std::string, ExprType> primitives;
-extern std::map<std::string, ExprType> reserved_words;
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+
+extern const std::map<std::string, ExprType> primitives;
+extern const std::map<std::string, ExprType> reserved_words;
 int gcd1(int a, int b) {
     while (b != 0) {
         int temp = b;
@@ -36,7 +52,7 @@ Value RationalNum::eval(Assoc &e) { // evaluation of a rational number
 }
 
 Value StringExpr::eval(Assoc &e) { // evaluation of a string
-    return StringV(s);
+    return StringV(s, 0, s->size()); // 与字面量共享字节
 }
 
 Value True::eval(Assoc &e) { // evaluation of #t
@@ -56,17 +72,26 @@ Value Exit::eval(Assoc &e) { // (exit)
 }
 
 Value Unary::eval(Assoc &e) { // evaluation of single-operator primitive
-    return evalRator(rand->eval(e));
+    Value v = rand->eval(e);
+    if (isEscape(v)) return v; // 延续正在逃逸：原样交回
+    return evalRator(v);
 }
 
 Value Binary::eval(Assoc &e) { // evaluation of two-operators primitive
-    return evalRator(rand1->eval(e), rand2->eval(e));
+    Value v1 = rand1->eval(e);
+    if (isEscape(v1)) return v1;
+    Value v2 = rand2->eval(e);
+    if (isEscape(v2)) return v2;
+    return evalRator(v1, v2);
 }
 
 Value Variadic::eval(Assoc &e) { // evaluation of multi-operator primitive
     // TODO: TO COMPLETE THE VARIADIC CLASS
     std::vector<Value> vals;
-    for(auto &r:rands)vals.push_back(r->eval(e));
+    for(auto &r:rands){
+        vals.push_back(r->eval(e));
+        if (isEscape(vals.back())) return vals.back();
+    }
     return evalRator(vals);
 }
 
@@ -103,14 +128,31 @@ Value Var::eval(Assoc &e) { // evaluation of variable
                     {E_PROCQ,    {new IsProcedure(new Var("parm")), {"parm"}}},
                     {E_SYMBOLQ,  {new IsSymbol(new Var("parm")), {"parm"}}},
                     {E_STRINGQ,  {new IsString(new Var("parm")), {"parm"}}},
-                    {E_DISPLAY,  {new Display(new Var("parm")), {"parm"}}},
+                    {E_DISPLAY,  {new Display({}), {}}},
+                    {E_WRITE,    {new Write({}), {}}},
+                    {E_NEWLINE,  {new Newline({}), {}}},
+                    {E_FLUSH_OUTPUT,          {new FlushOutput({}), {}}},
+                    {E_CURRENT_OUTPUT_PORT,   {new CurrentOutputPort({}), {}}},
+                    {E_OPEN_OUTPUT_STRING,    {new OpenOutputString({}), {}}},
+                    {E_GET_OUTPUT_STRING,     {new GetOutputString(new Var("parm")), {"parm"}}},
+                    {E_WITH_OUTPUT_TO_STRING, {new WithOutputToString(new Var("parm")), {"parm"}}},
+                    {E_OPEN_INPUT_FILE,       {new OpenInputFile(new Var("parm")), {"parm"}}},
+                    {E_CLOSE_INPUT_PORT,      {new CloseInputPort(new Var("parm")), {"parm"}}},
+                    {E_READ_LINE,             {new ReadLine(new Var("parm")), {"parm"}}},
+                    {E_READ_CHAR,             {new ReadChar(new Var("parm")), {"parm"}}},
+                    {E_PEEK_CHAR,             {new PeekChar(new Var("parm")), {"parm"}}},
+                    {E_READ,                  {new ReadDatum(new Var("parm")), {"parm"}}},
+                    {E_EOF_OBJECTQ,           {new IsEof(new Var("parm")), {"parm"}}},
+                    {E_CALL_WITH_INPUT_FILE,  {new CallWithInputFile(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_EOF_OBJECT,            {new MakeEof({}), {}}},
+                    {E_COMMAND_LINE,          {new CommandLine({}), {}}},
                     {E_PLUS,     {new PlusVar({}),  {}}},
                     {E_MINUS,    {new MinusVar({}), {}}},
                     {E_MUL,      {new MultVar({}),  {}}},
                     {E_DIV,      {new DivVar({}),   {}}},
                     {E_MODULO,   {new Modulo(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
                     {E_EXPT,     {new Expt(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
-                    {E_EQQ,      {new EqualVar({}), {}}},
+                    {E_EQQ,      {new IsEq(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
                     {E_EQ,       {new EqualVar({}), {}}},
                     {E_LT,       {new LessVar({}), {}}},
                     {E_LE,       {new LessEqVar({}), {}}},
@@ -124,16 +166,93 @@ Value Var::eval(Assoc &e) { // evaluation of variable
                     {E_LISTQ,    {new IsList(new Var("parm")), {"parm"}}},
                     {E_SETCAR,   {new SetCar(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
                     {E_SETCDR,   {new SetCdr(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_LENGTH,   {new Length(new Var("parm")), {"parm"}}},
+                    {E_APPEND,   {new Append({}), {}}},
+                    {E_REVERSE,  {new Reverse(new Var("parm")), {"parm"}}},
+                    {E_LIST_TAIL,{new ListTail(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_LIST_REF, {new ListRef(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_MEMQ,     {new Memq(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_ASSQ,     {new Assq(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_ASSOC,    {new Assoc_(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_MAP,        {new MapFunc({}), {}}},
+                    {E_FOR_EACH,   {new ForEach({}), {}}},
+                    {E_FILTER,     {new Filter({}), {}}},
+                    {E_FOLD_LEFT,  {new FoldLeft({}), {}}},
+                    {E_FOLD_RIGHT, {new FoldRight({}), {}}},
+                    {E_APPLY_PROC, {new ApplyFunc({}), {}}},
+                    {E_SORT,       {new Sort(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_SORT_BANG,  {new SortBang(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
                     {E_AND,      {new AndVar({}), {}}},
-                    {E_OR,       {new OrVar({}), {}}}
+                    {E_OR,       {new OrVar({}), {}}},
+                    {E_HASHMAP,             {new MakeHashMap({}), {}}},
+                    {E_HASHMAPQ,            {new IsHashMap(new Var("parm")), {"parm"}}},
+                    {E_HASHMAP_REF,         {new HashMapRef({}), {}}},
+                    {E_HASHMAP_SET,         {new HashMapSet({}), {}}},
+                    {E_HASHMAP_REMOVE,      {new HashMapRemove(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_HASHMAP_CONTAINSQ,   {new HashMapContains(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_HASHMAP_COUNT,       {new HashMapCount(new Var("parm")), {"parm"}}},
+                    {E_HASHMAP_TO_LIST,     {new HashMapToList(new Var("parm")), {"parm"}}},
+                    {E_HASHMAP_SET_BANG,    {new HashMapSetBang({}), {}}},
+                    {E_HASHMAP_REMOVE_BANG, {new HashMapRemoveBang(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_PVECTOR,             {new MakePVector({}), {}}},
+                    {E_PVECTORQ,            {new IsPVector(new Var("parm")), {"parm"}}},
+                    {E_PVECTOR_REF,         {new PVectorRef(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_PVECTOR_SET,         {new PVectorSet({}), {}}},
+                    {E_PVECTOR_PUSH,        {new PVectorPush(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_PVECTOR_LENGTH,      {new PVectorLength(new Var("parm")), {"parm"}}},
+                    {E_PVECTOR_TO_LIST,     {new PVectorToList(new Var("parm")), {"parm"}}},
+                    {E_LIST_TO_PVECTOR,     {new ListToPVector(new Var("parm")), {"parm"}}},
+                    {E_PVECTOR_SET_BANG,    {new PVectorSetBang({}), {}}},
+                    {E_PVECTOR_PUSH_BANG,   {new PVectorPushBang(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_TRANSIENT,           {new Transient(new Var("parm")), {"parm"}}},
+                    {E_PERSISTENT,          {new Persistent(new Var("parm")), {"parm"}}},
+                    {E_STRING_LENGTH,       {new StringLength(new Var("parm")), {"parm"}}},
+                    {E_STRING_REF,          {new StringRef(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_SUBSTRING,           {new Substring({}), {}}},
+                    {E_STRING_APPEND,       {new StringAppend({}), {}}},
+                    {E_STRING_EQ,           {new StringEq({}), {}}},
+                    {E_STRING_LT,           {new StringLess({}), {}}},
+                    {E_STRING_TO_SYMBOL,    {new StringToSymbol(new Var("parm")), {"parm"}}},
+                    {E_SYMBOL_TO_STRING,    {new SymbolToString(new Var("parm")), {"parm"}}},
+                    {E_NUMBER_TO_STRING,    {new NumberToString(new Var("parm")), {"parm"}}},
+                    {E_STRING_TO_NUMBER,    {new StringToNumber(new Var("parm")), {"parm"}}},
+                    {E_STRING_SEARCH_FORWARD, {new StringSearchForward({}), {}}},
+                    {E_STRING_INDEX,        {new StringIndex(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_STRING_CONTAINS,     {new StringContains(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_TOUCH,      {new Touch(new Var("parm")), {"parm"}}},
+                    {E_PMAP,       {new PMap({}), {}}},
+                    {E_PFOR_EACH,  {new PForEach({}), {}}},
+                    {E_SPAWN,         {new Spawn(new Var("parm")), {"parm"}}},
+                    {E_YIELD,         {new Yield({}), {}}},
+                    {E_MAKE_CHANNEL,  {new MakeChannel({}), {}}},
+                    {E_CHANNEL_PUT,   {new ChannelPut(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_CHANNEL_GET,   {new ChannelGet(new Var("parm")), {"parm"}}},
+                    {E_CALLEC,        {new CallEC(new Var("parm")), {"parm"}}},
+                    {E_AFTER,           {new After(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_READ_FILE_ASYNC, {new ReadFileAsync(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_ON_READABLE,     {new OnReadable(new Var("parm1"), new Var("parm2")), {"parm1","parm2"}}},
+                    {E_RUN_EVENT_LOOP,  {new RunEventLoop({}), {}}},
+                    {E_PROFILE_START,   {new ProfileStart({}), {}}},
+                    {E_PROFILE_STOP,    {new ProfileStop({}), {}}},
+                    {E_RUNTIME_STATS,   {new RuntimeStats({}), {}}}
             };
 
-            auto it = primitive_map.find(primitives[x]);
+            auto it = primitive_map.find(primitives.at(x));
             //TOD0:to PASS THE parameters correctly;
             //COMPLETE THE CODE WITH THE HINT IN IF SENTENCE WITH CORRECT RETURN VALUE
             if (it != primitive_map.end()) {
-                //TODO
-                return ProcedureV(it->second.second,it->second.first,e);
+                // 原语的过程体不引用环境，每个解释器中每种原语只构造一次过程值
+                Interpreter &interp = Interpreter::current();
+                std::map<ExprType, Value> &primitive_procs = interp.primitive_procs;
+                ParallelGuard guard(interp.tables_lock);
+                auto cached = primitive_procs.find(it->first);
+                if (cached != primitive_procs.end()) {
+                    return cached->second;
+                }
+                Value proc = ProcedureV(it->second.second, it->second.first, empty());
+                static_cast<Procedure*>(proc.get())->is_primitive = true;
+                primitive_procs.insert(std::make_pair(it->first, proc));
+                return proc;
             }
         }
         throw(RuntimeError("Undefined "));
@@ -564,11 +683,447 @@ Value Cdr::evalRator(const Value &rand) { // cdr
     throw(RuntimeError("Wrong typename in Cdr"));
 }
 
+// HIGHER-ORDER PROCEDURES
+
+// 从每个表各取一个元素放入 args[offset..]；任一表耗尽时返回 false
+static bool nextElements(std::vector<Value> &lists, std::vector<Value> &args, size_t offset) {
+    for (size_t i = 0; i < lists.size(); i++) {
+        if (lists[i]->v_type != V_PAIR) {
+            if (lists[i]->v_type != V_NULL) {
+                throw RuntimeError("Wrong typename: list expected");
+            }
+            return false;
+        }
+        Pair *p = static_cast<Pair*>(lists[i].get());
+        args[offset + i] = p->car;
+        lists[i] = p->cdr;
+    }
+    return true;
+}
+
+Value MapFunc::evalRator(const std::vector<Value> &args) { // (map f l1 l2 ...)
+    if (args.size() < 2) {
+        throw RuntimeError("Wrong number of map");
+    }
+    std::vector<Value> lists(args.begin() + 1, args.end());
+    std::vector<Value> call_args(lists.size(), Value(nullptr));
+    Value result = NullV();
+    Pair *last = nullptr;
+    while (nextElements(lists, call_args, 0)) {
+        Value x = applyProcedure(args[0], call_args);
+        if (isEscape(x)) return x;
+        Value cell = PairV(x, NullV());
+        if (last == nullptr) {
+            result = cell;
+        } else {
+            last->cdr = cell;
+        }
+        last = static_cast<Pair*>(cell.get());
+    }
+    return result;
+}
+
+Value ForEach::evalRator(const std::vector<Value> &args) { // (for-each f l1 l2 ...)
+    if (args.size() < 2) {
+        throw RuntimeError("Wrong number of for-each");
+    }
+    std::vector<Value> lists(args.begin() + 1, args.end());
+    std::vector<Value> call_args(lists.size(), Value(nullptr));
+    while (nextElements(lists, call_args, 0)) {
+        Value r = applyProcedure(args[0], call_args);
+        if (isEscape(r)) return r;
+    }
+    return VoidV();
+}
+
+Value Filter::evalRator(const std::vector<Value> &args) { // (filter pred l)
+    if (args.size() != 2) {
+        throw RuntimeError("Wrong number of filter");
+    }
+    std::vector<Value> lists(1, args[1]);
+    std::vector<Value> call_args(1, Value(nullptr));
+    Value result = NullV();
+    Pair *last = nullptr;
+    while (nextElements(lists, call_args, 0)) {
+        Value x = call_args[0];
+        Value keep = applyProcedure(args[0], call_args);
+        if (isEscape(keep)) return keep;
+        if (isfalse(keep)) {
+            continue;
+        }
+        Value cell = PairV(x, NullV());
+        if (last == nullptr) {
+            result = cell;
+        } else {
+            last->cdr = cell;
+        }
+        last = static_cast<Pair*>(cell.get());
+    }
+    return result;
+}
+
+Value FoldLeft::evalRator(const std::vector<Value> &args) { // (fold-left f init l1 ...)
+    if (args.size() < 3) {
+        throw RuntimeError("Wrong number of fold-left");
+    }
+    std::vector<Value> lists(args.begin() + 2, args.end());
+    std::vector<Value> call_args(lists.size() + 1, Value(nullptr));
+    Value acc = args[1];
+    while (nextElements(lists, call_args, 1)) {
+        call_args[0] = acc;
+        acc = applyProcedure(args[0], call_args);
+        if (isEscape(acc)) return acc;
+    }
+    return acc;
+}
+
+Value FoldRight::evalRator(const std::vector<Value> &args) { // (fold-right f init l1 ...)
+    if (args.size() < 3) {
+        throw RuntimeError("Wrong number of fold-right");
+    }
+    // 先把各表的元素按行收集起来，再从右向左迭代，避免递归
+    std::vector<Value> lists(args.begin() + 2, args.end());
+    size_t width = lists.size();
+    std::vector<Value> rows;
+    std::vector<Value> row(width, Value(nullptr));
+    while (nextElements(lists, row, 0)) {
+        rows.insert(rows.end(), row.begin(), row.end());
+    }
+    std::vector<Value> call_args(width + 1, Value(nullptr));
+    Value acc = args[1];
+    for (size_t r = rows.size() / width; r > 0; r--) {
+        for (size_t i = 0; i < width; i++) {
+            call_args[i] = rows[(r - 1) * width + i];
+        }
+        call_args[width] = acc;
+        acc = applyProcedure(args[0], call_args);
+        if (isEscape(acc)) return acc;
+    }
+    return acc;
+}
+
+Value ListPipeline::eval(Assoc &e) { // 融合后的 map/filter 链
+    // 按原嵌套顺序求值操作数：消费者的过程与初值，再由外到内各阶段的过程，最后是源表
+    Value proc = sink_proc.get() != nullptr ? sink_proc->eval(e) : Value(nullptr);
+    if (isEscape(proc)) return proc;
+    Value init = sink_init.get() != nullptr ? sink_init->eval(e) : Value(nullptr);
+    if (isEscape(init)) return init;
+    std::vector<Value> procs(stages.size(), Value(nullptr));
+    for (size_t i = stages.size(); i > 0; i--) {
+        procs[i - 1] = stages[i - 1].second->eval(e);
+        if (isEscape(procs[i - 1])) return procs[i - 1];
+    }
+    Value list = source->eval(e);
+    if (isEscape(list)) return list;
+
+    bool pure = proc.get() == nullptr || isPureProcedure(proc);
+    for (size_t i = 0; pure && i < procs.size(); i++) {
+        pure = isPureProcedure(procs[i]);
+    }
+    if (!pure) { // 有副作用：逐个阶段完整执行，调用顺序与未融合时一致
+        for (size_t i = 0; i < stages.size(); i++) {
+            std::vector<Value> args = {procs[i], list};
+            if (stages[i].first == E_MAP) {
+                list = MapFunc(std::vector<Expr>()).evalRator(args);
+            } else {
+                list = Filter(std::vector<Expr>()).evalRator(args);
+            }
+            if (isEscape(list)) return list;
+        }
+        switch (sink) {
+            case E_FOLD_LEFT: return FoldLeft(std::vector<Expr>()).evalRator({proc, init, list});
+            case E_FOLD_RIGHT: return FoldRight(std::vector<Expr>()).evalRator({proc, init, list});
+            case E_FOR_EACH: return ForEach(std::vector<Expr>()).evalRator({proc, list});
+            case E_LENGTH: return Length(Expr(nullptr)).evalRator(list);
+            default: return list;
+        }
+    }
+
+    // 无副作用：一次遍历源表，不构造中间表
+    std::vector<Value> one(1, Value(nullptr));
+    std::vector<Value> two(2, Value(nullptr));
+    std::vector<Value> kept; // fold-right 需要倒序消费
+    Value result = NullV();
+    Pair *last = nullptr;
+    Value acc = init;
+    int count = 0;
+    while (list->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(list.get());
+        Value x = p->car;
+        list = p->cdr;
+        bool keep = true;
+        for (size_t i = 0; keep && i < stages.size(); i++) {
+            one[0] = x;
+            if (stages[i].first == E_MAP) {
+                x = applyProcedure(procs[i], one);
+            } else {
+                keep = !isfalse(applyProcedure(procs[i], one));
+            }
+        }
+        if (!keep) {
+            continue;
+        }
+        switch (sink) {
+            case E_FOLD_LEFT:
+                two[0] = acc;
+                two[1] = x;
+                acc = applyProcedure(proc, two);
+                break;
+            case E_FOLD_RIGHT:
+                kept.push_back(x);
+                break;
+            case E_FOR_EACH:
+                one[0] = x;
+                applyProcedure(proc, one);
+                break;
+            case E_LENGTH:
+                count++;
+                break;
+            default: {
+                Value cell = PairV(x, NullV());
+                if (last == nullptr) {
+                    result = cell;
+                } else {
+                    last->cdr = cell;
+                }
+                last = static_cast<Pair*>(cell.get());
+            }
+        }
+    }
+    if (list->v_type != V_NULL) {
+        throw RuntimeError("Wrong typename: list expected");
+    }
+    switch (sink) {
+        case E_FOLD_LEFT:
+            return acc;
+        case E_FOLD_RIGHT:
+            for (size_t i = kept.size(); i > 0; i--) {
+                two[0] = kept[i - 1];
+                two[1] = acc;
+                acc = applyProcedure(proc, two);
+            }
+            return acc;
+        case E_FOR_EACH:
+            return VoidV();
+        case E_LENGTH:
+            return IntegerV(count);
+        default:
+            return result;
+    }
+}
+
+Value ApplyFunc::evalRator(const std::vector<Value> &args) { // (apply f a ... l)
+    if (args.size() < 2) {
+        throw RuntimeError("Wrong number of apply");
+    }
+    std::vector<Value> call_args(args.begin() + 1, args.end() - 1);
+    Value now = args.back();
+    while (now->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(now.get());
+        call_args.push_back(p->car);
+        now = p->cdr;
+    }
+    if (now->v_type != V_NULL) {
+        throw RuntimeError("Wrong typename: list expected");
+    }
+    return applyProcedure(args[0], call_args);
+}
+
+// SORTING
+
+// 比较器为原语 < 返回 1，原语 > 返回 -1，否则返回 0
+static int primitiveOrder(const Value &less) {
+    if (less->v_type != V_PROC) {
+        throw RuntimeError("Attempt to apply a non-procedure");
+    }
+    Procedure *proc = static_cast<Procedure*>(less.get());
+    if (!proc->is_primitive) {
+        return 0;
+    }
+    if (dynamic_cast<LessVar*>(proc->e.get()) != nullptr) {
+        return 1;
+    }
+    if (dynamic_cast<GreaterVar*>(proc->e.get()) != nullptr) {
+        return -1;
+    }
+    return 0;
+}
+
+static inline const Value &sortKey(const Value &item, bool by_car) {
+    return by_car ? static_cast<Pair*>(item.get())->car : item;
+}
+
+static inline int fixnumKey(const Value &item, bool by_car) {
+    return static_cast<Integer*>(sortKey(item, by_car).get())->n;
+}
+
+// 按 keys 的高 32 位做 LSD 基数排序（每趟 8 位），低 32 位是原下标；
+// 每趟都是稳定的计数排序，因此相等的键保持原来的先后顺序
+static void radixSortKeys(std::vector<unsigned long long> &keys) {
+    size_t n = keys.size();
+    std::vector<size_t> count(4 * 256, 0);
+    for (unsigned long long k : keys) {
+        for (int d = 0; d < 4; d++) {
+            count[d * 256 + ((k >> (32 + 8 * d)) & 0xff)]++;
+        }
+    }
+    std::vector<unsigned long long> buffer(n);
+    for (int d = 0; d < 4; d++) {
+        size_t *c = &count[d * 256];
+        if (c[(keys[0] >> (32 + 8 * d)) & 0xff] == n) { // 这一位全都相同
+            continue;
+        }
+        size_t pos = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t here = c[b];
+            c[b] = pos;
+            pos += here;
+        }
+        for (unsigned long long k : keys) {
+            buffer[c[(k >> (32 + 8 * d)) & 0xff]++] = k;
+        }
+        keys.swap(buffer);
+    }
+}
+
+// 稳定排序 items；by_car 为真时 items 是表的序对，按其 car 比较
+static void sortValues(std::vector<Value> &items, const Value &less, bool by_car) {
+    size_t n = items.size();
+    int order = primitiveOrder(less);
+    if (order != 0 && n > 0 && n <= 0xffffffffULL) { // 原语 < / > 作用于整数时直接比较 int
+        bool fixnums = true;
+        for (auto &item : items) {
+            if (sortKey(item, by_car)->v_type != V_INT) {
+                fixnums = false;
+                break;
+            }
+        }
+        if (fixnums) {
+            // 翻转符号位后无符号序与有符号序一致；> 再整体取反
+            std::vector<unsigned long long> keys(n);
+            for (size_t i = 0; i < n; i++) {
+                unsigned int key = static_cast<unsigned int>(fixnumKey(items[i], by_car)) ^ 0x80000000u;
+                if (order < 0) {
+                    key = ~key;
+                }
+                keys[i] = (static_cast<unsigned long long>(key) << 32) | i;
+            }
+            radixSortKeys(keys);
+            std::vector<Value> sorted;
+            sorted.reserve(n);
+            for (unsigned long long k : keys) {
+                sorted.push_back(std::move(items[k & 0xffffffffULL]));
+            }
+            items.swap(sorted);
+            return;
+        }
+    }
+    // 自底向上归并：仅当 (less right left) 为真时先取右侧元素，
+    // 因此比较器即使不满足严格弱序也不会越界
+    std::vector<Value> buffer(n, Value(nullptr));
+    std::vector<Value> call_args(2, Value(nullptr));
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = std::min(lo + width, n);
+            size_t hi = std::min(lo + 2 * width, n);
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                call_args[0] = sortKey(items[j], by_car);
+                call_args[1] = sortKey(items[i], by_car);
+                Value before = applyProcedure(less, call_args);
+                throwIfEscape(before); // 归并中途无法返回
+                if (!isfalse(before)) {
+                    buffer[k++] = std::move(items[j++]);
+                } else {
+                    buffer[k++] = std::move(items[i++]);
+                }
+            }
+            while (i < mid) buffer[k++] = std::move(items[i++]);
+            while (j < hi) buffer[k++] = std::move(items[j++]);
+        }
+        items.swap(buffer);
+    }
+}
+
+static void collectList(const Value &lst, std::vector<Value> &out, bool cells) {
+    Value now = lst;
+    while (now->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(now.get());
+        out.push_back(cells ? now : p->car);
+        now = p->cdr;
+    }
+    if (now->v_type != V_NULL) {
+        throw RuntimeError("Wrong typename: list expected");
+    }
+}
+
+Value Sort::evalRator(const Value &rand1, const Value &rand2) { // (sort seq less?)
+    std::vector<Value> items;
+    if (rand1->v_type == V_PVECTOR) {
+        PVector *v = static_cast<PVector*>(rand1.get());
+        items.reserve(v->cnt);
+        for (size_t i = 0; i < v->cnt; i++) {
+            items.push_back(pvecNth(v, i));
+        }
+        sortValues(items, rand2, false);
+        Value result = EmptyPVectorV();
+        unsigned long long edit = newEditId();
+        for (auto &item : items) {
+            pvecPush(static_cast<PVector*>(result.get()), item, edit);
+        }
+        return result;
+    }
+    collectList(rand1, items, false);
+    sortValues(items, rand2, false);
+    Value list = NullV();
+    for (size_t i = items.size(); i > 0; i--) {
+        list = PairV(items[i - 1], list);
+    }
+    return list;
+}
+
+Value SortBang::evalRator(const Value &rand1, const Value &rand2) { // (sort! seq less?)
+    std::vector<Value> items;
+    if (rand1->v_type == V_PVECTOR) { // 仅 transient 可原地排序
+        PVector *v = static_cast<PVector*>(rand1.get());
+        if (v->edit == 0) {
+            throw RuntimeError("sort! on a persistent pvector; call transient first");
+        }
+        checkUnshared(v->owner);
+        items.reserve(v->cnt);
+        for (size_t i = 0; i < v->cnt; i++) {
+            items.push_back(pvecNth(v, i));
+        }
+        sortValues(items, rand2, false);
+        for (size_t i = 0; i < items.size(); i++) {
+            pvecAssocN(v, i, items[i], v->edit);
+        }
+        return rand1;
+    }
+    // 对序对本身排序后重新串接 cdr，不分配新的序对
+    collectList(rand1, items, true);
+    if (items.empty()) {
+        return rand1;
+    }
+    for (auto &item : items) {
+        checkUnshared(item->owner);
+    }
+    sortValues(items, rand2, true);
+    // 从后往前串接，把 items 里的引用直接移进 cdr
+    static_cast<Pair*>(items.back().get())->cdr = NullV();
+    for (size_t i = items.size() - 1; i > 0; i--) {
+        static_cast<Pair*>(items[i - 1].get())->cdr = std::move(items[i]);
+    }
+    return items[0];
+}
+
 Value SetCar::evalRator(const Value &rand1, const Value &rand2) { // set-car!
     //TODO: To complete the set-car! logic 修改
     if(rand1->v_type!=V_PAIR){
         throw(RuntimeError("Wrong typename"));
     }
+    checkUnshared(rand1->owner);
+    noteStructureMutation();
     Pair *p=dynamic_cast<Pair*>(rand1.get());
     p->car=rand2;
     return VoidV();
@@ -579,31 +1134,172 @@ Value SetCdr::evalRator(const Value &rand1, const Value &rand2) { // set-cdr!
     if(rand1->v_type!=V_PAIR){
         throw(RuntimeError("Wrong typename"));
     }
+    checkUnshared(rand1->owner);
+    noteStructureMutation();
     Pair *p=dynamic_cast<Pair*>(rand1.get());
     p->cdr=rand2;
     return VoidV();
 }
 
-Value IsEq::evalRator(const Value &rand1, const Value &rand2) { // eq?
+bool isEqValue(const Value &rand1, const Value &rand2) { // eq? 的判定，memq/assq 共用
     // 检查类型是否为 Integer
     if (rand1->v_type == V_INT && rand2->v_type == V_INT) {
-        return BooleanV((dynamic_cast<Integer*>(rand1.get())->n) == (dynamic_cast<Integer*>(rand2.get())->n));
+        return static_cast<Integer*>(rand1.get())->n == static_cast<Integer*>(rand2.get())->n;
     }
     // 检查类型是否为 Boolean
     else if (rand1->v_type == V_BOOL && rand2->v_type == V_BOOL) {
-        return BooleanV((dynamic_cast<Boolean*>(rand1.get())->b) == (dynamic_cast<Boolean*>(rand2.get())->b));
-    }
-    // 检查类型是否为 Symbol
-    else if (rand1->v_type == V_SYM && rand2->v_type == V_SYM) {
-        return BooleanV((dynamic_cast<Symbol*>(rand1.get())->s) == (dynamic_cast<Symbol*>(rand2.get())->s));
+        return static_cast<Boolean*>(rand1.get())->b == static_cast<Boolean*>(rand2.get())->b;
     }
     // 检查类型是否为 Null 或 Void
     else if ((rand1->v_type == V_NULL && rand2->v_type == V_NULL) ||
              (rand1->v_type == V_VOID && rand2->v_type == V_VOID)) {
-        return BooleanV(true);
-    } else {
-        return BooleanV(rand1.get() == rand2.get());
+        return true;
+    }
+    // Symbol 已驻留，指针相等即同名
+    return rand1.get() == rand2.get();
+}
+
+bool isEqualValue(const Value &rand1, const Value &rand2) { // equal? 的判定，assoc 使用
+    Value a = rand1, b = rand2;
+    while (a->v_type == V_PAIR && b->v_type == V_PAIR) { // cdr 方向迭代，car 方向递归
+        Pair *pa = static_cast<Pair*>(a.get());
+        Pair *pb = static_cast<Pair*>(b.get());
+        if (!isEqualValue(pa->car, pb->car)) {
+            return false;
+        }
+        a = pa->cdr;
+        b = pb->cdr;
+    }
+    if (a->v_type == V_STRING && b->v_type == V_STRING) {
+        return stringEqual(static_cast<String*>(a.get()), static_cast<String*>(b.get()));
+    }
+    if (a->v_type == V_RATIONAL && b->v_type == V_RATIONAL) {
+        return static_cast<Rational*>(a.get())->numerator == static_cast<Rational*>(b.get())->numerator &&
+               static_cast<Rational*>(a.get())->denominator == static_cast<Rational*>(b.get())->denominator;
+    }
+    return isEqValue(a, b);
+}
+
+Value IsEq::evalRator(const Value &rand1, const Value &rand2) { // eq?
+    return BooleanV(isEqValue(rand1, rand2));
+}
+
+Value Length::evalRator(const Value &rand) { // length
+    int n = 0;
+    Value now = rand;
+    while (now->v_type == V_PAIR) {
+        n++;
+        now = static_cast<Pair*>(now.get())->cdr;
+    }
+    if (now->v_type != V_NULL) {
+        throw RuntimeError("Wrong typename in length");
+    }
+    return IntegerV(n);
+}
+
+Value Append::evalRator(const std::vector<Value> &args) { // append
+    // 只复制前 n-1 个表的骨架，最后一个参数原样共享
+    if (args.empty()) {
+        return NullV();
+    }
+    Value head = args.back();
+    Pair *last = nullptr;
+    Value result = NullV();
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        Value now = args[i];
+        while (now->v_type == V_PAIR) {
+            Pair *p = static_cast<Pair*>(now.get());
+            Value cell = PairV(p->car, NullV());
+            if (last == nullptr) {
+                result = cell;
+            } else {
+                last->cdr = cell;
+            }
+            last = static_cast<Pair*>(cell.get());
+            now = p->cdr;
+        }
+        if (now->v_type != V_NULL) {
+            throw RuntimeError("Wrong typename in append");
+        }
+    }
+    if (last == nullptr) {
+        return head;
+    }
+    last->cdr = head;
+    return result;
+}
+
+Value Reverse::evalRator(const Value &rand) { // reverse
+    Value ans = NullV();
+    Value now = rand;
+    while (now->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(now.get());
+        ans = PairV(p->car, ans);
+        now = p->cdr;
+    }
+    if (now->v_type != V_NULL) {
+        throw RuntimeError("Wrong typename in reverse");
+    }
+    return ans;
+}
+
+static Value listTail(const Value &lst, const Value &k) { // list-tail 与 list-ref 共用
+    if (k->v_type != V_INT || static_cast<Integer*>(k.get())->n < 0) {
+        throw RuntimeError("Wrong typename in list-tail");
+    }
+    Value now = lst;
+    for (int n = static_cast<Integer*>(k.get())->n; n > 0; n--) {
+        if (now->v_type != V_PAIR) {
+            throw RuntimeError("Index out of range");
+        }
+        now = static_cast<Pair*>(now.get())->cdr;
     }
+    return now;
+}
+
+Value ListTail::evalRator(const Value &rand1, const Value &rand2) { // list-tail
+    return listTail(rand1, rand2);
+}
+
+Value ListRef::evalRator(const Value &rand1, const Value &rand2) { // list-ref
+    Value tail = listTail(rand1, rand2);
+    if (tail->v_type != V_PAIR) {
+        throw RuntimeError("Index out of range");
+    }
+    return static_cast<Pair*>(tail.get())->car;
+}
+
+Value Memq::evalRator(const Value &rand1, const Value &rand2) { // memq
+    Value now = rand2;
+    while (now->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(now.get());
+        if (isEqValue(rand1, p->car)) {
+            return now;
+        }
+        now = p->cdr;
+    }
+    return BooleanV(false);
+}
+
+// assq/assoc 共用的查找，跳过非序对元素
+static Value assocSearch(const Value &key, const Value &alist, bool (*same)(const Value &, const Value &)) {
+    Value now = alist;
+    while (now->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(now.get());
+        if (p->car->v_type == V_PAIR && same(key, static_cast<Pair*>(p->car.get())->car)) {
+            return p->car;
+        }
+        now = p->cdr;
+    }
+    return BooleanV(false);
+}
+
+Value Assq::evalRator(const Value &rand1, const Value &rand2) { // assq
+    return assocSearch(rand1, rand2, isEqValue);
+}
+
+Value Assoc_::evalRator(const Value &rand1, const Value &rand2) { // assoc
+    return assocSearch(rand1, rand2, isEqualValue);
 }
 
 Value IsBoolean::evalRator(const Value &rand) { // boolean?
@@ -637,8 +1333,10 @@ Value IsString::evalRator(const Value &rand) { // string?
 Value Begin::eval(Assoc &e) {
     //TODO: To complete the begin logic
     Value ans=VoidV();
-    for(auto &it:es)
+    for(auto &it:es){
         ans=it->eval(e);
+        if (isEscape(ans)) return ans;
+    }
     return ans;
 }
 
@@ -710,6 +1408,7 @@ Value AndVar::eval(Assoc &e) { // and with short-circuit evaluation
         Value last=BooleanV(true);
         for(auto &it:rands){
             Value val=it->eval(e);
+            if (isEscape(val)) return val;
             if(isfalse(val)){
                 return BooleanV(false);
             }
@@ -740,6 +1439,7 @@ Value OrVar::eval(Assoc &e) { // or with short-circuit evaluation
 
 Value If::eval(Assoc &e) {
     Value val = cond->eval(e);
+    if (isEscape(val)) return val;
     if (isfalse(val)){
         return alter->eval(e);
     }
@@ -775,11 +1475,13 @@ Value Cond::eval(Assoc &env) {
         }
         else {
             val = clause[0]->eval(env);
+            if (isEscape(val)) return val;
         }
         if(!isfalse(val)){
             Value ans=VoidV();
             for(int i=1;i<clause.size();i++) {
                 ans=clause[i]->eval(env);
+                if (isEscape(ans)) return ans;
             }
             return ans;
         } 
@@ -789,24 +1491,57 @@ Value Cond::eval(Assoc &env) {
 
 Value Lambda::eval(Assoc &env) { 
     //TODO: To complete the lambda logic
-    return ProcedureV(x,e,env);
+    Value proc = ProcedureV(x,e,env);
+    static_cast<Procedure*>(proc.get())->name = name;
+    return proc;
 }
 
-Value Apply::eval(Assoc &env) {
-    Value proc_val = rator->eval(env);
-    if (proc_val->v_type != V_PROC) {
-        throw RuntimeError("Attempt to apply a non-procedure");
+thread_local const char *stack_limit = nullptr;
+volatile bool eval_interrupt = false;
+
+void initStackLimit() {
+    pthread_attr_t attr;
+    void *base = nullptr;
+    size_t size = 0;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        pthread_attr_getstack(&attr, &base, &size);
+        pthread_attr_destroy(&attr);
     }
+    stack_limit = size > 2 * STACK_RESERVE ? static_cast<const char*>(base) + STACK_RESERVE : nullptr;
+}
 
-    Procedure* proc = dynamic_cast<Procedure*>(proc_val.get());
-    std::vector<Value> arg_vals;
-    
-    for(auto &arg_expr : rand) {
-        arg_vals.push_back(arg_expr->eval(env));
+// 冷路径：不内联进 applyProcedure
+static void __attribute__((noinline)) evalLimitReached() {
+    if (eval_interrupt) {
+        throw RuntimeError("Evaluation interrupted");
+    }
+    throw RuntimeError("Recursion too deep");
+}
+
+Value applyProcedure(const Value &proc_val, const std::vector<Value> &arg_vals) {
+    char here;
+    if (&here < stack_limit || eval_interrupt) { // 栈快用完，或被超时打断
+        evalLimitReached();
+    }
+    if (proc_val->v_type != V_PROC) {
+        throw RuntimeError("Attempt to apply a non-procedure");
     }
-    if (auto varNode = dynamic_cast<Variadic*>(proc->e.get())) {
-        //TODO
-        return varNode->evalRator(arg_vals);
+    Procedure* proc = static_cast<Procedure*>(proc_val.get());
+    if (proc->is_primitive) { // 原语直接调用 evalRator，不建立环境
+        ExprBase *body = proc->e.get();
+        if (auto varNode = dynamic_cast<Variadic*>(body)) {
+            return varNode->evalRator(arg_vals);
+        }
+        if (arg_vals.size() == 1 && proc->parameters.size() == 1) {
+            if (auto unary = dynamic_cast<Unary*>(body)) {
+                return unary->evalRator(arg_vals[0]);
+            }
+        }
+        if (arg_vals.size() == 2 && proc->parameters.size() == 2) {
+            if (auto binary = dynamic_cast<Binary*>(body)) {
+                return binary->evalRator(arg_vals[0], arg_vals[1]);
+            }
+        }
     }
     if (arg_vals.size() != proc->parameters.size()) {
         throw RuntimeError("Wrong number of arguments");
@@ -817,12 +1552,30 @@ Value Apply::eval(Assoc &env) {
         new_env = extend(proc->parameters[i], arg_vals[i], new_env);
     }
     
+    ProfileScope frame(proc->name); // 性能分析器的影子栈
     return proc->e->eval(new_env);
 }
 
+Value Apply::eval(Assoc &env) {
+    Value proc_val = rator->eval(env);
+    if (isEscape(proc_val)) return proc_val;
+    if (proc_val->v_type != V_PROC) {
+        throw RuntimeError("Attempt to apply a non-procedure");
+    }
+
+    std::vector<Value> arg_vals;
+    arg_vals.reserve(rand.size());
+    for(auto &arg_expr : rand) {
+        arg_vals.push_back(arg_expr->eval(env));
+        if (isEscape(arg_vals.back())) return arg_vals.back();
+    }
+    return applyProcedure(proc_val, arg_vals);
+}
+
 Value Define::eval(Assoc &env){
     Assoc newenv = extend(var, Value(nullptr), env);
     Value newValue = e->eval(newenv);
+    if (isEscape(newValue)) return newValue;
     modify(var, newValue, newenv);
     env = newenv;
     return VoidV();
@@ -833,6 +1586,7 @@ Value Let::eval(Assoc &env) {
     Assoc newenv=env;
     for(auto &it:bind){
         Value val=it.second->eval(env);
+        if (isEscape(val)) return val;
         newenv=extend(it.first,val,newenv);
     }
     return body->eval(newenv);
@@ -845,6 +1599,7 @@ Value Letrec::eval(Assoc &env) {
         newenv=extend(it.first,VoidV(),newenv);
     for(auto &it:bind){
         Value val=it.second->eval(newenv);
+        if (isEscape(val)) return val;
         modify(it.first,val,newenv);
     }
     return body->eval(newenv);
@@ -853,20 +1608,956 @@ Value Letrec::eval(Assoc &env) {
 Value Set::eval(Assoc &env) {
     //TODO: To complete the set logic
     Value val=e->eval(env);
+    if (isEscape(val)) return val;
     Value flag=find(var,env);
     if(flag.get()==nullptr){
         throw(RuntimeError("Undefined variable : " + var));
     }
+    if (futuresRunning()) { // 只允许修改本任务自己建立的绑定
+        AssocList *binding = env.get();
+        while (binding->x != var) binding = binding->next.get();
+        checkUnshared(binding->owner);
+    }
     modify(var,val,env);
     return VoidV();
 }
 
-Value Display::evalRator(const Value &rand) { // display function
-    if (rand->v_type == V_STRING) {
-        String* str_ptr = dynamic_cast<String*>(rand.get());
-        std::cout << str_ptr->s;
+// 可选的端口参数，缺省为当前输出端口
+static OutputPort *portArg(const std::vector<Value> &args, size_t i) {
+    if (i >= args.size()) {
+        return static_cast<OutputPort*>(currentOutputPort().get());
+    }
+    if (args[i]->v_type != V_OUTPUT_PORT) {
+        throw RuntimeError("Wrong typename: output port expected");
+    }
+    return static_cast<OutputPort*>(args[i].get());
+}
+
+Value Display::evalRator(const std::vector<Value> &args) { // display function
+    if (args.size() != 1 && args.size() != 2) {
+        throw RuntimeError("Wrong number of display");
+    }
+    OutputPort *port = portArg(args, 1);
+    ParallelGuard guard(port->lock);
+    if (args[0]->v_type == V_STRING) {
+        String* str_ptr = static_cast<String*>(args[0].get());
+        port->write(str_ptr->data(), str_ptr->len);
     } else {
-        rand->show(std::cout);
+        args[0]->show(port->os);
+    }
+    return VoidV();
+}
+
+Value Write::evalRator(const std::vector<Value> &args) { // write
+    if (args.size() != 1 && args.size() != 2) {
+        throw RuntimeError("Wrong number of write");
+    }
+    OutputPort *port = portArg(args, 1);
+    ParallelGuard guard(port->lock);
+    args[0]->show(port->os);
+    return VoidV();
+}
+
+Value Newline::evalRator(const std::vector<Value> &args) { // newline
+    if (args.size() > 1) {
+        throw RuntimeError("Wrong number of newline");
+    }
+    OutputPort *port = portArg(args, 0);
+    ParallelGuard guard(port->lock);
+    port->put('\n');
+    return VoidV();
+}
+
+Value FlushOutput::evalRator(const std::vector<Value> &args) { // flush-output
+    if (args.size() > 1) {
+        throw RuntimeError("Wrong number of flush-output");
+    }
+    OutputPort *port = portArg(args, 0);
+    ParallelGuard guard(port->lock);
+    port->flush();
+    return VoidV();
+}
+
+Value CurrentOutputPort::evalRator(const std::vector<Value> &args) { // current-output-port
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of current-output-port");
+    }
+    return currentOutputPort();
+}
+
+Value OpenOutputString::evalRator(const std::vector<Value> &args) { // open-output-string
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of open-output-string");
+    }
+    return OutputPortV(-1);
+}
+
+Value GetOutputString::evalRator(const Value &rand) { // get-output-string
+    if (rand->v_type != V_OUTPUT_PORT || static_cast<OutputPort*>(rand.get())->fd >= 0) {
+        throw RuntimeError("Wrong typename: string port expected");
+    }
+    OutputPort *port = static_cast<OutputPort*>(rand.get());
+    ParallelGuard guard(port->lock);
+    return StringV(port->buf);
+}
+
+// 在作用域内替换当前输出端口，异常时也能恢复
+struct OutputRedirect {
+    Value saved;
+    OutputRedirect(const Value &port) : saved(currentOutputPort()) { currentOutputPort() = port; }
+    ~OutputRedirect() { currentOutputPort() = saved; }
+};
+
+Value WithOutputToString::evalRator(const Value &rand) { // with-output-to-string
+    Value port = OutputPortV(-1);
+    {
+        OutputRedirect redirect(port);
+        std::vector<Value> no_args;
+        Value r = applyProcedure(rand, no_args);
+        if (isEscape(r)) return r;
+    }
+    return StringV(static_cast<OutputPort*>(port.get())->buf);
+}
+
+static InputPort *asInputPort(const Value &v) {
+    if (v->v_type != V_INPUT_PORT) {
+        throw RuntimeError("Wrong typename: input port expected");
     }
+    InputPort *port = static_cast<InputPort*>(v.get());
+    if (port->closed) {
+        throw RuntimeError("Input port is closed");
+    }
+    checkUnshared(port->owner); // 读取会移动 pos
+    return port;
+}
+
+Value OpenInputFile::evalRator(const Value &rand) { // open-input-file
+    if (rand->v_type != V_STRING) {
+        throw RuntimeError("Wrong typename: string expected");
+    }
+    return OpenInputFileV(static_cast<String*>(rand.get())->str());
+}
+
+Value CloseInputPort::evalRator(const Value &rand) { // close-input-port
+    if (rand->v_type != V_INPUT_PORT) {
+        throw RuntimeError("Wrong typename: input port expected");
+    }
+    checkUnshared(rand->owner);
+    static_cast<InputPort*>(rand.get())->close();
     return VoidV();
-}
\ No newline at end of file
+}
+
+// proc 正常返回或抛出异常时都关闭端口
+struct InputPortCloser {
+    InputPort *port;
+    ~InputPortCloser() { port->close(); }
+};
+
+Value CallWithInputFile::evalRator(const Value &rand1, const Value &rand2) { // call-with-input-file
+    Value port = OpenInputFile(Expr(nullptr)).evalRator(rand1);
+    InputPortCloser closer{static_cast<InputPort*>(port.get())};
+    std::vector<Value> args(1, port);
+    return applyProcedure(rand2, args);
+}
+
+Value ReadLine::evalRator(const Value &rand) { // read-line：不含换行符，读完后返回 eof
+    InputPort *port = asInputPort(rand);
+    if (port->pos >= port->size) {
+        return EofV();
+    }
+    const char *start = port->data + port->pos;
+    size_t rest = port->size - port->pos;
+    size_t len = findByte(start, rest, '\n');
+    if (len == std::string::npos) {
+        len = rest;
+        port->pos = port->size;
+    } else {
+        port->pos += len + 1;
+    }
+    return StringV(std::string(start, len));
+}
+
+Value ReadChar::evalRator(const Value &rand) { // read-char
+    InputPort *port = asInputPort(rand);
+    if (port->pos >= port->size) {
+        return EofV();
+    }
+    return StringV(std::string(1, port->data[port->pos++]));
+}
+
+Value PeekChar::evalRator(const Value &rand) { // peek-char
+    InputPort *port = asInputPort(rand);
+    if (port->pos >= port->size) {
+        return EofV();
+    }
+    return StringV(std::string(1, port->data[port->pos]));
+}
+
+Value ReadDatum::evalRator(const Value &rand) { // read：直接在端口的字节上构造数据
+    InputPort *port = asInputPort(rand);
+    return readDatum(port->data, port->size, port->pos);
+}
+
+Value MakeEof::evalRator(const std::vector<Value> &args) { // eof-object
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of eof-object");
+    }
+    return EofV();
+}
+
+Value IsEof::evalRator(const Value &rand) { // eof-object?
+    return BooleanV(rand->v_type == V_EOF);
+}
+
+Value CommandLine::evalRator(const std::vector<Value> &args) { // command-line
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of command-line");
+    }
+    return commandLine();
+}
+
+// PERSISTENT COLLECTIONS
+
+static HashMap *asHashMap(const Value &v) {
+    if (v->v_type != V_HASHMAP) {
+        throw RuntimeError("Wrong typename: hash-map expected");
+    }
+    return static_cast<HashMap*>(v.get());
+}
+
+static PVector *asPVector(const Value &v) {
+    if (v->v_type != V_PVECTOR) {
+        throw RuntimeError("Wrong typename: pvector expected");
+    }
+    return static_cast<PVector*>(v.get());
+}
+
+// persistent updates on a transient would share nodes it may still write to
+static void checkPersistent(unsigned long long edit) {
+    if (edit != 0) {
+        throw RuntimeError("Persistent update on a transient; call persistent! first");
+    }
+}
+
+static void checkTransient(unsigned long long edit) {
+    if (edit == 0) {
+        throw RuntimeError("In-place update on a persistent collection; call transient first");
+    }
+}
+
+static size_t pvectorIndex(const Value &v) {
+    if (v->v_type != V_INT || static_cast<Integer*>(v.get())->n < 0) {
+        throw RuntimeError("Wrong typename: pvector index expected");
+    }
+    return static_cast<Integer*>(v.get())->n;
+}
+
+Value MakeHashMap::evalRator(const std::vector<Value> &args) { // (hash-map k v ...)
+    if (args.size() % 2 != 0) {
+        throw RuntimeError("hash-map expects key/value pairs");
+    }
+    unsigned long long edit = newEditId(); // build in place, then freeze
+    std::shared_ptr<HamtNode> root(nullptr);
+    size_t count = 0;
+    for (size_t i = 0; i < args.size(); i += 2) {
+        bool added = false;
+        root = hamtAssoc(root, 0, valueHash(args[i]), args[i], args[i + 1], edit, added);
+        count += added;
+    }
+    return HashMapV(root, count, 0);
+}
+
+Value IsHashMap::evalRator(const Value &rand) { // hash-map?
+    return BooleanV(rand->v_type == V_HASHMAP);
+}
+
+Value HashMapRef::evalRator(const std::vector<Value> &args) { // (hash-map-ref m k [default])
+    if (args.size() != 2 && args.size() != 3) {
+        throw RuntimeError("Wrong number of hash-map-ref");
+    }
+    HashMap *m = asHashMap(args[0]);
+    Value found = hamtFind(m->root, valueHash(args[1]), args[1]);
+    if (found.get() != nullptr) {
+        return found;
+    }
+    if (args.size() == 3) {
+        return args[2];
+    }
+    throw RuntimeError("hash-map-ref: key not found");
+}
+
+Value HashMapSet::evalRator(const std::vector<Value> &args) { // (hash-map-set m k v)
+    if (args.size() != 3) {
+        throw RuntimeError("Wrong number of hash-map-set");
+    }
+    HashMap *m = asHashMap(args[0]);
+    checkPersistent(m->edit);
+    bool added = false;
+    std::shared_ptr<HamtNode> root = hamtAssoc(m->root, 0, valueHash(args[1]), args[1], args[2], 0, added);
+    if (root.get() == m->root.get()) {
+        return args[0];
+    }
+    return HashMapV(root, m->count + added, 0);
+}
+
+Value HashMapRemove::evalRator(const Value &rand1, const Value &rand2) { // hash-map-remove
+    HashMap *m = asHashMap(rand1);
+    checkPersistent(m->edit);
+    bool removed = false;
+    std::shared_ptr<HamtNode> root = hamtDissoc(m->root, 0, valueHash(rand2), rand2, 0, removed);
+    if (!removed) {
+        return rand1;
+    }
+    return HashMapV(root, m->count - 1, 0);
+}
+
+Value HashMapContains::evalRator(const Value &rand1, const Value &rand2) { // hash-map-contains?
+    HashMap *m = asHashMap(rand1);
+    return BooleanV(hamtFind(m->root, valueHash(rand2), rand2).get() != nullptr);
+}
+
+Value HashMapCount::evalRator(const Value &rand) { // hash-map-count
+    return IntegerV(asHashMap(rand)->count);
+}
+
+Value HashMapToList::evalRator(const Value &rand) { // hash-map->alist
+    std::vector<std::pair<Value, Value>> entries;
+    hamtEntries(asHashMap(rand)->root, entries);
+    Value list = NullV();
+    for (int i = entries.size() - 1; i >= 0; i--) {
+        list = PairV(PairV(entries[i].first, entries[i].second), list);
+    }
+    return list;
+}
+
+Value HashMapSetBang::evalRator(const std::vector<Value> &args) { // (hash-map-set! t k v)
+    if (args.size() != 3) {
+        throw RuntimeError("Wrong number of hash-map-set!");
+    }
+    HashMap *m = asHashMap(args[0]);
+    checkTransient(m->edit);
+    checkUnshared(m->owner);
+    noteStructureMutation();
+    bool added = false;
+    m->root = hamtAssoc(m->root, 0, valueHash(args[1]), args[1], args[2], m->edit, added);
+    m->count += added;
+    return VoidV();
+}
+
+Value HashMapRemoveBang::evalRator(const Value &rand1, const Value &rand2) { // hash-map-remove!
+    HashMap *m = asHashMap(rand1);
+    checkTransient(m->edit);
+    checkUnshared(m->owner);
+    bool removed = false;
+    m->root = hamtDissoc(m->root, 0, valueHash(rand2), rand2, m->edit, removed);
+    m->count -= removed;
+    return VoidV();
+}
+
+Value MakePVector::evalRator(const std::vector<Value> &args) { // (pvector x ...)
+    Value result = EmptyPVectorV();
+    PVector *v = static_cast<PVector*>(result.get());
+    unsigned long long edit = newEditId();
+    for (auto &arg : args) {
+        pvecPush(v, arg, edit);
+    }
+    return result;
+}
+
+Value IsPVector::evalRator(const Value &rand) { // pvector?
+    return BooleanV(rand->v_type == V_PVECTOR);
+}
+
+Value PVectorRef::evalRator(const Value &rand1, const Value &rand2) { // pvector-ref
+    return pvecNth(asPVector(rand1), pvectorIndex(rand2));
+}
+
+Value PVectorSet::evalRator(const std::vector<Value> &args) { // (pvector-set v i x)
+    if (args.size() != 3) {
+        throw RuntimeError("Wrong number of pvector-set");
+    }
+    PVector *v = asPVector(args[0]);
+    checkPersistent(v->edit);
+    Value result = PVectorV(v->cnt, v->shift, v->root, v->tail, 0);
+    pvecAssocN(static_cast<PVector*>(result.get()), pvectorIndex(args[1]), args[2], 0);
+    return result;
+}
+
+Value PVectorPush::evalRator(const Value &rand1, const Value &rand2) { // pvector-push
+    PVector *v = asPVector(rand1);
+    checkPersistent(v->edit);
+    Value result = PVectorV(v->cnt, v->shift, v->root, v->tail, 0);
+    pvecPush(static_cast<PVector*>(result.get()), rand2, 0);
+    return result;
+}
+
+Value PVectorLength::evalRator(const Value &rand) { // pvector-length
+    return IntegerV(asPVector(rand)->cnt);
+}
+
+Value PVectorToList::evalRator(const Value &rand) { // pvector->list
+    PVector *v = asPVector(rand);
+    Value list = NullV();
+    for (size_t i = v->cnt; i > 0; i--) {
+        list = PairV(pvecNth(v, i - 1), list);
+    }
+    return list;
+}
+
+Value ListToPVector::evalRator(const Value &rand) { // list->pvector
+    Value result = EmptyPVectorV();
+    PVector *v = static_cast<PVector*>(result.get());
+    unsigned long long edit = newEditId();
+    Value now = rand;
+    while (now->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(now.get());
+        pvecPush(v, p->car, edit);
+        now = p->cdr;
+    }
+    if (now->v_type != V_NULL) {
+        throw RuntimeError("Wrong typename: list expected");
+    }
+    return result;
+}
+
+Value PVectorSetBang::evalRator(const std::vector<Value> &args) { // (pvector-set! t i x)
+    if (args.size() != 3) {
+        throw RuntimeError("Wrong number of pvector-set!");
+    }
+    PVector *v = asPVector(args[0]);
+    checkTransient(v->edit);
+    checkUnshared(v->owner);
+    noteStructureMutation();
+    pvecAssocN(v, pvectorIndex(args[1]), args[2], v->edit);
+    return VoidV();
+}
+
+Value PVectorPushBang::evalRator(const Value &rand1, const Value &rand2) { // pvector-push!
+    PVector *v = asPVector(rand1);
+    checkTransient(v->edit);
+    checkUnshared(v->owner);
+    noteStructureMutation();
+    pvecPush(v, rand2, v->edit);
+    return VoidV();
+}
+
+Value Transient::evalRator(const Value &rand) { // transient
+    if (rand->v_type == V_HASHMAP) {
+        HashMap *m = static_cast<HashMap*>(rand.get());
+        checkPersistent(m->edit);
+        return HashMapV(m->root, m->count, newEditId());
+    }
+    PVector *v = asPVector(rand);
+    checkPersistent(v->edit);
+    return PVectorV(v->cnt, v->shift, v->root, v->tail, newEditId());
+}
+
+Value Persistent::evalRator(const Value &rand) { // persistent!
+    // the transient gives up its edit id, so nothing can write the shared nodes again
+    if (rand->v_type == V_HASHMAP) {
+        HashMap *m = static_cast<HashMap*>(rand.get());
+        checkTransient(m->edit);
+        checkUnshared(m->owner);
+        m->edit = 0;
+        return HashMapV(m->root, m->count, 0);
+    }
+    PVector *v = asPVector(rand);
+    checkTransient(v->edit);
+    checkUnshared(v->owner);
+    v->edit = 0;
+    return PVectorV(v->cnt, v->shift, v->root, v->tail, 0);
+}
+
+// STRINGS
+
+static String *asString(const Value &v) {
+    if (v->v_type != V_STRING) {
+        throw RuntimeError("Wrong typename: string expected");
+    }
+    return static_cast<String*>(v.get());
+}
+
+static size_t stringIndex(const Value &v, size_t limit) { // 0 <= k <= limit
+    if (v->v_type != V_INT) {
+        throw RuntimeError("Wrong typename: integer index expected");
+    }
+    int k = static_cast<Integer*>(v.get())->n;
+    if (k < 0 || static_cast<size_t>(k) > limit) {
+        throw RuntimeError("String index out of range");
+    }
+    return static_cast<size_t>(k);
+}
+
+// 子串与原串共享同一缓冲区
+static Value sliceString(String *s, size_t from, size_t to) {
+    const char *p = s->data();
+    return StringV(s->buf, p - s->buf->data() + from, to - from);
+}
+
+Value StringLength::evalRator(const Value &rand) { // string-length
+    return IntegerV(static_cast<int>(asString(rand)->len));
+}
+
+Value StringRef::evalRator(const Value &rand1, const Value &rand2) { // string-ref
+    String *s = asString(rand1);
+    if (s->len == 0) {
+        throw RuntimeError("String index out of range");
+    }
+    size_t k = stringIndex(rand2, s->len - 1);
+    return sliceString(s, k, k + 1);
+}
+
+Value Substring::evalRator(const std::vector<Value> &args) { // (substring s start [end])
+    if (args.size() != 2 && args.size() != 3) {
+        throw RuntimeError("Wrong number of substring");
+    }
+    String *s = asString(args[0]);
+    size_t to = args.size() == 3 ? stringIndex(args[2], s->len) : s->len;
+    size_t from = stringIndex(args[1], to);
+    return sliceString(s, from, to);
+}
+
+Value StringAppend::evalRator(const std::vector<Value> &args) { // string-append
+    if (args.empty()) {
+        return StringV("");
+    }
+    Value result = args[0];
+    asString(result);
+    for (size_t i = 1; i < args.size(); i++) {
+        asString(args[i]);
+        result = StringAppendV(result, args[i]);
+    }
+    return result;
+}
+
+Value StringEq::evalRator(const std::vector<Value> &args) { // string=?
+    for (size_t i = 0; i < args.size(); i++) {
+        asString(args[i]);
+    }
+    for (size_t i = 1; i < args.size(); i++) {
+        if (!stringEqual(asString(args[i - 1]), asString(args[i]))) {
+            return BooleanV(false);
+        }
+    }
+    return BooleanV(true);
+}
+
+Value StringLess::evalRator(const std::vector<Value> &args) { // string<?
+    for (size_t i = 0; i < args.size(); i++) {
+        asString(args[i]);
+    }
+    for (size_t i = 1; i < args.size(); i++) {
+        if (stringCompare(asString(args[i - 1]), asString(args[i])) >= 0) {
+            return BooleanV(false);
+        }
+    }
+    return BooleanV(true);
+}
+
+Value StringToSymbol::evalRator(const Value &rand) { // string->symbol
+    return SymbolV(asString(rand)->str());
+}
+
+Value SymbolToString::evalRator(const Value &rand) { // symbol->string
+    if (rand->v_type != V_SYM) {
+        throw RuntimeError("Wrong typename: symbol expected");
+    }
+    return StringV(static_cast<Symbol*>(rand.get())->s);
+}
+
+Value NumberToString::evalRator(const Value &rand) { // number->string
+    if (rand->v_type != V_INT && rand->v_type != V_RATIONAL) {
+        throw RuntimeError("Wrong typename: number expected");
+    }
+    std::ostringstream os;
+    rand->show(os);
+    return StringV(os.str());
+}
+
+Value StringToNumber::evalRator(const Value &rand) { // string->number，无法识别时返回 #f
+    std::string s = asString(rand)->str();
+    int n, d;
+    if (tryParseNumber(s, n)) {
+        return IntegerV(n);
+    }
+    if (tryParseRational(s, n, d)) {
+        if (n % d == 0) {
+            return IntegerV(n / d);
+        }
+        return RationalV(n, d);
+    }
+    return BooleanV(false);
+}
+
+static Value searchResult(size_t pos, size_t offset) {
+    if (pos == std::string::npos) {
+        return BooleanV(false);
+    }
+    return IntegerV(static_cast<int>(pos + offset));
+}
+
+Value StringSearchForward::evalRator(const std::vector<Value> &args) { // (string-search-forward pattern s [start])
+    if (args.size() != 2 && args.size() != 3) {
+        throw RuntimeError("Wrong number of string-search-forward");
+    }
+    String *pat = asString(args[0]);
+    String *s = asString(args[1]);
+    size_t start = args.size() == 3 ? stringIndex(args[2], s->len) : 0;
+    const char *p = pat->data();
+    return searchResult(findBytes(s->data() + start, s->len - start, p, pat->len), start);
+}
+
+Value StringIndex::evalRator(const Value &rand1, const Value &rand2) { // (string-index s c)
+    String *s = asString(rand1);
+    String *c = asString(rand2);
+    if (c->len != 1) {
+        throw RuntimeError("Wrong typename: string of length 1 expected");
+    }
+    char ch = c->data()[0];
+    return searchResult(findByte(s->data(), s->len, ch), 0);
+}
+
+Value StringContains::evalRator(const Value &rand1, const Value &rand2) { // (string-contains s pattern)
+    String *s = asString(rand1);
+    String *pat = asString(rand2);
+    const char *p = pat->data();
+    return searchResult(findBytes(s->data(), s->len, p, pat->len), 0);
+}
+
+// FUTURES AND PARALLEL MAP
+
+Value FutureExpr::eval(Assoc &env) {
+    Expr body = e;
+    Assoc captured = env;
+    return spawnFuture([body, captured]() mutable { return body->eval(captured); });
+}
+
+Value Touch::evalRator(const Value &rand) { // touch
+    if (rand->v_type != V_FUTURE) {
+        return rand;
+    }
+    return touchFuture(static_cast<Future*>(rand.get()));
+}
+
+// 按 map 的方式取出每次调用的实参，分成若干段交给 future；返回各次调用的结果
+static std::vector<Value> parallelApply(const std::vector<Value> &args) {
+    std::vector<Value> lists(args.begin() + 1, args.end());
+    std::vector<Value> call_args(lists.size(), Value(nullptr));
+    auto calls = std::make_shared<std::vector<std::vector<Value>>>();
+    while (nextElements(lists, call_args, 0)) {
+        calls->push_back(call_args);
+    }
+    size_t n = calls->size();
+    auto results = std::make_shared<std::vector<Value>>(n, Value(nullptr));
+    size_t pieces = std::min(n, static_cast<size_t>(parallelThreads()) * 4); // 每个线程几段，便于均衡
+    Value proc = args[0];
+    std::vector<Value> futures;
+    for (size_t k = 0; k < pieces; k++) {
+        size_t from = n * k / pieces, to = n * (k + 1) / pieces;
+        futures.push_back(spawnFuture([proc, calls, results, from, to]() {
+            for (size_t i = from; i < to; i++) {
+                (*results)[i] = applyProcedure(proc, (*calls)[i]);
+            }
+            return VoidV();
+        }));
+    }
+    // 等所有段都结束再报告第一个错误，否则出错后其余段仍在后台运行
+    bool failed = false;
+    std::string message;
+    for (auto &f : futures) {
+        try {
+            touchFuture(static_cast<Future*>(f.get()));
+        } catch (const RuntimeError &e) {
+            if (!failed) {
+                failed = true;
+                message = e.message();
+            }
+        }
+    }
+    if (failed) {
+        throw RuntimeError(message);
+    }
+    return *results;
+}
+
+Value PMap::evalRator(const std::vector<Value> &args) { // (pmap f l1 l2 ...)
+    if (args.size() < 2) {
+        throw RuntimeError("Wrong number of pmap");
+    }
+    std::vector<Value> results = parallelApply(args);
+    Value list = NullV();
+    for (size_t i = results.size(); i > 0; i--) {
+        list = PairV(results[i - 1], list);
+    }
+    return list;
+}
+
+Value PForEach::evalRator(const std::vector<Value> &args) { // (pfor-each f l1 l2 ...)
+    if (args.size() < 2) {
+        throw RuntimeError("Wrong number of pfor-each");
+    }
+    parallelApply(args);
+    return VoidV();
+}
+
+// GREEN THREADS AND CHANNELS
+
+static Channel *asChannel(const Value &v) {
+    if (v->v_type != V_CHANNEL) {
+        throw RuntimeError("Wrong typename: channel expected");
+    }
+    return static_cast<Channel*>(v.get());
+}
+
+Value Spawn::evalRator(const Value &rand) { // (spawn thunk)
+    if (rand->v_type != V_PROC) {
+        throw RuntimeError("Wrong typename: procedure expected");
+    }
+    greenScheduler().spawn(rand);
+    return VoidV();
+}
+
+Value Yield::evalRator(const std::vector<Value> &args) { // (yield)
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of yield");
+    }
+    greenScheduler().yield();
+    return VoidV();
+}
+
+Value MakeChannel::evalRator(const std::vector<Value> &args) { // (make-channel [capacity])
+    if (args.size() > 1) {
+        throw RuntimeError("Wrong number of make-channel");
+    }
+    size_t capacity = 0;
+    if (!args.empty()) {
+        if (args[0]->v_type != V_INT || static_cast<Integer*>(args[0].get())->n < 0) {
+            throw RuntimeError("Wrong typename: channel capacity expected");
+        }
+        capacity = static_cast<size_t>(static_cast<Integer*>(args[0].get())->n);
+    }
+    return Value(new Channel(capacity));
+}
+
+Value ChannelPut::evalRator(const Value &rand1, const Value &rand2) { // channel-put
+    greenScheduler().put(asChannel(rand1), rand2);
+    return VoidV();
+}
+
+Value ChannelGet::evalRator(const Value &rand) { // channel-get
+    return greenScheduler().get(asChannel(rand));
+}
+
+// ESCAPING CONTINUATIONS
+
+thread_local const void *stack_segment = nullptr;
+
+thread_local ContinuationFrame *escaping_frame = nullptr;
+
+static Value escape_value(new Void()); // 只用来比较地址，从不显示
+ValueBase *const escape_marker = escape_value.get();
+
+ContinuationFrame::ContinuationFrame() : live(true), segment(stack_segment), value(nullptr) {}
+
+/**
+ * @brief Thrown by throwIfEscape; the target frame is escaping_frame
+ */
+struct ContinuationThrow {};
+
+Value EscapeV() {
+    return escape_value;
+}
+
+void throwIfEscape(const Value &v) {
+    if (isEscape(v)) {
+        throw ContinuationThrow();
+    }
+}
+
+// 逃逸到达 frame 时取出延续的参数；不是 frame 的逃逸原样继续传递
+static Value landEscape(ContinuationFrame *frame, const Value &result) {
+    if (!isEscape(result) || escaping_frame != frame) {
+        return result;
+    }
+    escaping_frame = nullptr;
+    Value v = frame->value;
+    frame->value = Value(nullptr);
+    return v;
+}
+
+// call/ec 返回（或被展开越过）时让它的延续失效
+struct FrameExtent {
+    ContinuationFrame *frame;
+    ~FrameExtent() { frame->live = false; }
+};
+
+Value CallEC::evalRator(const Value &rand) { // (call/ec proc)
+    if (rand->v_type != V_PROC) {
+        throw RuntimeError("Wrong typename: procedure expected");
+    }
+    auto frame = std::make_shared<ContinuationFrame>();
+    Value k = ProcedureV(std::vector<std::string>(), Expr(new ContinuationCall(frame)), empty());
+    static_cast<Procedure*>(k.get())->is_primitive = true;
+    FrameExtent extent{frame.get()};
+    std::vector<Value> args(1, k);
+    try {
+        return landEscape(frame.get(), applyProcedure(rand, args));
+    } catch (ContinuationThrow &) {
+        if (escaping_frame != frame.get()) {
+            throw; // 更外层的 call/ec
+        }
+        return landEscape(frame.get(), EscapeV());
+    }
+}
+
+Value ContinuationCall::evalRator(const std::vector<Value> &args) { // (k [v])
+    if (args.size() > 1) {
+        throw RuntimeError("Wrong number of arguments");
+    }
+    if (!frame->live) {
+        throw RuntimeError("Continuation called after its extent exited");
+    }
+    if (frame->segment != stack_segment) {
+        throw RuntimeError("Continuation called from another future or green thread");
+    }
+    frame->value = args.empty() ? VoidV() : args[0];
+    escaping_frame = frame.get();
+    return EscapeV();
+}
+
+// EVENT LOOP
+
+static void checkProcedure(const Value &v) {
+    if (v->v_type != V_PROC) {
+        throw RuntimeError("Wrong typename: procedure expected");
+    }
+}
+
+Value After::evalRator(const Value &rand1, const Value &rand2) { // (after ms thunk)
+    if (rand1->v_type != V_INT || static_cast<Integer*>(rand1.get())->n < 0) {
+        throw RuntimeError("Wrong typename: milliseconds expected");
+    }
+    checkProcedure(rand2);
+    eventLoop().after(static_cast<Integer*>(rand1.get())->n, rand2);
+    return VoidV();
+}
+
+Value ReadFileAsync::evalRator(const Value &rand1, const Value &rand2) { // (read-file-async path proc)
+    if (rand1->v_type != V_STRING) {
+        throw RuntimeError("Wrong typename: string expected");
+    }
+    checkProcedure(rand2);
+    eventLoop().readFile(static_cast<String*>(rand1.get())->str(), rand2);
+    return VoidV();
+}
+
+Value OnReadable::evalRator(const Value &rand1, const Value &rand2) { // (on-readable fd proc)
+    if (rand1->v_type != V_INT || static_cast<Integer*>(rand1.get())->n < 0) {
+        throw RuntimeError("Wrong typename: file descriptor expected");
+    }
+    checkProcedure(rand2);
+    eventLoop().onReadable(static_cast<Integer*>(rand1.get())->n, rand2);
+    return VoidV();
+}
+
+Value RunEventLoop::evalRator(const std::vector<Value> &args) { // (run-event-loop)
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of run-event-loop");
+    }
+    eventLoop().run();
+    return VoidV();
+}
+
+// PROFILER
+
+Value ProfileStart::evalRator(const std::vector<Value> &args) { // (profile-start)
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of profile-start");
+    }
+    profileStart();
+    return VoidV();
+}
+
+Value ProfileStop::evalRator(const std::vector<Value> &args) { // (profile-stop [path])
+    if (args.size() > 1) {
+        throw RuntimeError("Wrong number of profile-stop");
+    }
+    if (!args.empty() && args[0]->v_type != V_STRING) {
+        throw RuntimeError("Wrong typename: string expected");
+    }
+    profileStop();
+    if (!args.empty()) {
+        std::string path = static_cast<String*>(args[0].get())->str();
+        std::ofstream file(path);
+        if (!file) {
+            throw RuntimeError("Cannot open output file: " + path);
+        }
+        writeCollapsedStacks(file);
+    }
+    Value port = currentOutputPort();
+    OutputPort *out = static_cast<OutputPort*>(port.get());
+    ParallelGuard guard(out->lock);
+    writeProfileTable(out->os);
+    return VoidV();
+}
+
+// RUNTIME STATISTICS
+
+Value RuntimeStats::evalRator(const std::vector<Value> &args) { // (runtime-stats)
+    if (!args.empty()) {
+        throw RuntimeError("Wrong number of runtime-stats");
+    }
+    return runtimeStats();
+}
+
+static double cpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Value TimeExpr::eval(Assoc &env) { // (time expr)
+#ifdef SCHEME_STATS
+    StatTotals before = statTotals();
+#endif
+    double cpu = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    Value v = e->eval(env);
+    if (isEscape(v)) { // 延续越过 (time ...) 跳出：它没有求完值，不报告
+        return v;
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cpu = cpuSeconds() - cpu;
+#ifdef SCHEME_STATS
+    StatTotals after = statTotals();
+#endif
+    Value port = currentOutputPort();
+    OutputPort *out = static_cast<OutputPort*>(port.get());
+    ParallelGuard guard(out->lock);
+    std::ios::fmtflags flags = out->os.flags();
+    std::streamsize precision = out->os.precision();
+    out->os << std::fixed << std::setprecision(3)
+            << "time: wall " << wall * 1e3 << " ms, cpu " << cpu * 1e3 << " ms";
+#ifdef SCHEME_STATS
+    out->os << ", " << after.allocated - before.allocated << " allocations ("
+            << after.bytes - before.bytes << " bytes)";
+#endif
+    out->os << '\n';
+    out->os.flags(flags);
+    out->os.precision(precision);
+    return v;
+}
+
+// NATIVE PROCEDURES
+
+Value NativeCall::evalRator(const std::vector<Value> &args) { // 注册的 C++ 函数
+    int n = static_cast<int>(args.size());
+    if (n < min_args || (max_args >= 0 && n > max_args)) {
+        throw RuntimeError("Wrong number of " + name);
+    }
+    Value result = fn(args.data(), args.size());
+    if (result.get() == nullptr) {
+        return VoidV();
+    }
+    return result;
+}
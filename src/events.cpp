@@ -0,0 +1,262 @@
+/**
+ * @file events.cpp
+ * @brief epoll/timerfd event loop behind after, read-file-async and on-readable
+ */
+
+#include "events.hpp"
+#include "green.hpp"
+#include "interpreter.hpp"
+#include "parallel.hpp"
+#include "RE.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <memory>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// 每轮从一个文件最多读这么多，其他事件不必久等
+static const size_t FILE_CHUNK = size_t(1) << 20;
+// 从被监视的 fd 一次最多读这么多
+static const size_t WATCH_CHUNK = size_t(1) << 16;
+// 文件页还不在缓存里时，隔这么久（毫秒）再试
+static const int COLD_RETRY_MS = 1;
+// 请内核预读的范围保持在读取位置前面这么多
+static const size_t READAHEAD_WINDOW = size_t(32) << 20;
+
+// 调用回调；出错时像顶层表达式那样报告
+static void callBack(const Value &proc, std::vector<Value> &args) {
+    Value result(nullptr);
+    try {
+        result = applyProcedure(proc, args);
+    } catch (const RuntimeError &) {
+        Interpreter::current().reportError();
+        return;
+    }
+    throwIfEscape(result); // 逃到 run-event-loop 之外的延续
+}
+
+EventLoop::EventLoop()
+    : epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      timer_seq(0), buffer(FILE_CHUNK) {
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = timer_fd;
+    if (epoll_fd < 0 || timer_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) != 0) {
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (timer_fd >= 0) close(timer_fd);
+        throw RuntimeError("Cannot create the event loop");
+    }
+}
+
+EventLoop::~EventLoop() {
+    for (auto &r : reads) {
+        close(r.fd);
+    }
+    close(timer_fd);
+    close(epoll_fd); // 被监视的 fd 不归事件循环所有，不关闭
+}
+
+void EventLoop::after(long ms, const Value &thunk) {
+    timers.push(Timer{Clock::now() + std::chrono::milliseconds(ms), timer_seq++, thunk});
+    armTimer();
+}
+
+void EventLoop::readFile(const std::string &path, const Value &proc) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw RuntimeError("Cannot open input file: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        throw RuntimeError("Cannot open input file: " + path);
+    }
+    // 让内核在后台把文件读进页缓存，之后只取已缓存的部分
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, 0, static_cast<off_t>(READAHEAD_WINDOW), POSIX_FADV_WILLNEED);
+    reads.push_back(FileRead{fd, static_cast<size_t>(st.st_size), std::string(), proc, false,
+                             READAHEAD_WINDOW});
+    reads.back().data.reserve(reads.back().size);
+}
+
+void EventLoop::onReadable(int fd, const Value &proc) {
+    auto it = watchers.find(fd);
+    if (it != watchers.end()) { // 已在监视：换成新的回调
+        it->second = proc;
+        return;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        throw RuntimeError("on-readable: cannot watch fd " + std::to_string(fd));
+    }
+    watchers.emplace(fd, proc);
+}
+
+bool EventLoop::pending() const {
+    return !timers.empty() || !reads.empty() || !watchers.empty();
+}
+
+// timerfd 跟着最早到期的定时器走；没有定时器时停掉
+void EventLoop::armTimer() {
+    itimerspec its = {};
+    if (!timers.empty()) {
+        auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(timers.top().due - Clock::now()).count();
+        if (wait <= 0) {
+            wait = 1; // 全零表示停掉定时器
+        }
+        its.it_value.tv_sec = static_cast<time_t>(wait / 1000000000);
+        its.it_value.tv_nsec = static_cast<long>(wait % 1000000000);
+    }
+    timerfd_settime(timer_fd, 0, &its, nullptr);
+}
+
+void EventLoop::runTimers() {
+    Clock::time_point now = Clock::now();
+    // 回调里新建的定时器最早在下一轮触发
+    while (!timers.empty() && timers.top().due <= now) {
+        Value thunk = timers.top().thunk;
+        timers.pop();
+        armTimer();
+        std::vector<Value> no_args;
+        callBack(thunk, no_args);
+    }
+}
+
+void EventLoop::readChunk(int fd) {
+    auto it = watchers.find(fd);
+    if (it == watchers.end()) { // 本轮较早的回调已不再监视它
+        return;
+    }
+    char buf[WATCH_CHUNK];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    Value proc = it->second;
+    std::vector<Value> args(1, Value(nullptr));
+    if (n <= 0) { // 文件结束；读错误也当作结束
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        watchers.erase(it);
+        args[0] = EofV();
+    } else {
+        args[0] = StringV(std::string(buf, static_cast<size_t>(n)));
+    }
+    callBack(proc, args);
+}
+
+// 每个读文件任务取一块已缓存的数据（wait 为真时不必等缓存）；读完的调用回调
+void EventLoop::advanceReads(bool wait) {
+    for (auto it = reads.begin(); it != reads.end(); ) {
+        FileRead &r = *it;
+        size_t old = r.data.size();
+        size_t want = r.size > old ? std::min(r.size - old, FILE_CHUNK) : WATCH_CHUNK;
+        // 先读进复用的缓冲区再追加：直接 resize 会先把新内存清零一遍
+        iovec iov = {buffer.data(), want};
+        ssize_t n = preadv2(r.fd, &iov, 1, static_cast<off_t>(old), wait ? 0 : RWF_NOWAIT);
+        if (n < 0 && (errno == EOPNOTSUPP || errno == EINVAL || errno == ENOSYS)) {
+            n = pread(r.fd, buffer.data(), want, static_cast<off_t>(old)); // 不支持 RWF_NOWAIT：直接读
+        }
+        if (r.advised < r.size && r.advised - old < READAHEAD_WINDOW / 2) { // 预读范围往前推
+            posix_fadvise(r.fd, static_cast<off_t>(r.advised), static_cast<off_t>(READAHEAD_WINDOW), POSIX_FADV_WILLNEED);
+            r.advised += READAHEAD_WINDOW;
+        }
+        if (n > 0) {
+            r.data.append(buffer.data(), static_cast<size_t>(n));
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            r.cold = (errno == EAGAIN);
+            ++it;
+            continue;
+        }
+        r.cold = false;
+        if (n > 0) {
+            ++it;
+            continue;
+        }
+        Value proc = r.proc;
+        std::vector<Value> args(1, Value(nullptr));
+        if (n == 0) {
+            auto text = std::make_shared<const std::string>(std::move(r.data));
+            args[0] = StringV(text, 0, text->size());
+        } else {
+            args[0] = BooleanV(false);
+        }
+        close(r.fd);
+        reads.erase(it);
+        callBack(proc, args);
+        return; // 回调可能改动了 reads，其余的下一轮再读
+    }
+}
+
+// 等待并处理一批事件；没有任何待处理的事件时返回 false
+bool EventLoop::dispatch(bool block) {
+    if (!pending()) {
+        return false;
+    }
+    int timeout = block ? -1 : 0;
+    for (auto &r : reads) {
+        if (!r.cold) {
+            timeout = 0;
+            break;
+        }
+        timeout = timeout == 0 ? 0 : COLD_RETRY_MS;
+    }
+    epoll_event events[64];
+    int n = epoll_wait(epoll_fd, events, 64, timeout);
+    if (n < 0) {
+        if (errno != EINTR) {
+            throw RuntimeError("Event loop wait failed");
+        }
+        if (eval_interrupt) { // 超时等打断：不再等下去
+            throw RuntimeError("Evaluation interrupted");
+        }
+        n = 0;
+    }
+    std::vector<int> ready;
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.fd == timer_fd) {
+            uint64_t expirations;
+            ssize_t ignored = read(timer_fd, &expirations, sizeof(expirations));
+            (void)ignored;
+        } else {
+            ready.push_back(events[i].data.fd);
+        }
+    }
+    runTimers();
+    for (int fd : ready) {
+        readChunk(fd);
+    }
+    // 只剩读文件要等时，没有别的事可做，直接阻塞着读
+    advanceReads(block && timers.empty() && watchers.empty());
+    return true;
+}
+
+void EventLoop::run() {
+    while (true) {
+        GreenScheduler *green = Interpreter::current().green;
+        bool tasks = green != nullptr && green->runnable();
+        if (tasks) {
+            green->yield(); // 可运行的绿色线程各跑一段
+        }
+        if (!dispatch(!tasks) && !tasks) {
+            return;
+        }
+    }
+}
+
+EventLoop &eventLoop() {
+    if (inFuture()) {
+        throw RuntimeError("The event loop cannot be used inside a future");
+    }
+    Interpreter &interp = Interpreter::current();
+    if (interp.events == nullptr) {
+        interp.events = new EventLoop;
+    }
+    return *interp.events;
+}
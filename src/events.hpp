@@ -0,0 +1,94 @@
+#ifndef EVENTS
+#define EVENTS
+
+/**
+ * @file events.hpp
+ * @brief Event loop: timers, asynchronous file reads and fd watchers
+ *
+ * (after ms thunk) calls thunk once ms milliseconds have passed.
+ * (read-file-async path proc) starts reading a whole file and calls
+ * (proc contents) when it is in; a file that cannot be opened raises
+ * RuntimeError at once, a read error later calls (proc #f).
+ * (on-readable fd proc) calls (proc chunk) with whatever can be read each
+ * time fd (a pipe, socket or terminal) becomes readable, and
+ * (proc (eof-object)) once at end of file, after which fd is dropped.
+ *
+ * Callbacks only run inside (run-event-loop), which returns when nothing
+ * is left to wait for, and when the interpreter reaches the end of its
+ * input (see Interpreter::evalForms), so a script exits once its loop is
+ * idle. Meanwhile the kernel does the waiting: timers are one timerfd, fds
+ * are watched with epoll, and file reads ask for readahead and then take
+ * only the pages already cached (preadv2 with RWF_NOWAIT), so the disk
+ * works while Scheme code evaluates. No threads are involved. Runnable
+ * green threads (green.hpp) get a turn between batches of callbacks.
+ *
+ * A callback that raises an error prints "RuntimeError" like a failed
+ * top-level form, and the loop goes on. The loop belongs to the
+ * interpreter's own thread: these primitives raise RuntimeError inside a
+ * future.
+ */
+
+#include "value.hpp"
+#include <chrono>
+#include <list>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Pending timers, file reads and fd watchers of one interpreter
+ */
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    void after(long ms, const Value &thunk);
+    void readFile(const std::string &path, const Value &proc);
+    void onReadable(int fd, const Value &proc);
+
+    /**
+     * @brief Runs callbacks (and green threads) until nothing is pending
+     */
+    void run();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    struct Timer {
+        Clock::time_point due;
+        unsigned long seq;              ///< Timers due at once fire in order of creation
+        Value thunk;
+        bool operator>(const Timer &t) const { return due != t.due ? due > t.due : seq > t.seq; }
+    };
+    struct FileRead {
+        int fd;
+        size_t size;                    ///< From fstat; reading stops at end of file anyway
+        std::string data;
+        Value proc;
+        bool cold;                      ///< Last try found no cached page
+        size_t advised;                 ///< Readahead has been asked for up to here
+    };
+    int epoll_fd;
+    int timer_fd;
+    unsigned long timer_seq;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    std::list<FileRead> reads;
+    std::unordered_map<int, Value> watchers;
+    std::vector<char> buffer;           ///< File chunks are read here first
+    bool pending() const;
+    bool dispatch(bool block);
+    void armTimer();
+    void runTimers();
+    void readChunk(int fd);
+    void advanceReads(bool wait);
+};
+
+/**
+ * @brief Event loop of the current interpreter, created on first use
+ */
+EventLoop &eventLoop();
+
+#endif // EVENTS
@@ -1,5 +1,6 @@
 #include "Def.hpp"
 #include "expr.hpp"
+#include "profile.hpp"
 #include <cstring>
 #include <cstdlib>
 #include <vector>
@@ -41,7 +42,7 @@ RationalNum::RationalNum(int num, int den) : ExprBase(E_RATIONAL), numerator(num
     }
 }
 
-StringExpr::StringExpr(const std::string &str) : ExprBase(E_STRING), s(str) {}
+StringExpr::StringExpr(const std::string &str) : ExprBase(E_STRING), s(std::make_shared<const std::string>(str)) {}
 
 True::True() : ExprBase(E_TRUE) {}
 
@@ -131,6 +132,45 @@ SetCar::SetCar(const Expr &r1, const Expr &r2) : Binary(E_SETCAR, r1, r2) {}
 
 SetCdr::SetCdr(const Expr &r1, const Expr &r2) : Binary(E_SETCDR, r1, r2) {}
 
+Length::Length(const Expr &r1) : Unary(E_LENGTH, r1) {}
+
+Append::Append(const std::vector<Expr> &rands) : Variadic(E_APPEND, rands) {}
+
+Reverse::Reverse(const Expr &r1) : Unary(E_REVERSE, r1) {}
+
+ListTail::ListTail(const Expr &r1, const Expr &r2) : Binary(E_LIST_TAIL, r1, r2) {}
+
+ListRef::ListRef(const Expr &r1, const Expr &r2) : Binary(E_LIST_REF, r1, r2) {}
+
+Memq::Memq(const Expr &r1, const Expr &r2) : Binary(E_MEMQ, r1, r2) {}
+
+Assq::Assq(const Expr &r1, const Expr &r2) : Binary(E_ASSQ, r1, r2) {}
+
+Assoc_::Assoc_(const Expr &r1, const Expr &r2) : Binary(E_ASSOC, r1, r2) {}
+// Assoc 已是环境类型名，故加下划线
+
+//HIGHER-ORDER PROCEDURES
+
+MapFunc::MapFunc(const std::vector<Expr> &rands) : Variadic(E_MAP, rands) {}
+
+ForEach::ForEach(const std::vector<Expr> &rands) : Variadic(E_FOR_EACH, rands) {}
+
+Filter::Filter(const std::vector<Expr> &rands) : Variadic(E_FILTER, rands) {}
+
+FoldLeft::FoldLeft(const std::vector<Expr> &rands) : Variadic(E_FOLD_LEFT, rands) {}
+
+FoldRight::FoldRight(const std::vector<Expr> &rands) : Variadic(E_FOLD_RIGHT, rands) {}
+
+ApplyFunc::ApplyFunc(const std::vector<Expr> &rands) : Variadic(E_APPLY_PROC, rands) {}
+
+Sort::Sort(const Expr &r1, const Expr &r2) : Binary(E_SORT, r1, r2) {}
+
+SortBang::SortBang(const Expr &r1, const Expr &r2) : Binary(E_SORT_BANG, r1, r2) {}
+
+ListPipeline::ListPipeline(const std::vector<std::pair<ExprType, Expr>> &st, ExprType sk,
+                           const Expr &proc, const Expr &init, const Expr &src)
+    : ExprBase(E_PIPELINE), stages(st), sink(sk), sink_proc(proc), sink_init(init), source(src) {}
+
 //LOGIC OPERATIONS
 
 Not::Not(const Expr &r1) : Unary(E_NOT, r1) {}
@@ -181,15 +221,27 @@ Var::Var(const string &s) : ExprBase(E_VAR), x(s) {}
 
 Apply::Apply(const Expr &expr, const vector<Expr> &vec) : ExprBase(E_APPLY), rator(expr), rand(vec) {}
 
-Lambda::Lambda(const vector<string> &vec, const Expr &expr) : ExprBase(E_LAMBDA), x(vec), e(expr) {}
+Lambda::Lambda(const vector<string> &vec, const Expr &expr) : ExprBase(E_LAMBDA), x(vec), e(expr), name(nullptr) {}
+
+// 直接绑定到名字上的 lambda 记下这个名字，供性能分析器显示
+static void nameLambda(const Expr &expr, const string &name) {
+    Lambda *lambda = dynamic_cast<Lambda*>(expr.get());
+    if (lambda != nullptr && lambda->name == nullptr)
+        lambda->name = profileName(name);
+}
 
-Define::Define(const string &variable, const Expr &expr) : ExprBase(E_DEFINE), var(variable), e(expr) {}
+Define::Define(const string &variable, const Expr &expr) : ExprBase(E_DEFINE), var(variable), e(expr) {
+    nameLambda(e, var);
+}
 
 //BINDING CONSTRUCTS
 
 Let::Let(const vector<pair<string, Expr>> &vec, const Expr &e) : ExprBase(E_LET), bind(vec), body(e) {}
 
-Letrec::Letrec(const vector<pair<string, Expr>> &vec, const Expr &expr) : ExprBase(E_LETREC), bind(vec), body(expr) {}
+Letrec::Letrec(const vector<pair<string, Expr>> &vec, const Expr &expr) : ExprBase(E_LETREC), bind(vec), body(expr) {
+    for (auto &b : bind)
+        nameLambda(b.second, b.first);
+}
 
 //ASSIGNMENT
 
@@ -197,4 +249,162 @@ Set::Set(const std::string &var, const Expr &e) : ExprBase(E_SET), var(var), e(e
 
 //I/O OPERATIONS
 
-Display::Display(const Expr &r) : Unary(E_DISPLAY, r) {}
\ No newline at end of file
+Display::Display(const std::vector<Expr> &rands) : Variadic(E_DISPLAY, rands) {}
+
+Write::Write(const std::vector<Expr> &rands) : Variadic(E_WRITE, rands) {}
+
+Newline::Newline(const std::vector<Expr> &rands) : Variadic(E_NEWLINE, rands) {}
+
+FlushOutput::FlushOutput(const std::vector<Expr> &rands) : Variadic(E_FLUSH_OUTPUT, rands) {}
+
+CurrentOutputPort::CurrentOutputPort(const std::vector<Expr> &rands) : Variadic(E_CURRENT_OUTPUT_PORT, rands) {}
+
+OpenOutputString::OpenOutputString(const std::vector<Expr> &rands) : Variadic(E_OPEN_OUTPUT_STRING, rands) {}
+
+GetOutputString::GetOutputString(const Expr &r) : Unary(E_GET_OUTPUT_STRING, r) {}
+
+WithOutputToString::WithOutputToString(const Expr &r) : Unary(E_WITH_OUTPUT_TO_STRING, r) {}
+
+OpenInputFile::OpenInputFile(const Expr &r) : Unary(E_OPEN_INPUT_FILE, r) {}
+
+CloseInputPort::CloseInputPort(const Expr &r) : Unary(E_CLOSE_INPUT_PORT, r) {}
+
+CallWithInputFile::CallWithInputFile(const Expr &r1, const Expr &r2) : Binary(E_CALL_WITH_INPUT_FILE, r1, r2) {}
+
+ReadLine::ReadLine(const Expr &r) : Unary(E_READ_LINE, r) {}
+
+ReadChar::ReadChar(const Expr &r) : Unary(E_READ_CHAR, r) {}
+
+PeekChar::PeekChar(const Expr &r) : Unary(E_PEEK_CHAR, r) {}
+
+ReadDatum::ReadDatum(const Expr &r) : Unary(E_READ, r) {}
+
+MakeEof::MakeEof(const std::vector<Expr> &rands) : Variadic(E_EOF_OBJECT, rands) {}
+
+IsEof::IsEof(const Expr &r) : Unary(E_EOF_OBJECTQ, r) {}
+
+CommandLine::CommandLine(const std::vector<Expr> &rands) : Variadic(E_COMMAND_LINE, rands) {}
+
+//PERSISTENT COLLECTIONS
+
+MakeHashMap::MakeHashMap(const std::vector<Expr> &rands) : Variadic(E_HASHMAP, rands) {}
+
+IsHashMap::IsHashMap(const Expr &r1) : Unary(E_HASHMAPQ, r1) {}
+
+HashMapRef::HashMapRef(const std::vector<Expr> &rands) : Variadic(E_HASHMAP_REF, rands) {}
+
+HashMapSet::HashMapSet(const std::vector<Expr> &rands) : Variadic(E_HASHMAP_SET, rands) {}
+
+HashMapRemove::HashMapRemove(const Expr &r1, const Expr &r2) : Binary(E_HASHMAP_REMOVE, r1, r2) {}
+
+HashMapContains::HashMapContains(const Expr &r1, const Expr &r2) : Binary(E_HASHMAP_CONTAINSQ, r1, r2) {}
+
+HashMapCount::HashMapCount(const Expr &r1) : Unary(E_HASHMAP_COUNT, r1) {}
+
+HashMapToList::HashMapToList(const Expr &r1) : Unary(E_HASHMAP_TO_LIST, r1) {}
+
+HashMapSetBang::HashMapSetBang(const std::vector<Expr> &rands) : Variadic(E_HASHMAP_SET_BANG, rands) {}
+
+HashMapRemoveBang::HashMapRemoveBang(const Expr &r1, const Expr &r2) : Binary(E_HASHMAP_REMOVE_BANG, r1, r2) {}
+
+MakePVector::MakePVector(const std::vector<Expr> &rands) : Variadic(E_PVECTOR, rands) {}
+
+IsPVector::IsPVector(const Expr &r1) : Unary(E_PVECTORQ, r1) {}
+
+PVectorRef::PVectorRef(const Expr &r1, const Expr &r2) : Binary(E_PVECTOR_REF, r1, r2) {}
+
+PVectorSet::PVectorSet(const std::vector<Expr> &rands) : Variadic(E_PVECTOR_SET, rands) {}
+
+PVectorPush::PVectorPush(const Expr &r1, const Expr &r2) : Binary(E_PVECTOR_PUSH, r1, r2) {}
+
+PVectorLength::PVectorLength(const Expr &r1) : Unary(E_PVECTOR_LENGTH, r1) {}
+
+PVectorToList::PVectorToList(const Expr &r1) : Unary(E_PVECTOR_TO_LIST, r1) {}
+
+ListToPVector::ListToPVector(const Expr &r1) : Unary(E_LIST_TO_PVECTOR, r1) {}
+
+PVectorSetBang::PVectorSetBang(const std::vector<Expr> &rands) : Variadic(E_PVECTOR_SET_BANG, rands) {}
+
+PVectorPushBang::PVectorPushBang(const Expr &r1, const Expr &r2) : Binary(E_PVECTOR_PUSH_BANG, r1, r2) {}
+
+Transient::Transient(const Expr &r1) : Unary(E_TRANSIENT, r1) {}
+
+Persistent::Persistent(const Expr &r1) : Unary(E_PERSISTENT, r1) {}
+
+StringLength::StringLength(const Expr &r1) : Unary(E_STRING_LENGTH, r1) {}
+
+StringRef::StringRef(const Expr &r1, const Expr &r2) : Binary(E_STRING_REF, r1, r2) {}
+
+Substring::Substring(const std::vector<Expr> &rands) : Variadic(E_SUBSTRING, rands) {}
+
+StringAppend::StringAppend(const std::vector<Expr> &rands) : Variadic(E_STRING_APPEND, rands) {}
+
+StringEq::StringEq(const std::vector<Expr> &rands) : Variadic(E_STRING_EQ, rands) {}
+
+StringLess::StringLess(const std::vector<Expr> &rands) : Variadic(E_STRING_LT, rands) {}
+
+StringToSymbol::StringToSymbol(const Expr &r1) : Unary(E_STRING_TO_SYMBOL, r1) {}
+
+SymbolToString::SymbolToString(const Expr &r1) : Unary(E_SYMBOL_TO_STRING, r1) {}
+
+NumberToString::NumberToString(const Expr &r1) : Unary(E_NUMBER_TO_STRING, r1) {}
+
+StringToNumber::StringToNumber(const Expr &r1) : Unary(E_STRING_TO_NUMBER, r1) {}
+
+StringSearchForward::StringSearchForward(const std::vector<Expr> &rands) : Variadic(E_STRING_SEARCH_FORWARD, rands) {}
+
+StringIndex::StringIndex(const Expr &r1, const Expr &r2) : Binary(E_STRING_INDEX, r1, r2) {}
+
+StringContains::StringContains(const Expr &r1, const Expr &r2) : Binary(E_STRING_CONTAINS, r1, r2) {}
+
+FutureExpr::FutureExpr(const Expr &expr) : ExprBase(E_FUTURE), e(expr) {}
+
+Touch::Touch(const Expr &r) : Unary(E_TOUCH, r) {}
+
+PMap::PMap(const std::vector<Expr> &rands) : Variadic(E_PMAP, rands) {}
+
+PForEach::PForEach(const std::vector<Expr> &rands) : Variadic(E_PFOR_EACH, rands) {}
+
+Spawn::Spawn(const Expr &r) : Unary(E_SPAWN, r) {}
+
+Yield::Yield(const std::vector<Expr> &rands) : Variadic(E_YIELD, rands) {}
+
+MakeChannel::MakeChannel(const std::vector<Expr> &rands) : Variadic(E_MAKE_CHANNEL, rands) {}
+
+ChannelPut::ChannelPut(const Expr &r1, const Expr &r2) : Binary(E_CHANNEL_PUT, r1, r2) {}
+
+ChannelGet::ChannelGet(const Expr &r) : Unary(E_CHANNEL_GET, r) {}
+
+//ESCAPING CONTINUATIONS
+
+CallEC::CallEC(const Expr &r) : Unary(E_CALLEC, r) {}
+
+ContinuationCall::ContinuationCall(const std::shared_ptr<ContinuationFrame> &f)
+    : Variadic(E_CONTINUATION, std::vector<Expr>()), frame(f) {}
+
+//EVENT LOOP
+
+After::After(const Expr &r1, const Expr &r2) : Binary(E_AFTER, r1, r2) {}
+
+ReadFileAsync::ReadFileAsync(const Expr &r1, const Expr &r2) : Binary(E_READ_FILE_ASYNC, r1, r2) {}
+
+OnReadable::OnReadable(const Expr &r1, const Expr &r2) : Binary(E_ON_READABLE, r1, r2) {}
+
+RunEventLoop::RunEventLoop(const std::vector<Expr> &rands) : Variadic(E_RUN_EVENT_LOOP, rands) {}
+
+//PROFILER
+
+ProfileStart::ProfileStart(const std::vector<Expr> &rands) : Variadic(E_PROFILE_START, rands) {}
+
+ProfileStop::ProfileStop(const std::vector<Expr> &rands) : Variadic(E_PROFILE_STOP, rands) {}
+
+//RUNTIME STATISTICS
+
+RuntimeStats::RuntimeStats(const std::vector<Expr> &rands) : Variadic(E_RUNTIME_STATS, rands) {}
+
+TimeExpr::TimeExpr(const Expr &expr) : ExprBase(E_TIME), e(expr) {}
+
+//NATIVE PROCEDURES
+
+NativeCall::NativeCall(const std::string &nm, int lo, int hi, const NativeFunction &f)
+    : Variadic(E_NATIVE, std::vector<Expr>()), name(nm), min_args(lo), max_args(hi), fn(f) {}
@@ -21,6 +21,7 @@ public:
 #include "syntax.hpp"
 #include <memory>
 #include <cstring>
+#include <functional>
 #include <vector>
 
 struct ExprBase{
@@ -69,7 +70,7 @@ struct RationalNum : ExprBase {
  * Represents string values
  */
 struct StringExpr : ExprBase {
-  std::string s;
+  std::shared_ptr<const std::string> s;
   StringExpr(const std::string &);
   virtual Value eval(Assoc &) override;
 };
@@ -268,6 +269,110 @@ struct SetCdr : Binary {
     virtual Value evalRator(const Value &, const Value &) override;
 };
 
+struct Length : Unary {
+    Length(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct Append : Variadic {
+    Append(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct Reverse : Unary {
+    Reverse(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct ListTail : Binary {
+    ListTail(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct ListRef : Binary {
+    ListRef(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct Memq : Binary {
+    Memq(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct Assq : Binary {
+    Assq(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct Assoc_ : Binary {
+    Assoc_(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+// ================================================================================
+//                             HIGHER-ORDER PROCEDURES
+// ================================================================================
+
+struct MapFunc : Variadic {
+    MapFunc(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct ForEach : Variadic {
+    ForEach(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct Filter : Variadic {
+    Filter(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct FoldLeft : Variadic {
+    FoldLeft(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct FoldRight : Variadic {
+    FoldRight(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct ApplyFunc : Variadic {
+    ApplyFunc(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct Sort : Binary {
+    Sort(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct SortBang : Binary {
+    SortBang(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+/**
+ * @brief Fused chain of map/filter stages feeding one consumer
+ *
+ * Built by fusePipelines() (optimize.cpp) from nested calls such as
+ * (fold-left f init (map g (filter p xs))). Operands are evaluated in the
+ * order of the original nesting; when every procedure involved is free of
+ * side effects the list is traversed once without building intermediate
+ * lists, otherwise the stages run one after another exactly as unfused.
+ */
+struct ListPipeline : ExprBase {
+    std::vector<std::pair<ExprType, Expr>> stages; ///< E_MAP/E_FILTER, innermost first
+    ExprType sink;      ///< E_LIST, E_FOLD_LEFT, E_FOLD_RIGHT, E_FOR_EACH or E_LENGTH
+    Expr sink_proc;     ///< Procedure of a fold/for-each sink, else nullptr
+    Expr sink_init;     ///< Initial value of a fold sink, else nullptr
+    Expr source;        ///< Innermost list argument
+    ListPipeline(const std::vector<std::pair<ExprType, Expr>> &, ExprType,
+                 const Expr &, const Expr &, const Expr &);
+    virtual Value eval(Assoc &) override;
+};
+
 // ================================================================================
 //                             LOGIC OPERATIONS
 // ================================================================================
@@ -392,6 +497,7 @@ struct Apply : ExprBase {
 struct Lambda : ExprBase {
     std::vector<std::string> x;
     Expr e;
+    const std::string *name;    ///< Set by the define or letrec binding it, for the profiler
     Lambda(const std::vector<std::string> &, const Expr &);
     virtual Value eval(Assoc &) override;
 };
@@ -436,9 +542,508 @@ struct Set : ExprBase {
 //                              I/O OPERATIONS
 // ================================================================================
 
-struct Display : Unary {
-    Display(const Expr &);
+/**
+ * @brief Output primitives; the optional last argument of display, write,
+ *        newline and flush-output is the port, default (current-output-port)
+ */
+struct Display : Variadic {
+    Display(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct Write : Variadic {
+    Write(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct Newline : Variadic {
+    Newline(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct FlushOutput : Variadic {
+    FlushOutput(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct CurrentOutputPort : Variadic {
+    CurrentOutputPort(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct OpenOutputString : Variadic {
+    OpenOutputString(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct GetOutputString : Unary {
+    GetOutputString(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief (with-output-to-string thunk): calls thunk with a fresh string port
+ *        as the current output port and returns what it printed
+ */
+struct WithOutputToString : Unary {
+    WithOutputToString(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief Input primitives; ports come from open-input-file, and
+ *        read-char/peek-char return a string of length one (no char type)
+ */
+struct OpenInputFile : Unary {
+    OpenInputFile(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct CloseInputPort : Unary {
+    CloseInputPort(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief (call-with-input-file path proc): the port is closed when proc
+ *        returns or raises
+ */
+struct CallWithInputFile : Binary {
+    CallWithInputFile(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct ReadLine : Unary {
+    ReadLine(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct ReadChar : Unary {
+    ReadChar(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct PeekChar : Unary {
+    PeekChar(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct ReadDatum : Unary {
+    ReadDatum(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct MakeEof : Variadic {
+    MakeEof(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct IsEof : Unary {
+    IsEof(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief (command-line): list of strings, the script path followed by its
+ *        arguments; empty when reading from standard input
+ */
+struct CommandLine : Variadic {
+    CommandLine(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+// ================================================================================
+//                             PERSISTENT COLLECTIONS
+// ================================================================================
+
+struct MakeHashMap : Variadic {
+    MakeHashMap(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct IsHashMap : Unary {
+    IsHashMap(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct HashMapRef : Variadic {
+    HashMapRef(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct HashMapSet : Variadic {
+    HashMapSet(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct HashMapRemove : Binary {
+    HashMapRemove(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct HashMapContains : Binary {
+    HashMapContains(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct HashMapCount : Unary {
+    HashMapCount(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct HashMapToList : Unary {
+    HashMapToList(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct HashMapSetBang : Variadic {
+    HashMapSetBang(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct HashMapRemoveBang : Binary {
+    HashMapRemoveBang(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct MakePVector : Variadic {
+    MakePVector(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct IsPVector : Unary {
+    IsPVector(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct PVectorRef : Binary {
+    PVectorRef(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct PVectorSet : Variadic {
+    PVectorSet(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct PVectorPush : Binary {
+    PVectorPush(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct PVectorLength : Unary {
+    PVectorLength(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct PVectorToList : Unary {
+    PVectorToList(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct ListToPVector : Unary {
+    ListToPVector(const Expr &);
     virtual Value evalRator(const Value &) override;
 };
 
+struct PVectorSetBang : Variadic {
+    PVectorSetBang(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct PVectorPushBang : Binary {
+    PVectorPushBang(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct Transient : Unary {
+    Transient(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct Persistent : Unary {
+    Persistent(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+// ================================================================================
+//                                 STRINGS
+// ================================================================================
+
+struct StringLength : Unary {
+    StringLength(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief (string-ref s k); there is no character type, so the result is a
+ *        string of length one sharing s's bytes
+ */
+struct StringRef : Binary {
+    StringRef(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct Substring : Variadic {
+    Substring(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct StringAppend : Variadic {
+    StringAppend(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct StringEq : Variadic {
+    StringEq(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct StringLess : Variadic {
+    StringLess(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct StringToSymbol : Unary {
+    StringToSymbol(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct SymbolToString : Unary {
+    SymbolToString(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct NumberToString : Unary {
+    NumberToString(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct StringToNumber : Unary {
+    StringToNumber(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief (string-search-forward pattern s [start]): index of the first match
+ *        at or after start, or #f
+ */
+struct StringSearchForward : Variadic {
+    StringSearchForward(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+/**
+ * @brief (string-index s c): index of the first c in s, or #f; c is a string
+ *        of length one, as returned by string-ref
+ */
+struct StringIndex : Binary {
+    StringIndex(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+/**
+ * @brief (string-contains s pattern): index of the first match, or #f
+ */
+struct StringContains : Binary {
+    StringContains(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+// ================================================================================
+//                          FUTURES AND PARALLEL MAP
+// ================================================================================
+
+/**
+ * @brief (future expr): evaluates expr on the pool (see parallel.hpp)
+ */
+struct FutureExpr : ExprBase {
+    Expr e;
+    FutureExpr(const Expr &);
+    virtual Value eval(Assoc &) override;
+};
+
+/**
+ * @brief (touch f): value of a future, waiting for it if needed
+ */
+struct Touch : Unary {
+    Touch(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+/**
+ * @brief (pmap f l1 l2 ...) and (pfor-each f l1 l2 ...): map and for-each
+ *        with the calls run on the pool
+ */
+struct PMap : Variadic {
+    PMap(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct PForEach : Variadic {
+    PForEach(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+// ================================================================================
+//                        GREEN THREADS AND CHANNELS
+// ================================================================================
+
+/**
+ * @brief (spawn thunk), (yield), (make-channel [n]), (channel-put ch v) and
+ *        (channel-get ch); see green.hpp
+ */
+struct Spawn : Unary {
+    Spawn(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct Yield : Variadic {
+    Yield(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct MakeChannel : Variadic {
+    MakeChannel(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+struct ChannelPut : Binary {
+    ChannelPut(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct ChannelGet : Unary {
+    ChannelGet(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+// ================================================================================
+//                           ESCAPING CONTINUATIONS
+// ================================================================================
+
+/**
+ * @brief (call/ec proc): calls proc with a procedure k that makes the
+ *        call/ec return its argument at once
+ *
+ * k unwinds the evaluator's own frames (see escaping_frame in value.hpp);
+ * no stack is copied, so it only works during the dynamic extent of the
+ * call/ec and on the same stack (not from inside a future or green thread
+ * started within it). Calling k after the call/ec has returned raises
+ * RuntimeError. call/cc and call-with-current-continuation are bound to the
+ * same thing: a one-shot continuation, enough for early exits, but code
+ * that re-enters a continuation gets that RuntimeError.
+ */
+struct CallEC : Unary {
+    CallEC(const Expr &);
+    virtual Value evalRator(const Value &) override;
+};
+
+struct ContinuationFrame;
+
+/**
+ * @brief Body of a continuation procedure: (k) or (k v) escapes to frame
+ */
+struct ContinuationCall : Variadic {
+    std::shared_ptr<ContinuationFrame> frame;
+    ContinuationCall(const std::shared_ptr<ContinuationFrame> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+// ================================================================================
+//                                EVENT LOOP
+// ================================================================================
+
+/**
+ * @brief (after ms thunk), (read-file-async path proc), (on-readable fd proc)
+ *        and (run-event-loop); see events.hpp
+ */
+struct After : Binary {
+    After(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct ReadFileAsync : Binary {
+    ReadFileAsync(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct OnReadable : Binary {
+    OnReadable(const Expr &, const Expr &);
+    virtual Value evalRator(const Value &, const Value &) override;
+};
+
+struct RunEventLoop : Variadic {
+    RunEventLoop(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+// ================================================================================
+//                                 PROFILER
+// ================================================================================
+
+/**
+ * @brief (profile-start) discards earlier samples and starts sampling;
+ *        see profile.hpp
+ */
+struct ProfileStart : Variadic {
+    ProfileStart(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+/**
+ * @brief (profile-stop [path]) stops sampling, writes the collapsed stacks
+ *        to path if given and the top-procedure table to the current output port
+ */
+struct ProfileStop : Variadic {
+    ProfileStop(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+// ================================================================================
+//                             RUNTIME STATISTICS
+// ================================================================================
+
+/**
+ * @brief (runtime-stats): allocation counters as an association list, #f when
+ *        they were compiled out; see stats.hpp
+ */
+struct RuntimeStats : Variadic {
+    RuntimeStats(const std::vector<Expr> &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
+/**
+ * @brief (time expr): evaluates expr and reports its wall time, CPU time
+ *        and allocations on the current output port
+ */
+struct TimeExpr : ExprBase {
+    Expr e;
+    TimeExpr(const Expr &);
+    virtual Value eval(Assoc &) override;
+};
+
+// ================================================================================
+//                             NATIVE PROCEDURES
+// ================================================================================
+
+/**
+ * @brief C++ function callable from Scheme: args points at the n evaluated
+ *        arguments in the caller's argument vector (no copies are made)
+ */
+typedef std::function<Value(const Value *args, size_t n)> NativeFunction;
+
+/**
+ * @brief Body of a procedure registered with Interpreter::defineNative;
+ *        checks the argument count and calls fn
+ */
+struct NativeCall : Variadic {
+    std::string name;
+    int min_args;       ///< Fewest arguments accepted
+    int max_args;       ///< Most arguments accepted, or -1 for no limit
+    NativeFunction fn;
+    NativeCall(const std::string &, int, int, const NativeFunction &);
+    virtual Value evalRator(const std::vector<Value> &) override;
+};
+
 #endif
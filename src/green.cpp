@@ -0,0 +1,368 @@
+/**
+ * @file green.cpp
+ * @brief Green thread scheduler, task stacks and context switching
+ */
+
+#include "green.hpp"
+#include "interpreter.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "RE.hpp"
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define GREEN_ASM_SWITCH 1
+#else
+#include <ucontext.h>
+#endif
+
+/**
+ * @brief A green thread; the main program is one with no stack of its own
+ */
+struct GreenTask {
+#ifdef GREEN_ASM_SWITCH
+    void *sp;                   ///< Saved stack pointer while switched out
+#else
+    ucontext_t uc;
+#endif
+    char *stack;                ///< Mapping (guard page first), nullptr for the main program
+    Value thunk;
+    Value output;               ///< This task's (current-output-port)
+    Value *saved_output;        ///< task_output while switched out
+    const void *saved_segment;  ///< stack_segment while switched out
+    ShadowFrame *saved_shadow;  ///< shadow_top (profile.hpp) while switched out
+    const char *saved_limit;    ///< stack_limit while switched out
+    Value passed;               ///< Item handed over by a channel while waiting
+    Channel *waiting;           ///< Channel waited on, or nullptr
+    bool cancelled;             ///< Unwind at the next switch back
+    bool deadlocked;            ///< Woken because no task could run
+    GreenTask() : stack(nullptr), thunk(nullptr), output(nullptr), saved_output(nullptr),
+                  saved_segment(nullptr), saved_shadow(nullptr), saved_limit(nullptr), passed(nullptr), waiting(nullptr), cancelled(false), deadlocked(false) {}
+};
+
+/**
+ * @brief Thrown inside a task that is being unwound; only run() catches it
+ */
+struct GreenCancel {};
+
+#ifdef GREEN_ASM_SWITCH
+extern "C" void scheme_green_switch(void **save_sp, void *next_sp);
+extern "C" void scheme_green_start();
+extern "C" void scheme_green_entry(GreenTask *);
+
+// 保存被调用者保存的寄存器与 MXCSR/x87 控制字，换栈后按相反顺序恢复
+asm(R"(
+    .text
+    .globl scheme_green_switch
+    .hidden scheme_green_switch
+    .type scheme_green_switch, @function
+scheme_green_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size scheme_green_switch, .-scheme_green_switch
+
+    .globl scheme_green_start
+    .hidden scheme_green_start
+    .type scheme_green_start, @function
+scheme_green_start:
+    .cfi_startproc
+    .cfi_undefined rip
+    movq %r12, %rdi
+    andq $-16, %rsp
+    call scheme_green_entry@PLT
+    ud2
+    .cfi_endproc
+    .size scheme_green_start, .-scheme_green_start
+)");
+
+// 新任务的栈顶伪造成一次 scheme_green_switch 保存的现场，返回地址是 scheme_green_start
+static void initContext(GreenTask *t) {
+    uintptr_t top = reinterpret_cast<uintptr_t>(t->stack + getpagesize() + GREEN_STACK_SIZE) & ~uintptr_t(15);
+    void **sp = reinterpret_cast<void**>(top);
+    *--sp = nullptr;
+    *--sp = reinterpret_cast<void*>(&scheme_green_start);
+    *--sp = nullptr;        // rbp
+    *--sp = nullptr;        // rbx
+    *--sp = t;              // r12: 交给 scheme_green_entry 的参数
+    *--sp = nullptr;        // r13
+    *--sp = nullptr;        // r14
+    *--sp = nullptr;        // r15
+    --sp;
+    uint32_t *control = reinterpret_cast<uint32_t*>(sp);
+    control[0] = 0x1F80;    // MXCSR 默认值
+    control[1] = 0x037F;    // x87 控制字默认值
+    t->sp = sp;
+}
+
+static void switchContext(GreenTask *from, GreenTask *to) {
+    scheme_green_switch(&from->sp, to->sp);
+}
+#else
+static void greenTrampoline(unsigned hi, unsigned lo);
+
+static void initContext(GreenTask *t) {
+    getcontext(&t->uc);
+    t->uc.uc_stack.ss_sp = t->stack + getpagesize();
+    t->uc.uc_stack.ss_size = GREEN_STACK_SIZE;
+    t->uc.uc_link = nullptr;
+    uintptr_t p = reinterpret_cast<uintptr_t>(t);
+    makecontext(&t->uc, reinterpret_cast<void (*)()>(greenTrampoline), 2,
+                static_cast<unsigned>(p >> 32), static_cast<unsigned>(p));
+}
+
+static void switchContext(GreenTask *from, GreenTask *to) {
+    swapcontext(&from->uc, &to->uc);
+}
+#endif
+
+extern "C" void scheme_green_entry(GreenTask *t) {
+    greenScheduler().run(t);
+}
+
+#ifndef GREEN_ASM_SWITCH
+static void greenTrampoline(unsigned hi, unsigned lo) {
+    scheme_green_entry(reinterpret_cast<GreenTask*>((uintptr_t(hi) << 32) | lo));
+}
+#endif
+
+// 保留的空闲栈个数上限；更多的直接 munmap
+static const size_t STACK_CACHE = 64;
+
+// 把等待中的任务从它所在的通道队列里摘下来
+static void unqueue(GreenTask *t) {
+    Channel *ch = t->waiting;
+    for (auto *queue : {&ch->getters, &ch->putters}) {
+        for (auto it = queue->begin(); it != queue->end(); ++it) {
+            if (*it == t) {
+                queue->erase(it);
+                break;
+            }
+        }
+    }
+    t->waiting = nullptr;
+}
+
+GreenScheduler::GreenScheduler() : root(new GreenTask), current(root), dead(nullptr) {}
+
+GreenScheduler::~GreenScheduler() {
+    // 让仍在等待或尚未结束的任务各自展开，释放它们栈上引用的值
+    while (!live.empty()) {
+        for (GreenTask *t : live) {
+            t->cancelled = true;
+            if (t->waiting != nullptr) {
+                unqueue(t);
+                ready.push_back(t);
+            }
+        }
+        drain();
+    }
+    reap();
+    for (char *s : stacks) {
+        munmap(s, getpagesize() + GREEN_STACK_SIZE);
+    }
+    delete root;
+}
+
+void GreenScheduler::spawn(const Value &thunk) {
+    GreenTask *t = new GreenTask;
+    if (!stacks.empty()) {
+        t->stack = stacks.back();
+        stacks.pop_back();
+    } else {
+        size_t size = getpagesize() + GREEN_STACK_SIZE;
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (p == MAP_FAILED) {
+            delete t;
+            throw RuntimeError("spawn: cannot allocate a task stack");
+        }
+        mprotect(p, getpagesize(), PROT_NONE); // 栈溢出时落在保护页上
+        t->stack = static_cast<char*>(p);
+    }
+    t->thunk = thunk;
+    t->output = currentOutputPort();
+    t->saved_output = &t->output;
+    t->saved_segment = t;
+    t->saved_limit = t->stack + getpagesize() + STACK_RESERVE;
+    initContext(t);
+    live.insert(t);
+    ready.push_back(t);
+}
+
+void GreenScheduler::switchTo(GreenTask *t) {
+    GreenTask *from = current;
+    from->saved_output = task_output;
+    from->saved_segment = stack_segment;
+    from->saved_shadow = shadow_top;
+    from->saved_limit = stack_limit;
+    current = t;
+    task_output = t->saved_output;
+    stack_segment = t->saved_segment;
+    shadow_top = t->saved_shadow;
+    stack_limit = t->saved_limit;
+    switchContext(from, t);
+    // 回到 from：之前结束的任务此时已不在自己的栈上
+    reap();
+}
+
+void GreenScheduler::reap() {
+    if (dead != nullptr && dead != current) {
+        if (stacks.size() < STACK_CACHE) {
+            stacks.push_back(dead->stack);
+        } else {
+            munmap(dead->stack, getpagesize() + GREEN_STACK_SIZE);
+        }
+        delete dead;
+        dead = nullptr;
+    }
+}
+
+// 下一个运行的任务；没有可运行的任务时回到主程序，主程序若也在等待就报告死锁
+GreenTask *GreenScheduler::next() {
+    if (!ready.empty()) {
+        GreenTask *t = ready.front();
+        ready.pop_front();
+        return t;
+    }
+    if (root->waiting != nullptr) {
+        unqueue(root);
+        root->deadlocked = true;
+    }
+    return root;
+}
+
+void GreenScheduler::run(GreenTask *t) {
+    reap();
+    if (!t->cancelled) {
+        try {
+            std::vector<Value> no_args;
+            applyProcedure(t->thunk, no_args);
+        } catch (const RuntimeError &) {
+            Interpreter::current().reportError();
+        } catch (const GreenCancel &) {
+        }
+    }
+    t->thunk = Value(nullptr);
+    t->output = Value(nullptr);
+    live.erase(t);
+    dead = t;
+    switchTo(next());
+}
+
+void GreenScheduler::yield() {
+    if (current->cancelled) {
+        throw GreenCancel();
+    }
+    if (ready.empty()) {
+        return;
+    }
+    ready.push_back(current);
+    GreenTask *t = ready.front();
+    ready.pop_front();
+    switchTo(t);
+    if (current->cancelled) {
+        throw GreenCancel();
+    }
+}
+
+// 在 queue 上排队等待 ch，直到被 put/get 唤醒
+void GreenScheduler::wait(std::deque<GreenTask*> &queue, Channel *ch) {
+    if (current->cancelled) {
+        throw GreenCancel();
+    }
+    if (current == root && ready.empty()) {
+        throw RuntimeError("Deadlock: every task is waiting on a channel");
+    }
+    current->waiting = ch;
+    queue.push_back(current);
+    switchTo(next());
+    if (current->cancelled) {
+        throw GreenCancel();
+    }
+    if (current->deadlocked) {
+        current->deadlocked = false;
+        current->passed = Value(nullptr);
+        throw RuntimeError("Deadlock: every task is waiting on a channel");
+    }
+}
+
+void GreenScheduler::put(Channel *ch, const Value &v) {
+    checkUnshared(ch->owner);
+    if (!ch->getters.empty()) { // 直接交给等待最久的取值者
+        GreenTask *t = ch->getters.front();
+        ch->getters.pop_front();
+        t->passed = v;
+        t->waiting = nullptr;
+        ready.push_back(t);
+        return;
+    }
+    if (ch->capacity == 0 || ch->items.size() < ch->capacity) {
+        ch->items.push_back(v);
+        return;
+    }
+    current->passed = v;
+    wait(ch->putters, ch); // 取值者腾出位置时把 passed 放进通道
+}
+
+Value GreenScheduler::get(Channel *ch) {
+    checkUnshared(ch->owner);
+    if (!ch->items.empty()) {
+        Value v = ch->items.front();
+        ch->items.pop_front();
+        if (!ch->putters.empty()) {
+            GreenTask *t = ch->putters.front();
+            ch->putters.pop_front();
+            ch->items.push_back(t->passed);
+            t->passed = Value(nullptr);
+            t->waiting = nullptr;
+            ready.push_back(t);
+        }
+        return v;
+    }
+    wait(ch->getters, ch);
+    Value v = current->passed;
+    current->passed = Value(nullptr);
+    return v;
+}
+
+void GreenScheduler::drain() {
+    while (!ready.empty()) {
+        ready.push_back(current);
+        GreenTask *t = ready.front();
+        ready.pop_front();
+        switchTo(t);
+    }
+}
+
+GreenScheduler &greenScheduler() {
+    if (inFuture()) {
+        throw RuntimeError("Green threads cannot be used inside a future");
+    }
+    Interpreter &interp = Interpreter::current();
+    if (interp.green == nullptr) {
+        interp.green = new GreenScheduler;
+    }
+    return *interp.green;
+}
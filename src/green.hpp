@@ -0,0 +1,90 @@
+#ifndef GREEN
+#define GREEN
+
+/**
+ * @file green.hpp
+ * @brief Green threads and channels on one OS thread
+ *
+ * (spawn thunk) creates a task that will call thunk on a stack of its own;
+ * (yield) lets the other runnable tasks run first. (make-channel [n]) makes a
+ * FIFO channel holding at most n values (no limit if n is 0 or omitted);
+ * (channel-put ch v) waits while the channel is full and (channel-get ch)
+ * waits while it is empty. The main program is a task too: spawned tasks
+ * first run when it yields or waits on a channel, and the ones still
+ * runnable when the input ends are run to completion before exit.
+ *
+ * Task stacks are mmap'd (GREEN_STACK_SIZE each, behind a guard page) and
+ * reused; pages are only committed as the evaluator recursion touches them.
+ * Switching saves the callee-saved registers and swaps stack pointers (a
+ * few instructions on x86-64; ucontext elsewhere). Each task keeps its own
+ * (current-output-port).
+ *
+ * A task that raises an error prints "RuntimeError" like a failed top-level
+ * form; the value of its thunk is ignored. If every task, the main program
+ * included, is waiting on a channel, the main program's wait raises
+ * RuntimeError. Tasks still waiting when the interpreter is destroyed are
+ * unwound. Green threads belong to the interpreter's own thread: spawn,
+ * yield and the channel operations raise RuntimeError inside a future.
+ */
+
+#include "value.hpp"
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Usable stack size of one task (the usual main thread limit)
+ */
+const size_t GREEN_STACK_SIZE = size_t(8) << 20;
+
+struct GreenTask;
+
+/**
+ * @brief The tasks of one interpreter and the switching between them
+ */
+class GreenScheduler {
+public:
+    GreenScheduler();
+    ~GreenScheduler();
+    GreenScheduler(const GreenScheduler &) = delete;
+    GreenScheduler &operator=(const GreenScheduler &) = delete;
+
+    void spawn(const Value &thunk);
+    void yield();
+    void put(Channel *, const Value &);
+    Value get(Channel *);
+
+    /**
+     * @brief Called by the main program: runs tasks until none is runnable
+     */
+    void drain();
+
+    /**
+     * @brief True if some task other than the running one can run
+     */
+    bool runnable() const { return !ready.empty(); }
+
+    /**
+     * @brief Entry point of a new task (runs on its stack)
+     */
+    void run(GreenTask *);
+
+private:
+    GreenTask *root;                    ///< The main program
+    GreenTask *current;
+    std::deque<GreenTask*> ready;
+    std::unordered_set<GreenTask*> live; ///< Spawned and not finished
+    GreenTask *dead;                    ///< Finished; freed once switched away from
+    std::vector<char*> stacks;          ///< Stacks kept for reuse
+    void switchTo(GreenTask *);
+    void wait(std::deque<GreenTask*> &queue, Channel *);
+    GreenTask *next();
+    void reap();
+};
+
+/**
+ * @brief Scheduler of the current interpreter, created on first use
+ */
+GreenScheduler &greenScheduler();
+
+#endif // GREEN
@@ -0,0 +1,118 @@
+/**
+ * @file immortal.cpp
+ * @brief Pinning an interpreter's heap before fork() (see immortal.hpp)
+ */
+
+#include "immortal.hpp"
+#include "persistent.hpp"
+#include <memory>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Walk state: the shared owner of all aliases plus explicit stacks
+ */
+struct Immortalizer {
+    std::shared_ptr<std::vector<std::shared_ptr<void>>> keep; ///< Owns the originals
+    std::unordered_set<const void*> seen;
+    std::vector<ValueBase*> values;
+    std::vector<AssocList*> envs;
+    std::vector<HamtNode*> hamts;
+    std::vector<PVecNode*> pvecs;
+    size_t pinned;
+
+    Immortalizer() : keep(std::make_shared<std::vector<std::shared_ptr<void>>>()), pinned(0) {
+        new std::shared_ptr<void>(keep); // 永不释放：别名指针的引用计数永远不会归零
+    }
+
+    // 把 p 换成共用 keep 控制块的别名；首次见到的对象返回其地址以便继续遍历
+    template <class T>
+    T *pin(std::shared_ptr<T> &p) {
+        if (!p) return nullptr;
+        if (!p.owner_before(keep) && !keep.owner_before(p)) return nullptr; // 已是别名
+        keep->push_back(std::const_pointer_cast<typename std::remove_const<T>::type>(p));
+        p = std::shared_ptr<T>(keep, p.get());
+        pinned++;
+        return seen.insert(p.get()).second ? p.get() : nullptr;
+    }
+
+    void value(Value &v) {
+        if (ValueBase *p = pin(v.ptr)) values.push_back(p);
+    }
+
+    void env(Assoc &a) {
+        if (AssocList *p = pin(a.ptr)) envs.push_back(p);
+    }
+
+    void visit(ValueBase *v) {
+        switch (v->v_type) {
+        case V_PAIR: {
+            Pair *p = static_cast<Pair*>(v);
+            value(p->car);
+            value(p->cdr);
+            break;
+        }
+        case V_PROC:
+            env(static_cast<Procedure*>(v)->env);
+            break;
+        case V_STRING: {
+            String *s = static_cast<String*>(v);
+            s->data(); // 先把绳压平，子进程里就不会再改写它
+            pin(s->buf);
+            break;
+        }
+        case V_HASHMAP:
+            if (HamtNode *n = pin(static_cast<HashMap*>(v)->root)) hamts.push_back(n);
+            break;
+        case V_PVECTOR: {
+            PVector *pv = static_cast<PVector*>(v);
+            if (PVecNode *n = pin(pv->root)) pvecs.push_back(n);
+            if (PVecNode *n = pin(pv->tail)) pvecs.push_back(n);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void run() {
+        while (!values.empty() || !envs.empty() || !hamts.empty() || !pvecs.empty()) {
+            if (!values.empty()) {
+                ValueBase *v = values.back();
+                values.pop_back();
+                visit(v);
+            } else if (!envs.empty()) {
+                AssocList *a = envs.back();
+                envs.pop_back();
+                value(a->v);
+                env(a->next);
+            } else if (!hamts.empty()) {
+                HamtNode *n = hamts.back();
+                hamts.pop_back();
+                for (auto &e : n->entries) {
+                    value(e.key);
+                    value(e.val);
+                    if (HamtNode *c = pin(e.child)) hamts.push_back(c);
+                }
+            } else {
+                PVecNode *n = pvecs.back();
+                pvecs.pop_back();
+                for (auto &k : n->kids) {
+                    if (PVecNode *c = pin(k)) pvecs.push_back(c);
+                }
+                for (auto &x : n->vals) value(x);
+            }
+        }
+    }
+};
+
+size_t immortalize(Interpreter &interp) {
+    Immortalizer im;
+    im.env(interp.global_env);
+    for (auto &s : interp.symbols) im.value(s.second);
+    for (auto &p : interp.primitive_procs) im.value(p.second);
+    im.value(interp.command_line);
+    im.run();
+    return im.pinned;
+}
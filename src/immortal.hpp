@@ -0,0 +1,29 @@
+#ifndef IMMORTAL
+#define IMMORTAL
+
+/**
+ * @file immortal.hpp
+ * @brief Pinning an interpreter's heap before fork()
+ *
+ * Values are held by std::shared_ptr, so merely reading a value (a variable
+ * lookup, walking the environment chain) writes its reference count. In a
+ * forked child every such write copies a page of the parent's heap.
+ *
+ * immortalize() walks everything reachable from the interpreter's global
+ * environment, symbol table and primitive cache, and replaces each owning
+ * pointer on the way with an aliasing pointer that shares one common,
+ * never released control block. From then on, copying any of those
+ * pointers touches only that one control block; the objects themselves are
+ * never freed. Procedure bodies (Expr trees) are not rewritten: the
+ * evaluator reaches them through raw pointers.
+ */
+
+#include "interpreter.hpp"
+
+/**
+ * @brief Flattens ropes and pins every object reachable from the
+ *        interpreter's roots; returns the number of pointers rewritten
+ */
+size_t immortalize(Interpreter &);
+
+#endif // IMMORTAL
@@ -0,0 +1,287 @@
+/**
+ * @file interpreter.cpp
+ * @brief Interpreter instances and the top-level read-eval-print loops
+ */
+
+#include "interpreter.hpp"
+#include "syntax.hpp"
+#include "expr.hpp"
+#include "RE.hpp"
+#include "optimize.hpp"
+#include "pipeline.hpp"
+#include "parallel.hpp"
+#include "green.hpp"
+#include "events.hpp"
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+
+static thread_local Interpreter *current_interpreter = nullptr;
+
+Interpreter::Interpreter(int fd)
+    : global_env(empty()), out(OutputPortV(fd)), current_out(out), command_line(NullV()),
+      structure_mutated(false), running_futures(0), green(nullptr), events(nullptr),
+      parse_ahead(false), read_threads(0), quiet(false) {}
+
+Interpreter::~Interpreter() {
+    waitForFutures(*this); // 池线程可能仍在使用本实例
+    static_cast<OutputPort*>(out.get()) -> flush();
+    // 全局环境中的闭包又引用全局环境：先清空绑定断开这些环，再逐个释放结点（链可能很长）
+    InterpreterScope scope(*this);
+    delete events; // 未触发的回调直接丢弃
+    events = nullptr;
+    delete green; // 展开仍在等待的任务
+    green = nullptr;
+    for (Assoc a = global_env; a.get() != nullptr; a = a -> next)
+        a -> v = Value(nullptr);
+    while (global_env.get() != nullptr){
+        Assoc next = global_env -> next;
+        global_env = next;
+    }
+    primitive_procs.clear();
+    symbols.clear();
+}
+
+const std::string &Interpreter::output(){
+    return static_cast<OutputPort*>(out.get()) -> buf;
+}
+
+Interpreter &Interpreter::current(){
+    if (current_interpreter != nullptr)
+        return *current_interpreter;
+    static Interpreter fallback(1);
+    return fallback;
+}
+
+InterpreterScope::InterpreterScope(Interpreter &interp) : saved(current_interpreter) {
+    current_interpreter = &interp;
+    if (stack_limit == nullptr) // 本线程第一次求值
+        initStackLimit();
+}
+
+InterpreterScope::~InterpreterScope() {
+    current_interpreter = saved;
+}
+
+static bool isExplicitVoidCall(Expr expr) {
+    MakeVoid* make_void_expr = dynamic_cast<MakeVoid*>(expr.get());
+    if (make_void_expr != nullptr) {
+        return true;
+    }
+    
+    Apply* apply_expr = dynamic_cast<Apply*>(expr.get());
+    if (apply_expr != nullptr) {
+        Var* var_expr = dynamic_cast<Var*>(apply_expr->rator.get());
+        if (var_expr != nullptr && var_expr->x == "void") {
+            return true;
+        }
+    }
+    
+    Begin* begin_expr = dynamic_cast<Begin*>(expr.get());
+    if (begin_expr != nullptr && !begin_expr->es.empty()) {
+        return isExplicitVoidCall(begin_expr->es.back());
+    }
+    
+    If* if_expr = dynamic_cast<If*>(expr.get());
+    if (if_expr != nullptr) {
+        return isExplicitVoidCall(if_expr->conseq) || isExplicitVoidCall(if_expr->alter);
+    }
+    
+    Cond* cond_expr = dynamic_cast<Cond*>(expr.get());
+    if (cond_expr != nullptr) {
+        for (const auto& clause : cond_expr->clauses) {
+            if (clause.size() > 1 && isExplicitVoidCall(clause.back())) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Evaluates a parsed top-level form and (unless quiet) prints its value
+ *
+ * Returns false if the form called (exit).
+ */
+static bool runForm(const Expr &expr, Assoc &global_env, OutputPort *out, bool quiet){
+    Value val = expr -> eval(global_env);
+    if (val -> v_type == V_TERMINATE)
+        return false;
+    if (quiet)
+        return true;
+    ParallelGuard guard(out -> lock);
+    if(val->v_type!=V_VOID||isExplicitVoidCall(expr)){
+        val -> show(out -> os); // value print
+    }
+    out -> put('\n');
+    return true;
+}
+
+void Interpreter::reportError(){
+    // std :: cout << RE.message();
+    if (quiet)
+        return;
+    OutputPort *out = static_cast<OutputPort*>(this -> out.get());
+    ParallelGuard guard(out -> lock);
+    out -> write("RuntimeError", 12);
+    out -> put('\n');
+}
+
+// 输入结束：跑完仍可运行的绿色线程和事件循环里等待的事件
+void Interpreter::settle(){
+    if (events)
+        events -> run();
+    else if (green)
+        green -> drain();
+}
+
+bool Interpreter::evalForms(std::istream &is, bool prompt, bool quiet){
+    // read - evaluation - print loop
+    OutputPort *out = static_cast<OutputPort*>(this -> out.get()); // 所有输出都经过这个缓冲端口
+    this -> quiet = quiet;
+    while (1){
+        if (prompt){
+            out -> write("scm> ", 5);
+            out -> flush(); // 读下一个表达式之前交出已有输出
+        }
+        if (readSpace(is).peek() == EOF)
+            break;
+        Syntax stx(nullptr);
+        try{
+            stx = readSyntax(is); // read
+        }
+        catch (const RuntimeError &RE){ // 没有结束的表达式或多余的右括号
+            reportError();
+            if (prompt)
+                continue; // 交互时接着读后面的输入
+            break; // 批处理就停在这里，不去猜后面的表达式从哪开始
+        }
+        try{
+            Expr expr = stx -> parse(global_env); // parse
+            fusePipelines(expr); // optimize
+            // stx -> show(std :: cout); // syntax print
+            if (!runForm(expr, global_env, out, quiet))
+                return false;
+        }
+        catch (const RuntimeError &RE){
+            reportError();
+        }
+    }
+    try{
+        settle();
+    }
+    catch (const RuntimeError &RE){ // 例如事件循环等待失败
+        reportError();
+    }
+    return true;
+}
+
+// 不打印提示符的 evalForms，读取与解析在另一个线程上提前进行（见 pipeline.hpp）
+bool Interpreter::evalPipelined(const char *data, size_t size, bool quiet){
+    OutputPort *out = static_cast<OutputPort*>(this -> out.get());
+    FormPipeline forms(data, size, global_env, read_threads);
+    this -> quiet = quiet;
+    while (1){
+        try{
+            Expr expr = forms.next(global_env);
+            if (expr.get() == nullptr)
+                break;
+            if (!runForm(expr, global_env, out, quiet))
+                return false;
+        }
+        catch (const RuntimeError &RE){
+            reportError();
+        }
+    }
+    try{
+        settle();
+    }
+    catch (const RuntimeError &RE){
+        reportError();
+    }
+    return true;
+}
+
+// 小于这个大小的输入，开线程的开销比省下的解析时间还多
+static const size_t PIPELINE_MIN_SIZE = 1 << 12;
+
+bool Interpreter::evalBuffer(const char *data, size_t size, bool quiet){
+    if (parse_ahead && size >= PIPELINE_MIN_SIZE)
+        return evalPipelined(data, size, quiet);
+    MemoryStreamBuf buf(data, size);
+    std::istream is(&buf);
+    return evalForms(is, false, quiet);
+}
+
+// 非终端的标准输入整个读进内存，再交给 evalBuffer
+bool Interpreter::evalStdin(bool quiet){
+    if (isatty(0))
+        return evalForms(std::cin, !quiet, quiet);
+    std::string text;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(0, chunk, sizeof(chunk))) != 0){
+        if (n < 0){
+            if (errno == EINTR) continue;
+            break;
+        }
+        text.append(chunk, static_cast<size_t>(n));
+    }
+    return evalBuffer(text.data(), text.size(), quiet);
+}
+
+// 依次求值全部表达式，不打印；返回最后一个值
+Value Interpreter::evalAll(const char *data, size_t size){
+    InterpreterScope scope(*this);
+    MemoryStreamBuf buf(data, size);
+    std::istream is(&buf);
+    Value result = VoidV();
+    while (readSpace(is).peek() != EOF){
+        Syntax stx = readSyntax(is);
+        Expr expr = stx -> parse(global_env);
+        fusePipelines(expr);
+        result = expr -> eval(global_env);
+        if (result -> v_type == V_TERMINATE)
+            return result;
+    }
+    settle();
+    return result;
+}
+
+Value Interpreter::eval(const std::string &code){
+    return evalAll(code.data(), code.size());
+}
+
+Value Interpreter::load(const std::string &path){
+    Value file = OpenInputFileV(path);
+    InputPort *port = static_cast<InputPort*>(file.get());
+    return evalAll(port -> data, port -> size);
+}
+
+Value Interpreter::lookup(const std::string &name){
+    InterpreterScope scope(*this);
+    return Var(name).eval(global_env);
+}
+
+Value Interpreter::call(const Value &proc, const std::vector<Value> &args){
+    InterpreterScope scope(*this);
+    Value result = applyProcedure(proc, args);
+    throwIfEscape(result); // 逃逸要越过调用它的 C++ 代码
+    return result;
+}
+
+Value Interpreter::call(const std::string &name, const std::vector<Value> &args){
+    Value proc = lookup(name);
+    return call(proc, args);
+}
+
+void Interpreter::define(const std::string &name, const Value &value){
+    global_env = extend(name, value, global_env);
+}
+
+void Interpreter::defineNative(const std::string &name, int min_args, int max_args, NativeFunction fn){
+    Expr body(new NativeCall(name, min_args, max_args, fn));
+    Value proc = ProcedureV(std::vector<std::string>(), body, empty());
+    static_cast<Procedure*>(proc.get()) -> is_primitive = true; // 与原语一样直接调用 evalRator
+    define(name, proc);
+}
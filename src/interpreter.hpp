@@ -0,0 +1,191 @@
+#ifndef INTERPRETER
+#define INTERPRETER
+
+/**
+ * @file interpreter.hpp
+ * @brief Interpreter instances
+ *
+ * All state that evaluation changes lives in an Interpreter: the global
+ * environment, the symbol table, the output ports, (command-line) and a few
+ * caches. Each thread has a current interpreter, set with InterpreterScope;
+ * SymbolV(), stdoutPort(), currentOutputPort() and friends act on it. Any
+ * number of instances can run at once on different threads, as long as no
+ * value is passed from one instance to another.
+ *
+ * The primitives and reserved_words tables and the procedure bodies of the
+ * primitives are never modified after start-up and are shared by all
+ * instances.
+ *
+ * Embedding (the scheme library): eval() and load() run code, lookup() and
+ * call() reach Scheme procedures from C++, and defineNative() makes a C++
+ * function callable from Scheme. These set the instance current themselves.
+ * Errors are reported by throwing RuntimeError, as everywhere else.
+ * examples/embed.cpp is a complete program.
+ *
+ * Futures (parallel.hpp) evaluate on pool threads with their spawner's
+ * instance current; the destructor waits for them to finish. Green threads
+ * (green.hpp) still runnable and events (events.hpp) still pending when
+ * evalForms() or eval() reaches the end of its input are run before it
+ * returns.
+ */
+
+#include "Def.hpp"
+#include "value.hpp"
+#include "expr.hpp"
+#include <atomic>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class GreenScheduler;
+class EventLoop;
+
+class Interpreter {
+public:
+    /**
+     * @brief Creates an instance that writes to fd, or to a string port
+     *        (read back with output()) if fd is -1
+     */
+    explicit Interpreter(int fd = 1);
+    ~Interpreter();
+    Interpreter(const Interpreter &) = delete;
+    Interpreter &operator=(const Interpreter &) = delete;
+
+    /**
+     * @brief Reads, evaluates and (unless quiet) prints every form of is
+     *
+     * With prompt set, "scm> " is printed and output is flushed before each
+     * read, as an interactive session needs; otherwise output stays in the
+     * port buffer until it fills up or the instance is destroyed.
+     * A form that does not read (unterminated, or a stray ')') is reported
+     * like any error; without prompt it also ends the input there.
+     * Returns false if the forms called (exit).
+     */
+    bool evalForms(std::istream &, bool prompt, bool quiet);
+
+    /**
+     * @brief evalForms over a byte range (a file image, -e text, piped stdin)
+     *
+     * With parse_ahead set, inputs of 4 KiB or more are read and parsed on a
+     * background thread (see pipeline.hpp).
+     */
+    bool evalBuffer(const char *, size_t, bool quiet);
+
+    /**
+     * @brief Interactive REPL if stdin is a terminal, else evalBuffer over
+     *        all of stdin
+     */
+    bool evalStdin(bool quiet);
+
+    /**
+     * @brief Reports an error no caller will see (a failed top-level form,
+     *        event callback or green thread) by printing "RuntimeError",
+     *        unless the running evalForms is quiet
+     */
+    void reportError();
+
+    /**
+     * @brief Evaluates every form of code without printing anything;
+     *        returns the value of the last one (stops early at (exit))
+     *
+     * Errors, including forms that do not read, are thrown as RuntimeError.
+     */
+    Value eval(const std::string &code);
+
+    /**
+     * @brief eval() over the contents of the file at path
+     */
+    Value load(const std::string &path);
+
+    /**
+     * @brief Value of a global variable or primitive; throws if unbound
+     */
+    Value lookup(const std::string &name);
+
+    /**
+     * @brief Calls a procedure value with already evaluated arguments
+     */
+    Value call(const Value &proc, const std::vector<Value> &args);
+
+    /**
+     * @brief Calls the procedure bound to name
+     */
+    Value call(const std::string &name, const std::vector<Value> &args);
+
+    /**
+     * @brief Binds name in the global environment, like a top-level define
+     */
+    void define(const std::string &name, const Value &value);
+
+    /**
+     * @brief Binds name to a procedure that calls fn with between min_args and
+     *        max_args arguments (max_args -1: no upper limit)
+     *
+     * Like a primitive, the procedure is called without building an
+     * environment, and fn sees the caller's argument vector directly. A null
+     * result is returned to Scheme as void.
+     */
+    void defineNative(const std::string &name, int min_args, int max_args, NativeFunction fn);
+
+    /**
+     * @brief Everything written so far by an instance created with fd -1
+     */
+    const std::string &output();
+
+    /**
+     * @brief The current interpreter of the calling thread
+     *
+     * A thread that never entered an InterpreterScope gets a process-wide
+     * default instance writing to standard output.
+     */
+    static Interpreter &current();
+
+    Assoc global_env;
+    Value out;                  ///< Port of this instance's standard output
+    Value current_out;          ///< Value of (current-output-port)
+    Value command_line;         ///< Value of (command-line)
+    std::unordered_map<std::string, Value> symbols;     ///< Interned symbols
+    std::map<ExprType, Value> primitive_procs;          ///< Primitives used as values
+    std::atomic<bool> structure_mutated;    ///< See noteStructureMutation()
+    std::atomic<long> running_futures;      ///< Futures not yet finished
+    std::mutex tables_lock;     ///< Guards symbols and primitive_procs while futures run
+    GreenScheduler *green;      ///< Green threads (green.hpp), nullptr until the first spawn
+    EventLoop *events;          ///< Event loop (events.hpp), nullptr until first used
+
+    /**
+     * @brief Lets evalBuffer parse ahead on a second thread; off by default
+     *
+     * Once a process has started any thread, libstdc++ makes every
+     * shared_ptr reference count update atomic for the rest of its life,
+     * and that alone makes evaluation 1.6-1.9x slower. Parsing ahead only
+     * pays when parsing is a large share of the run.
+     */
+    bool parse_ahead;
+
+    /**
+     * @brief With parse_ahead, the number of threads that read inputs of
+     *        1 MiB or more in parallel (loader.hpp); 0 (the default) reads
+     *        on the parse-ahead thread alone
+     */
+    unsigned read_threads;
+
+private:
+    bool quiet;                 ///< quiet argument of the running evalForms or evalPipelined
+
+    void settle();
+    bool evalPipelined(const char *, size_t, bool quiet);
+    Value evalAll(const char *, size_t);
+};
+
+/**
+ * @brief Makes an interpreter current on this thread until the end of scope
+ */
+struct InterpreterScope {
+    explicit InterpreterScope(Interpreter &);
+    ~InterpreterScope();
+    Interpreter *saved;
+};
+
+#endif // INTERPRETER
@@ -0,0 +1,215 @@
+/**
+ * @file loader.cpp
+ * @brief Top-level form splitting and the parallel reader (see loader.hpp)
+ */
+
+#include "loader.hpp"
+#include "strsearch.hpp"
+#include "RE.hpp"
+#include "value.hpp"
+#include <atomic>
+#include <cctype>
+#include <istream>
+#include <string>
+
+// 扫描器的词法状态
+enum ScanState { SCAN_CODE, SCAN_STRING, SCAN_ESCAPE, SCAN_COMMENT };
+
+/**
+ * @brief Result of scanning one chunk from an assumed starting state
+ *
+ * Depths are relative to the chunk start. closes holds every position right
+ * after a ')' or ']' where the depth reached a new (or equal) minimum:
+ * whichever of them has depth equal to minus the real starting depth closes
+ * a top-level form.
+ */
+struct ChunkScan {
+    size_t begin = 0, end = 0;
+    ScanState start = SCAN_CODE, state = SCAN_CODE;
+    long depth = 0;
+    long min_depth = 0;
+    std::vector<std::pair<size_t, long>> closes;
+};
+
+// 与 readItem 的记号分隔符一致
+static bool isDelimiter(char c) {
+    return c == '(' || c == ')' || c == '[' || c == ']' || c == ';' || isspace((unsigned char)c);
+}
+
+static void scanChunk(const char *p, ChunkScan &scan, ScanState state) {
+    scan.start = state;
+    scan.depth = 0;
+    scan.min_depth = 0;
+    scan.closes.clear();
+    // 只有位于记号开头的 " 才开始字符串（readItem 把 ab"c 当作一个记号）
+    bool at_start = true;
+    for (size_t i = scan.begin; i < scan.end; i++) {
+        char c = p[i];
+        switch (state) {
+        case SCAN_CODE:
+            if (c == '(' || c == '[') {
+                scan.depth++;
+            } else if (c == ')' || c == ']') {
+                if (--scan.depth <= scan.min_depth) {
+                    scan.min_depth = scan.depth;
+                    scan.closes.push_back(std::make_pair(i + 1, scan.depth));
+                }
+            } else if (c == ';') {
+                state = SCAN_COMMENT;
+            } else if (c == '"' && at_start) {
+                state = SCAN_STRING;
+            }
+            at_start = isDelimiter(c) || (c == '\'' && at_start);
+            break;
+        case SCAN_STRING:
+            if (c == '\\') state = SCAN_ESCAPE;
+            else if (c == '"') state = SCAN_CODE, at_start = true;
+            break;
+        case SCAN_ESCAPE:
+            state = SCAN_STRING;
+            break;
+        case SCAN_COMMENT:
+            if (c == '\n') state = SCAN_CODE, at_start = true;
+            break;
+        }
+    }
+    scan.state = state;
+}
+
+std::vector<size_t> splitTopLevel(const char *p, size_t n, unsigned threads, size_t min_piece) {
+    const size_t MIN_CHUNK = 1 << 16;
+    if (threads == 0) threads = 1;
+    size_t count = std::max<size_t>(1, std::min<size_t>(threads * 4, n / MIN_CHUNK));
+    // 块边界放在换行之后：那里不可能处于注释中，几乎总是处于代码中
+    std::vector<ChunkScan> chunks;
+    size_t begin = 0;
+    for (size_t k = 1; k <= count && begin < n; k++) {
+        size_t end = n;
+        if (k < count) {
+            size_t at = std::max(begin, n / count * k);
+            size_t nl = findByte(p + at, n - at, '\n');
+            end = nl == std::string::npos ? n : at + nl + 1;
+        }
+        ChunkScan scan{};
+        scan.begin = begin;
+        scan.end = end;
+        chunks.push_back(scan);
+        begin = end;
+    }
+
+    // 每块都先假设从代码状态开始，并行扫描
+    std::atomic<size_t> next_chunk(0);
+    auto scanAll = [&]() {
+        size_t k;
+        while ((k = next_chunk.fetch_add(1)) < chunks.size())
+            scanChunk(p, chunks[k], SCAN_CODE);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads && t < chunks.size(); t++)
+        pool.push_back(std::thread(scanAll));
+    scanAll();
+    for (auto &t : pool) t.join();
+
+    // 顺序拼接：假设错了（块从字符串中间开始）的块按真实状态重扫
+    std::vector<size_t> cuts;
+    ScanState state = SCAN_CODE;
+    long depth = 0;
+    size_t last = 0;
+    for (auto &scan : chunks) {
+        if (scan.start != state) scanChunk(p, scan, state);
+        if (depth + scan.min_depth < 0) return std::vector<size_t>();
+        for (auto &c : scan.closes) {
+            if (c.second == -depth && c.first < n && c.first - last >= min_piece) {
+                cuts.push_back(c.first);
+                last = c.first;
+            }
+        }
+        depth += scan.depth;
+        state = scan.state;
+        scan.closes = std::vector<std::pair<size_t, long>>();
+    }
+    if (depth != 0 || state == SCAN_STRING || state == SCAN_ESCAPE)
+        return std::vector<size_t>();
+    return cuts;
+}
+
+ParallelReader::ParallelReader(const char *data, size_t size, unsigned threads)
+    : data(data), taken(0), current(0), pos(0), stop(false) {
+    if (threads == 0) threads = 1;
+    std::vector<size_t> cuts = splitTopLevel(data, size, threads, 1 << 18);
+    cuts.push_back(size);
+    size_t begin = 0;
+    for (size_t cut : cuts) {
+        Piece piece;
+        piece.begin = begin;
+        piece.end = cut;
+        piece.ready = false;
+        piece.failed = false;
+        pieces.push_back(piece);
+        begin = cut;
+    }
+    window = threads * 4;
+    for (unsigned t = 0; t < threads && t < pieces.size(); t++)
+        workers.push_back(std::thread(&ParallelReader::work, this));
+}
+
+ParallelReader::~ParallelReader() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+    }
+    space_cv.notify_all();
+    for (auto &t : workers) t.join();
+}
+
+void ParallelReader::work() {
+    initStackLimit();
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        space_cv.wait(guard, [this] {
+            return stop || taken >= pieces.size() || taken < current + window;
+        });
+        if (stop || taken >= pieces.size()) return;
+        Piece &piece = pieces[taken++];
+        guard.unlock();
+        std::vector<Syntax> forms;
+        bool failed = false;
+        MemoryStreamBuf buf(data + piece.begin, piece.end - piece.begin);
+        std::istream is(&buf);
+        try {
+            while (readSpace(is).peek() != EOF)
+                forms.push_back(readSyntax(is));
+        } catch (const RuntimeError &) {
+            failed = true; // 读到这里为止的表达式照常交出，之后由 next 报错
+        }
+        guard.lock();
+        piece.forms.swap(forms);
+        piece.failed = failed;
+        piece.ready = true;
+        ready_cv.notify_all();
+    }
+}
+
+bool ParallelReader::next(Syntax &stx) {
+    while (current < pieces.size()) {
+        Piece &piece = pieces[current];
+        if (pos == 0) {
+            std::unique_lock<std::mutex> guard(lock);
+            ready_cv.wait(guard, [&piece] { return piece.ready; });
+        }
+        if (pos < piece.forms.size()) {
+            stx = std::move(piece.forms[pos++]);
+            return true;
+        }
+        if (piece.failed)
+            throw RuntimeError("Malformed form");
+        piece.forms = std::vector<Syntax>(); // 读完的块立即释放
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            current++;
+            pos = 0;
+        }
+        space_cv.notify_all();
+    }
+    return false;
+}
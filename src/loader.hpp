@@ -0,0 +1,72 @@
+#ifndef LOADER
+#define LOADER
+
+/**
+ * @file loader.hpp
+ * @brief Parallel reading of large source files
+ *
+ * splitTopLevel() cuts a file image at top-level form boundaries: chunks of
+ * the image are scanned concurrently for bracket depth (skipping strings and
+ * comments), then a short sequential pass joins the per-chunk results.
+ * ParallelReader runs readSyntax over the resulting pieces on a small pool
+ * of threads and returns the forms in source order.
+ */
+
+#include "syntax.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Offsets in (0, n) at which p can be cut so that every piece holds
+ *        whole top-level forms; consecutive cuts are at least min_piece apart
+ *
+ * Only positions right after a ')' or ']' that closes a top-level list are
+ * used. Returns no cuts if the text is not balanced (e.g. unterminated
+ * string or list, stray ')' or ']'), leaving such input to one reader.
+ */
+std::vector<size_t> splitTopLevel(const char *p, size_t n, unsigned threads, size_t min_piece);
+
+/**
+ * @brief Reads the top-level forms of a byte range on a pool of threads
+ *
+ * The range must stay valid until the reader is destroyed. Workers read at
+ * most a bounded number of pieces ahead of the consumer.
+ */
+class ParallelReader {
+public:
+    ParallelReader(const char *, size_t, unsigned threads);
+    ~ParallelReader();
+
+    /**
+     * @brief Stores the next form in stx; returns false at end of input
+     *
+     * Throws RuntimeError where a piece holds a form that does not read.
+     */
+    bool next(Syntax &stx);
+
+private:
+    struct Piece {
+        size_t begin, end;
+        std::vector<Syntax> forms;
+        bool ready;
+        bool failed;    ///< Reading stopped at a form that does not read
+    };
+
+    void work();
+
+    const char *data;
+    std::vector<Piece> pieces;
+    size_t window;      ///< pieces a worker may read ahead of the consumer
+    size_t taken;       ///< next piece for a worker
+    size_t current;     ///< piece the consumer is in
+    size_t pos;         ///< next form of the current piece
+    bool stop;
+    std::mutex lock;
+    std::condition_variable ready_cv;   ///< a piece has been read
+    std::condition_variable space_cv;   ///< the consumer moved on
+    std::vector<std::thread> workers;
+};
+
+#endif // LOADER
@@ -1,80 +1,164 @@
 #include "Def.hpp"
-#include "syntax.hpp"
-#include "expr.hpp"
 #include "value.hpp"
 #include "RE.hpp"
-#include <sstream>
+#include "interpreter.hpp"
+#include "server.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <map>
 
-extern std::map<std::string, ExprType> primitives;
-extern std::map<std::string, ExprType> reserved_words;
+void usage(const char *prog){
+    std::cerr << "usage: " << prog << " [--quiet] [--threads N] [--profile FILE] [--stats] [--parse-ahead] [--read-threads N] [-e EXPR]... [--serve SOCKET [--fork] [--timeout SECONDS]] [script.scm [args...]]\n"
+              << "  -e EXPR    evaluate EXPR (may be repeated; runs before the script)\n"
+              << "  -q, --quiet  do not print prompts or the values of top-level forms\n"
+              << "  --threads N  run futures, pmap and pfor-each on N threads\n"
+              << "             (default: the number of hardware threads)\n"
+              << "  --profile FILE  sample the run, write collapsed stacks (for flame\n"
+              << "             graph tools) to FILE and a table of the top procedures\n"
+              << "             to stderr\n"
+              << "  --stats    at exit, report times, memory and allocations by type\n"
+              << "             on stderr\n"
+              << "  --parse-ahead  read and parse inputs of 4 KiB or more on a second\n"
+              << "             thread while evaluating (slows evaluation down once a\n"
+              << "             thread exists; only pays off for parse-heavy input)\n"
+              << "  --read-threads N  with --parse-ahead, read inputs of 1 MiB or more\n"
+              << "             on N more threads\n"
+              << "  --serve SOCKET  after -e and the script (the prelude), answer requests\n"
+              << "             on a Unix domain socket (see scheme-client)\n"
+              << "  --fork     with --serve: answer each request in a forked copy of the\n"
+              << "             server, and report per-job time and memory on stderr\n"
+              << "  --timeout SECONDS  with --serve: time limit of one request\n"
+              << "             (default 10, 0 for none)\n"
+              << "With no script and no -e, forms are read from standard input;\n"
+              << "the scm> prompt is shown only when standard input is a terminal.\n";
+}
 
-bool isExplicitVoidCall(Expr expr) {
-    MakeVoid* make_void_expr = dynamic_cast<MakeVoid*>(expr.get());
-    if (make_void_expr != nullptr) {
-        return true;
-    }
-    
-    Apply* apply_expr = dynamic_cast<Apply*>(expr.get());
-    if (apply_expr != nullptr) {
-        Var* var_expr = dynamic_cast<Var*>(apply_expr->rator.get());
-        if (var_expr != nullptr && var_expr->x == "void") {
-            return true;
-        }
-    }
-    
-    Begin* begin_expr = dynamic_cast<Begin*>(expr.get());
-    if (begin_expr != nullptr && !begin_expr->es.empty()) {
-        return isExplicitVoidCall(begin_expr->es.back());
-    }
-    
-    If* if_expr = dynamic_cast<If*>(expr.get());
-    if (if_expr != nullptr) {
-        return isExplicitVoidCall(if_expr->conseq) || isExplicitVoidCall(if_expr->alter);
-    }
-    
-    Cond* cond_expr = dynamic_cast<Cond*>(expr.get());
-    if (cond_expr != nullptr) {
-        for (const auto& clause : cond_expr->clauses) {
-            if (clause.size() > 1 && isExplicitVoidCall(clause.back())) {
-                return true;
+int main(int argc, char *argv[]) {
+    std::ios::sync_with_stdio(false); // 输出不再经过 stdio
+    bool quiet = false;
+    std::vector<std::string> exprs;
+    std::string socket_path;
+    bool fork_jobs = false;
+    double timeout = SERVE_TIMEOUT;
+    std::string profile_path;
+    bool stats = false;
+    bool parse_ahead = false;
+    unsigned read_threads = 0;
+    auto start = std::chrono::steady_clock::now();
+    int i = 1;
+    for (; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg == "-q" || arg == "--quiet"){
+            quiet = true;
+        } else if (arg == "-e"){
+            if (i + 1 >= argc){
+                usage(argv[0]);
+                return 2;
             }
+            exprs.push_back(argv[++i]);
+        } else if (arg == "--threads"){
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) < 1){
+                usage(argv[0]);
+                return 2;
+            }
+            setParallelThreads(static_cast<unsigned>(std::atoi(argv[++i])));
+        } else if (arg == "--profile"){
+            if (i + 1 >= argc){
+                usage(argv[0]);
+                return 2;
+            }
+            profile_path = argv[++i];
+        } else if (arg == "--stats"){
+            stats = true;
+        } else if (arg == "--parse-ahead"){
+            parse_ahead = true;
+        } else if (arg == "--read-threads"){
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) < 1){
+                usage(argv[0]);
+                return 2;
+            }
+            read_threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--serve"){
+            if (i + 1 >= argc){
+                usage(argv[0]);
+                return 2;
+            }
+            socket_path = argv[++i];
+        } else if (arg == "--fork"){
+            fork_jobs = true;
+        } else if (arg == "--timeout"){
+            if (i + 1 >= argc || std::atof(argv[i + 1]) < 0){
+                usage(argv[0]);
+                return 2;
+            }
+            timeout = std::atof(argv[++i]);
+        } else if (arg == "-h" || arg == "--help"){
+            usage(argv[0]);
+            return 0;
+        } else if (arg == "--"){
+            i++;
+            break;
+        } else if (arg.size() > 1 && arg[0] == '-'){
+            usage(argv[0]);
+            return 2;
+        } else {
+            break;
         }
     }
-    return false;
-}
 
-void REPL(){
-    // read - evaluation - print loop
-    Assoc global_env = empty();
-    while (1){
-        #ifndef ONLINE_JUDGE
-            std::cout << "scm> ";
-        #endif
-        Syntax stx = readSyntax(std :: cin); // read
+    Value args = NullV(); // (command-line)：脚本路径及其参数
+    for (int j = argc - 1; j >= i; j--)
+        args = PairV(StringV(argv[j]), args);
+
+    Interpreter interp;
+    InterpreterScope scope(interp);
+    interp.command_line = args;
+    interp.parse_ahead = parse_ahead;
+    interp.read_threads = read_threads;
+    if (!profile_path.empty()){
         try{
-            Expr expr = stx -> parse(global_env); // parse
-            // stx -> show(std :: cout); // syntax print
-            Value val = expr -> eval(global_env);
-            if (val -> v_type == V_TERMINATE)
-                break;
-            if(val->v_type!=V_VOID||isExplicitVoidCall(expr)){
-                val -> show(std :: cout); // value print
-            }
-                
+            profileStart();
         }
         catch (const RuntimeError &RE){
-            // std :: cout << RE.message();
-            std :: cout << "RuntimeError";
+            std::cerr << argv[0] << ": " << RE.message() << "\n";
+            return 1;
         }
-        puts("");
-        
     }
-}
-
-
-int main(int argc, char *argv[]) {
-    REPL();
+    bool going = true;
+    for (size_t j = 0; going && j < exprs.size(); j++)
+        going = interp.evalBuffer(exprs[j].data(), exprs[j].size(), quiet);
+    if (going && i < argc){
+        Value script(nullptr);
+        try{
+            script = OpenInputFileV(argv[i]);
+        }
+        catch (const RuntimeError &RE){
+            std::cerr << argv[0] << ": cannot read " << argv[i] << "\n";
+            return 1;
+        }
+        InputPort *port = static_cast<InputPort*>(script.get());
+        going = interp.evalBuffer(port->data, port->size, quiet);
+    } else if (going && exprs.empty() && socket_path.empty()){
+        interp.evalStdin(quiet);
+    }
+    if (!profile_path.empty()){ // 只分析脚本（及前奏），不含之后的服务
+        profileStop();
+        std::ofstream file(profile_path);
+        if (!file)
+            std::cerr << argv[0] << ": cannot write " << profile_path << "\n";
+        writeCollapsedStacks(file);
+        static_cast<OutputPort*>(interp.out.get()) -> flush();
+        writeProfileTable(std::cerr);
+    }
+    if (stats){
+        static_cast<OutputPort*>(interp.out.get()) -> flush();
+        writeRuntimeStats(std::cerr, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    if (going && !socket_path.empty())
+        return serveUnixSocket(interp, socket_path, fork_jobs, fork_jobs && !quiet, timeout);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,235 @@
+/**
+ * @file optimize.cpp
+ * @brief List pipeline fusion and the purity test it relies on
+ */
+
+#include "optimize.hpp"
+#include "Def.hpp"
+
+// ============================================================================
+// Purity
+// ============================================================================
+
+// 无副作用且不会调用任意过程的原语
+static bool isPurePrimitive(ExprType t) {
+    switch (t) {
+        case E_PLUS: case E_MINUS: case E_MUL: case E_DIV: case E_MODULO: case E_EXPT:
+        case E_LT: case E_LE: case E_EQ: case E_GE: case E_GT:
+        case E_CONS: case E_CAR: case E_CDR: case E_LIST:
+        case E_LENGTH: case E_APPEND: case E_REVERSE: case E_LIST_TAIL: case E_LIST_REF:
+        case E_MEMQ: case E_ASSQ: case E_ASSOC:
+        case E_NOT: case E_EQQ:
+        case E_BOOLQ: case E_INTQ: case E_NULLQ: case E_PAIRQ: case E_PROCQ:
+        case E_SYMBOLQ: case E_LISTQ: case E_STRINGQ:
+        case E_VOID:
+        case E_HASHMAP: case E_HASHMAPQ: case E_HASHMAP_REF: case E_HASHMAP_SET:
+        case E_HASHMAP_REMOVE: case E_HASHMAP_CONTAINSQ: case E_HASHMAP_COUNT:
+        case E_HASHMAP_TO_LIST:
+        case E_PVECTOR: case E_PVECTORQ: case E_PVECTOR_REF: case E_PVECTOR_SET:
+        case E_PVECTOR_PUSH: case E_PVECTOR_LENGTH: case E_PVECTOR_TO_LIST:
+        case E_LIST_TO_PVECTOR:
+        case E_STRING_LENGTH: case E_STRING_REF: case E_SUBSTRING: case E_STRING_APPEND:
+        case E_STRING_EQ: case E_STRING_LT: case E_STRING_TO_SYMBOL: case E_SYMBOL_TO_STRING:
+        case E_NUMBER_TO_STRING: case E_STRING_TO_NUMBER:
+        case E_STRING_SEARCH_FORWARD: case E_STRING_INDEX: case E_STRING_CONTAINS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool isPureExpr(const Expr &expr) {
+    ExprBase *e = expr.get();
+    switch (e->e_type) {
+        case E_FIXNUM: case E_RATIONAL: case E_STRING: case E_TRUE: case E_FALSE:
+        case E_VAR: case E_QUOTE: case E_LAMBDA:
+            return true;
+        case E_AND:
+            for (auto &r : static_cast<AndVar*>(e)->rands) {
+                if (!isPureExpr(r)) return false;
+            }
+            return true;
+        case E_OR:
+            for (auto &r : static_cast<OrVar*>(e)->rands) {
+                if (!isPureExpr(r)) return false;
+            }
+            return true;
+        case E_BEGIN:
+            for (auto &r : static_cast<Begin*>(e)->es) {
+                if (!isPureExpr(r)) return false;
+            }
+            return true;
+        case E_IF: {
+            If *i = static_cast<If*>(e);
+            return isPureExpr(i->cond) && isPureExpr(i->conseq) && isPureExpr(i->alter);
+        }
+        case E_COND:
+            for (auto &clause : static_cast<Cond*>(e)->clauses) {
+                for (auto &r : clause) {
+                    if (!isPureExpr(r)) return false;
+                }
+            }
+            return true;
+        case E_DEFINE: // 只扩展当前调用的环境
+            return isPureExpr(static_cast<Define*>(e)->e);
+        case E_LET: {
+            Let *l = static_cast<Let*>(e);
+            for (auto &b : l->bind) {
+                if (!isPureExpr(b.second)) return false;
+            }
+            return isPureExpr(l->body);
+        }
+        case E_LETREC: {
+            Letrec *l = static_cast<Letrec*>(e);
+            for (auto &b : l->bind) {
+                if (!isPureExpr(b.second)) return false;
+            }
+            return isPureExpr(l->body);
+        }
+        default:
+            break;
+    }
+    if (!isPurePrimitive(e->e_type)) {
+        return false; // set!、输出、exit、apply 以及调用未知过程
+    }
+    if (auto u = dynamic_cast<Unary*>(e)) {
+        return isPureExpr(u->rand);
+    }
+    if (auto b = dynamic_cast<Binary*>(e)) {
+        return isPureExpr(b->rand1) && isPureExpr(b->rand2);
+    }
+    if (auto v = dynamic_cast<Variadic*>(e)) {
+        for (auto &r : v->rands) {
+            if (!isPureExpr(r)) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool isPureProcedure(const Value &v) {
+    if (v->v_type != V_PROC) {
+        return false;
+    }
+    Procedure *proc = static_cast<Procedure*>(v.get());
+    if (proc->is_primitive) {
+        return isPurePrimitive(proc->e->e_type);
+    }
+    return isPureExpr(proc->e);
+}
+
+// ============================================================================
+// Fusion
+// ============================================================================
+
+// 单表 map 或 filter：取出阶段过程与其表参数
+static bool asStage(const Expr &expr, std::pair<ExprType, Expr> &stage, Expr &list) {
+    ExprBase *e = expr.get();
+    if (e->e_type != E_MAP && e->e_type != E_FILTER) {
+        return false;
+    }
+    Variadic *v = static_cast<Variadic*>(e);
+    if (v->rands.size() != 2) {
+        return false;
+    }
+    stage = std::make_pair(e->e_type, v->rands[0]);
+    list = v->rands[1];
+    return true;
+}
+
+// 以 expr 为最外层消费者尝试构造 ListPipeline；至少要吃掉一个中间表
+static bool buildPipeline(Expr &expr) {
+    ExprBase *e = expr.get();
+    ExprType sink;
+    Expr proc(nullptr), init(nullptr), list(nullptr);
+    std::vector<std::pair<ExprType, Expr>> stages; // 先收集成由外到内
+    std::pair<ExprType, Expr> stage(E_MAP, Expr(nullptr));
+    if (asStage(expr, stage, list)) {
+        sink = E_LIST;
+        stages.push_back(stage);
+    } else if (e->e_type == E_FOLD_LEFT || e->e_type == E_FOLD_RIGHT) {
+        Variadic *v = static_cast<Variadic*>(e);
+        if (v->rands.size() != 3) {
+            return false;
+        }
+        sink = e->e_type;
+        proc = v->rands[0];
+        init = v->rands[1];
+        list = v->rands[2];
+    } else if (e->e_type == E_FOR_EACH) {
+        Variadic *v = static_cast<Variadic*>(e);
+        if (v->rands.size() != 2) {
+            return false;
+        }
+        sink = E_FOR_EACH;
+        proc = v->rands[0];
+        list = v->rands[1];
+    } else if (e->e_type == E_LENGTH) {
+        sink = E_LENGTH;
+        list = static_cast<Unary*>(e)->rand;
+    } else {
+        return false;
+    }
+    size_t consumed = stages.size();
+    Expr inner(nullptr);
+    while (asStage(list, stage, inner)) {
+        stages.push_back(stage);
+        list = inner;
+    }
+    if (stages.size() == consumed) {
+        return false;
+    }
+    std::vector<std::pair<ExprType, Expr>> ordered(stages.rbegin(), stages.rend());
+    for (auto &s : ordered) {
+        fusePipelines(s.second);
+    }
+    if (proc.get() != nullptr) fusePipelines(proc);
+    if (init.get() != nullptr) fusePipelines(init);
+    fusePipelines(list);
+    expr = Expr(new ListPipeline(ordered, sink, proc, init, list));
+    return true;
+}
+
+void fusePipelines(Expr &expr) {
+    ExprBase *e = expr.get();
+    if (e == nullptr || buildPipeline(expr)) {
+        return;
+    }
+    if (auto u = dynamic_cast<Unary*>(e)) {
+        fusePipelines(u->rand);
+    } else if (auto b = dynamic_cast<Binary*>(e)) {
+        fusePipelines(b->rand1);
+        fusePipelines(b->rand2);
+    } else if (auto v = dynamic_cast<Variadic*>(e)) {
+        for (auto &r : v->rands) fusePipelines(r);
+    } else if (auto a = dynamic_cast<AndVar*>(e)) {
+        for (auto &r : a->rands) fusePipelines(r);
+    } else if (auto o = dynamic_cast<OrVar*>(e)) {
+        for (auto &r : o->rands) fusePipelines(r);
+    } else if (auto bg = dynamic_cast<Begin*>(e)) {
+        for (auto &r : bg->es) fusePipelines(r);
+    } else if (auto i = dynamic_cast<If*>(e)) {
+        fusePipelines(i->cond);
+        fusePipelines(i->conseq);
+        fusePipelines(i->alter);
+    } else if (auto c = dynamic_cast<Cond*>(e)) {
+        for (auto &clause : c->clauses) {
+            for (auto &r : clause) fusePipelines(r);
+        }
+    } else if (auto ap = dynamic_cast<Apply*>(e)) {
+        fusePipelines(ap->rator);
+        for (auto &r : ap->rand) fusePipelines(r);
+    } else if (auto l = dynamic_cast<Lambda*>(e)) {
+        fusePipelines(l->e);
+    } else if (auto d = dynamic_cast<Define*>(e)) {
+        fusePipelines(d->e);
+    } else if (auto lt = dynamic_cast<Let*>(e)) {
+        for (auto &bnd : lt->bind) fusePipelines(bnd.second);
+        fusePipelines(lt->body);
+    } else if (auto lr = dynamic_cast<Letrec*>(e)) {
+        for (auto &bnd : lr->bind) fusePipelines(bnd.second);
+        fusePipelines(lr->body);
+    } else if (auto s = dynamic_cast<Set*>(e)) {
+        fusePipelines(s->e);
+    }
+}
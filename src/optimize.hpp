@@ -0,0 +1,32 @@
+#ifndef OPTIMIZE
+#define OPTIMIZE
+
+/**
+ * @file optimize.hpp
+ * @brief Rewrites over the parsed Expr tree
+ *
+ * fusePipelines() replaces nested list combinators such as
+ * (fold-left f init (map g (filter p xs))) with a single ListPipeline node.
+ * Only nodes produced by the parser for the built-in map, filter, fold-left,
+ * fold-right, for-each and length are considered, so a user binding that
+ * shadows any of these names is never rewritten.
+ */
+
+#include "expr.hpp"
+#include "value.hpp"
+
+/**
+ * @brief Rewrites fusable list pipelines in place, recursively
+ */
+void fusePipelines(Expr &);
+
+/**
+ * @brief Returns true if calling the procedure can have no side effect
+ *
+ * Conservative: primitives are checked against a whitelist, closures by a
+ * syntactic scan of their body that rejects set!, mutators, output, exit and
+ * any call to a procedure not known at the call site.
+ */
+bool isPureProcedure(const Value &);
+
+#endif // OPTIMIZE
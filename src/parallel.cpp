@@ -0,0 +1,239 @@
+/**
+ * @file parallel.cpp
+ * @brief Work-stealing pool behind future, touch, pmap and pfor-each
+ */
+
+#include "parallel.hpp"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+thread_local unsigned task_owner = 0;
+thread_local Value *task_output = nullptr;
+
+static std::atomic<unsigned> next_owner(1);
+static unsigned pool_threads = 0;
+
+/**
+ * @brief A queued future and the interpreter it belongs to
+ */
+struct PoolTask {
+    Value future;
+    Interpreter *interp;
+    PoolTask() : future(nullptr), interp(nullptr) {}
+    PoolTask(const Value &f, Interpreter *i) : future(f), interp(i) {}
+};
+
+/**
+ * @brief Worker threads with one deque each
+ *
+ * A worker takes its own newest task first and otherwise steals the oldest
+ * task of another worker; threads outside the pool only steal.
+ */
+class TaskPool {
+public:
+    explicit TaskPool(unsigned workers);
+    void submit(const PoolTask &);
+    bool runOne();                      ///< Runs one queued task; false if none
+    std::mutex done_lock;               ///< Waiters sleep here until a task finishes
+    std::condition_variable done;
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<PoolTask> tasks;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<long> queued;
+    std::atomic<unsigned> next_queue;
+    std::mutex idle_lock;
+    std::condition_variable idle;
+    bool take(PoolTask &);
+    void work(unsigned self);
+};
+
+static thread_local int worker_index = -1;
+static thread_local int future_depth = 0;
+static TaskPool &pool();
+
+// 运行一个尚未开始的 future；已被别的线程领走时返回 false
+static bool runFuture(Future *f, Interpreter &interp) {
+    int expected = Future::PENDING;
+    if (!f->state.compare_exchange_strong(expected, Future::RUNNING)) {
+        return false;
+    }
+    InterpreterScope scope(interp);
+    unsigned saved_owner = task_owner;
+    Value *saved_output = task_output;
+    const void *saved_segment = stack_segment;
+    Value output = f->output;
+    task_owner = next_owner.fetch_add(1, std::memory_order_relaxed);
+    task_output = &output;
+    stack_segment = f;
+    future_depth++;
+    try {
+        f->result = f->work();
+    } catch (const RuntimeError &e) {
+        f->failed = true;
+        f->message = e.message();
+    } catch (const std::exception &e) {
+        f->failed = true;
+        f->message = e.what();
+    }
+    future_depth--;
+    f->work = nullptr; // 放开捕获的环境
+    task_owner = saved_owner;
+    task_output = saved_output;
+    stack_segment = saved_segment;
+    // 先减计数再发布 DONE：等到结果的线程随即修改数据时不会被误判
+    interp.running_futures.fetch_sub(1, std::memory_order_release);
+    f->state.store(Future::DONE, std::memory_order_release);
+    TaskPool &p = pool();
+    {
+        std::lock_guard<std::mutex> guard(p.done_lock);
+    }
+    p.done.notify_all();
+    return true;
+}
+
+TaskPool::TaskPool(unsigned workers) : queued(0), next_queue(0) {
+    for (unsigned i = 0; i < workers; i++) {
+        queues.emplace_back(new Queue);
+    }
+    for (unsigned i = 0; i < workers; i++) {
+        std::thread(&TaskPool::work, this, i).detach();
+    }
+}
+
+void TaskPool::submit(const PoolTask &task) {
+    unsigned i = worker_index >= 0 ? static_cast<unsigned>(worker_index)
+                                   : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[i]->lock);
+        queues[i]->tasks.push_back(task);
+    }
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+    }
+    idle.notify_one();
+}
+
+bool TaskPool::take(PoolTask &task) {
+    size_t n = queues.size();
+    size_t start;
+    if (worker_index >= 0) {
+        Queue &own = *queues[worker_index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+        start = worker_index + 1;
+    } else {
+        start = next_queue.load(std::memory_order_relaxed);
+    }
+    for (size_t k = 0; k < n; k++) {
+        Queue &q = *queues[(start + k) % n];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.tasks.empty()) {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskPool::runOne() {
+    PoolTask task;
+    if (!take(task)) {
+        return false;
+    }
+    runFuture(static_cast<Future*>(task.future.get()), *task.interp);
+    return true;
+}
+
+void TaskPool::work(unsigned self) {
+    worker_index = static_cast<int>(self);
+    while (true) {
+        if (runOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_lock);
+        idle.wait(lock, [this] { return queued.load() > 0; });
+    }
+}
+
+// 进程内唯一的线程池，第一次使用时创建，永不销毁（工作线程已分离）
+static TaskPool &pool() {
+    static TaskPool *instance = new TaskPool(parallelThreads() > 1 ? parallelThreads() - 1 : 1);
+    return *instance;
+}
+
+bool inFuture() {
+    return future_depth > 0;
+}
+
+void setParallelThreads(unsigned n) {
+    pool_threads = n;
+}
+
+unsigned parallelThreads() {
+    if (pool_threads == 0) {
+        pool_threads = std::thread::hardware_concurrency();
+        if (pool_threads == 0) {
+            pool_threads = 1;
+        }
+    }
+    return pool_threads;
+}
+
+Value spawnFuture(const std::function<Value()> &work) {
+    Interpreter &interp = Interpreter::current();
+    Value f(new Future(work, currentOutputPort()));
+    interp.running_futures.fetch_add(1, std::memory_order_acq_rel);
+    // 此前分配的一切都可能被新 future 读到，本任务换用新的标记
+    task_owner = next_owner.fetch_add(1, std::memory_order_relaxed);
+    pool().submit(PoolTask(f, &interp));
+    return f;
+}
+
+Value touchFuture(Future *f) {
+    if (f->state.load(std::memory_order_acquire) != Future::DONE
+        && !runFuture(f, Interpreter::current())) {
+        // 正在别的线程上运行：等待期间帮忙做别的任务
+        TaskPool &p = pool();
+        while (f->state.load(std::memory_order_acquire) != Future::DONE) {
+            if (p.runOne()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(p.done_lock);
+            p.done.wait(lock, [f] { return f->state.load(std::memory_order_acquire) == Future::DONE; });
+        }
+    }
+    if (f->failed) {
+        throw RuntimeError(f->message);
+    }
+    return f->result;
+}
+
+void waitForFutures(Interpreter &interp) {
+    if (interp.running_futures.load(std::memory_order_acquire) == 0) {
+        return;
+    }
+    TaskPool &p = pool();
+    while (interp.running_futures.load(std::memory_order_acquire) != 0) {
+        if (p.runOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(p.done_lock);
+        p.done.wait(lock, [&interp] { return interp.running_futures.load(std::memory_order_acquire) == 0; });
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef PARALLEL
+#define PARALLEL
+
+/**
+ * @file parallel.hpp
+ * @brief Futures, pmap and the work-stealing pool that runs them
+ *
+ * (future expr) returns at once; expr is evaluated on a pool thread in the
+ * spawner's environment, and (touch f) waits for its value (touching any
+ * other value returns it unchanged). (pmap f l ...) and (pfor-each f l ...)
+ * are map and for-each with the calls spread over the pool. Errors raised by
+ * the work are raised again by touch, pmap and pfor-each.
+ *
+ * The pool runs one worker less than there are hardware threads (but at
+ * least one): the thread waiting in touch, pmap or pfor-each makes up the
+ * last one by running queued work while it waits. Each worker owns a deque:
+ * it pushes and pops its own work at the back, idle workers steal from the
+ * front of the others.
+ *
+ * Sharing rules. A future may read anything it can reach, since values and
+ * bindings that nobody modifies are safe to share. Mutation is checked:
+ * every value and binding is tagged with the task that allocated it, and
+ * spawning a future gives the spawner a new tag. While futures of the
+ * interpreter are running, set!, set-car!, set-cdr!, sort!, the transient
+ * *! operations and reading an input port only succeed on objects the
+ * current task created since it last spawned; anything else raises
+ * RuntimeError, because another thread may be reading it. Once every future
+ * has finished, all objects are mutable again.
+ *
+ * What the runtime itself shares is made safe: the symbol table and the
+ * primitive procedure cache are locked, strings flatten under a lock,
+ * output ports are locked per display/write call, and each task has its own
+ * (current-output-port), starting as the spawner's.
+ */
+
+#include "value.hpp"
+#include "interpreter.hpp"
+#include "RE.hpp"
+#include <atomic>
+#include <mutex>
+
+/**
+ * @brief (current-output-port) of the running task, nullptr outside futures
+ */
+extern thread_local Value *task_output;
+
+/**
+ * @brief True on a thread that is running the work of a future
+ */
+bool inFuture();
+
+/**
+ * @brief True while futures of the current interpreter are pending or running
+ */
+inline bool futuresRunning() {
+    return Interpreter::current().running_futures.load(std::memory_order_acquire) != 0;
+}
+
+/**
+ * @brief Throws if a value or binding tagged owner may be in use by another
+ *        task (see the sharing rules above)
+ */
+inline void checkUnshared(unsigned owner) {
+    if (owner != task_owner && futuresRunning()) {
+        throw RuntimeError("Mutation of a value shared with a running future");
+    }
+}
+
+/**
+ * @brief Locks m for the rest of the scope, but only while futures run
+ */
+struct ParallelGuard {
+    std::mutex *held;
+    explicit ParallelGuard(std::mutex &m) : held(futuresRunning() ? &m : nullptr) {
+        if (held) held->lock();
+    }
+    ~ParallelGuard() {
+        if (held) held->unlock();
+    }
+    ParallelGuard(const ParallelGuard &) = delete;
+    ParallelGuard &operator=(const ParallelGuard &) = delete;
+};
+
+/**
+ * @brief Sets the number of pool threads; only effective before the first
+ *        future is created (default: std::thread::hardware_concurrency())
+ */
+void setParallelThreads(unsigned);
+
+/**
+ * @brief Number of threads futures run on, counting the waiting thread
+ */
+unsigned parallelThreads();
+
+/**
+ * @brief Queues work for the pool on behalf of the current interpreter
+ *
+ * The calling task gets a new owner tag, so what it allocated so far is
+ * frozen while the future runs.
+ */
+Value spawnFuture(const std::function<Value()> &work);
+
+/**
+ * @brief Waits for a future (running queued work meanwhile) and returns its
+ *        value; throws RuntimeError if the work failed
+ */
+Value touchFuture(Future *);
+
+/**
+ * @brief Waits until every future of interp has finished
+ */
+void waitForFutures(Interpreter &interp);
+
+#endif // PARALLEL
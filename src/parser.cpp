@@ -12,6 +12,7 @@
 #include "syntax.hpp"
 #include "value.hpp"
 #include "expr.hpp"
+#include "pipeline.hpp"
 #include <map>
 #include <string>
 #include <iostream>
@@ -21,8 +22,70 @@ using std::string;
 using std::vector;
 using std::pair;
 
-extern std::map<std::string, ExprType> primitives;
-extern std::map<std::string, ExprType> reserved_words;
+extern const std::map<std::string, ExprType> primitives;
+extern const std::map<std::string, ExprType> reserved_words;
+
+/**
+ * @brief Lookup recording of parseAhead; nullptr during a normal parse
+ */
+struct ParseRecord {
+    Assoc global;           ///< Predicted global env the form is parsed in
+    ParseLookups *lookups;
+    ParseRecord(const Assoc &global, ParseLookups *lookups) : global(global), lookups(lookups) {}
+};
+
+static thread_local ParseRecord *parse_record = nullptr;
+
+/**
+ * @brief Returns find(x, env) != nullptr, recording the answer if it came
+ *        from the predicted global env and x is a primitive or reserved word
+ */
+static bool isBound(const string &x, Assoc &env) {
+    if (parse_record == nullptr) return find(x, env).get() != nullptr;
+    // 只比较名字不拷贝值：全局部分的结点与求值线程共享，值可能正被改写
+    Assoc i = env;
+    for (; i.get() != nullptr && i.get() != parse_record->global.get(); i = i->next) {
+        if (x == i->x) return true;
+    }
+    bool bound = false;
+    for (; i.get() != nullptr; i = i->next) {
+        if (x == i->x) {
+            bound = true;
+            break;
+        }
+    }
+    if (primitives.count(x) == 0 && reserved_words.count(x) == 0) return bound;
+    for (auto &l : *parse_record->lookups) {
+        if (l.first == x) return bound;
+    }
+    parse_record->lookups->push_back(pair<string, bool>(x, bound));
+    return bound;
+}
+
+/**
+ * @brief Extends env with the names bound by internal defines of a body
+ *
+ * Body forms are parsed before any of them runs, so a (define name ...) in a
+ * body has to shadow a primitive of the same name while the whole body is
+ * parsed, just as it will at run time.
+ */
+static Assoc extendBodyDefines(const vector<Syntax> &stxs, size_t from, Assoc env) {
+    Assoc new_env = env;
+    for (size_t i = from; i < stxs.size(); i++) {
+        List *form = dynamic_cast<List*>(stxs[i].get());
+        if (form == nullptr || form->stxs.size() < 2) continue;
+        SymbolSyntax *head = dynamic_cast<SymbolSyntax*>(form->stxs[0].get());
+        if (head == nullptr || head->s != "define" || isBound(head->s, env)) continue;
+        SymbolSyntax *name = dynamic_cast<SymbolSyntax*>(form->stxs[1].get());
+        if (List *sig = dynamic_cast<List*>(form->stxs[1].get())) {
+            if (!sig->stxs.empty()) name = dynamic_cast<SymbolSyntax*>(sig->stxs[0].get());
+        }
+        if (name != nullptr) {
+            new_env = extend(name->s, VoidV(), new_env);
+        }
+    }
+    return new_env;
+}
 
 /**
  * @brief Default parse method (should be overridden by subclasses)
@@ -57,6 +120,10 @@ Expr FalseSyntax::parse(Assoc &env) {
 }
 
 Expr List::parse(Assoc &env) {
+    char here;
+    if (&here < stack_limit) { // 读得进来的嵌套，解析时也不能用完栈
+        throw RuntimeError("Nesting too deep");
+    }
     if (stxs.empty()) {
         return Expr(new Quote(Syntax(new List())));
     }
@@ -75,7 +142,7 @@ Expr List::parse(Assoc &env) {
         return Expr(new Apply(function,args));
     }else{
         string op = id->s;
-        if (find(op, env).get() != nullptr) {
+        if (isBound(op, env)) {
             //TODO: TO COMPLETE THE PARAMETER PARSER LOGIC
             vector<Expr>args;
             for(int i=1;i<stxs.size();i++){
@@ -88,7 +155,7 @@ Expr List::parse(Assoc &env) {
             for(int i=1;i<stxs.size();i++)
                 parameters.push_back(stxs[i]->parse(env));
             //TODO: TO COMPLETE THE PARAMETER PARSER LOGIC
-            ExprType op_type = primitives[op];
+            ExprType op_type = primitives.at(op);
             if (op_type == E_PLUS) {
                 if (parameters.size() == 2) {
                     return Expr(new Plus(parameters[0], parameters[1])); 
@@ -209,6 +276,83 @@ Expr List::parse(Assoc &env) {
                 return Expr(new SetCdr(parameters[0], parameters[1]));
             } else if (op_type == E_LIST) {
                 return Expr(new ListFunc(parameters));
+            } else if (op_type == E_LENGTH) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of length");
+                }
+                return Expr(new Length(parameters[0]));
+            } else if (op_type == E_APPEND) {
+                return Expr(new Append(parameters));
+            } else if (op_type == E_REVERSE) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of reverse");
+                }
+                return Expr(new Reverse(parameters[0]));
+            } else if (op_type == E_LIST_TAIL) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of list-tail");
+                }
+                return Expr(new ListTail(parameters[0], parameters[1]));
+            } else if (op_type == E_LIST_REF) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of list-ref");
+                }
+                return Expr(new ListRef(parameters[0], parameters[1]));
+            } else if (op_type == E_MEMQ) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of memq");
+                }
+                return Expr(new Memq(parameters[0], parameters[1]));
+            } else if (op_type == E_ASSQ) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of assq");
+                }
+                return Expr(new Assq(parameters[0], parameters[1]));
+            } else if (op_type == E_ASSOC) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of assoc");
+                }
+                return Expr(new Assoc_(parameters[0], parameters[1]));
+            } else if (op_type == E_MAP) {
+                if (parameters.size() < 2) {
+                    throw RuntimeError("Wrong number of map");
+                }
+                return Expr(new MapFunc(parameters));
+            } else if (op_type == E_FOR_EACH) {
+                if (parameters.size() < 2) {
+                    throw RuntimeError("Wrong number of for-each");
+                }
+                return Expr(new ForEach(parameters));
+            } else if (op_type == E_FILTER) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of filter");
+                }
+                return Expr(new Filter(parameters));
+            } else if (op_type == E_FOLD_LEFT) {
+                if (parameters.size() < 3) {
+                    throw RuntimeError("Wrong number of fold-left");
+                }
+                return Expr(new FoldLeft(parameters));
+            } else if (op_type == E_FOLD_RIGHT) {
+                if (parameters.size() < 3) {
+                    throw RuntimeError("Wrong number of fold-right");
+                }
+                return Expr(new FoldRight(parameters));
+            } else if (op_type == E_APPLY_PROC) {
+                if (parameters.size() < 2) {
+                    throw RuntimeError("Wrong number of apply");
+                }
+                return Expr(new ApplyFunc(parameters));
+            } else if (op_type == E_SORT) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of sort");
+                }
+                return Expr(new Sort(parameters[0], parameters[1]));
+            } else if (op_type == E_SORT_BANG) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of sort!");
+                }
+                return Expr(new SortBang(parameters[0], parameters[1]));
             } else if (op_type == E_LISTQ) {
                 if (parameters.size() != 1) {
                     throw RuntimeError("Wrong number of list?");
@@ -255,10 +399,95 @@ Expr List::parse(Assoc &env) {
                 }
                 return Expr(new IsEq(parameters[0], parameters[1]));
             } else if (op_type == E_DISPLAY) {
-                if (parameters.size() != 1) {
+                if (parameters.size() != 1 && parameters.size() != 2) {
                     throw RuntimeError("Wrong number of display");
                 }
-                return Expr(new Display(parameters[0]));
+                return Expr(new Display(parameters));
+            } else if (op_type == E_WRITE) {
+                if (parameters.size() != 1 && parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of write");
+                }
+                return Expr(new Write(parameters));
+            } else if (op_type == E_NEWLINE) {
+                if (parameters.size() > 1) {
+                    throw RuntimeError("Wrong number of newline");
+                }
+                return Expr(new Newline(parameters));
+            } else if (op_type == E_FLUSH_OUTPUT) {
+                if (parameters.size() > 1) {
+                    throw RuntimeError("Wrong number of flush-output");
+                }
+                return Expr(new FlushOutput(parameters));
+            } else if (op_type == E_CURRENT_OUTPUT_PORT) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of current-output-port");
+                }
+                return Expr(new CurrentOutputPort(parameters));
+            } else if (op_type == E_OPEN_OUTPUT_STRING) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of open-output-string");
+                }
+                return Expr(new OpenOutputString(parameters));
+            } else if (op_type == E_GET_OUTPUT_STRING) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of get-output-string");
+                }
+                return Expr(new GetOutputString(parameters[0]));
+            } else if (op_type == E_WITH_OUTPUT_TO_STRING) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of with-output-to-string");
+                }
+                return Expr(new WithOutputToString(parameters[0]));
+            } else if (op_type == E_OPEN_INPUT_FILE) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of open-input-file");
+                }
+                return Expr(new OpenInputFile(parameters[0]));
+            } else if (op_type == E_CLOSE_INPUT_PORT) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of close-input-port");
+                }
+                return Expr(new CloseInputPort(parameters[0]));
+            } else if (op_type == E_READ_LINE) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of read-line");
+                }
+                return Expr(new ReadLine(parameters[0]));
+            } else if (op_type == E_READ_CHAR) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of read-char");
+                }
+                return Expr(new ReadChar(parameters[0]));
+            } else if (op_type == E_PEEK_CHAR) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of peek-char");
+                }
+                return Expr(new PeekChar(parameters[0]));
+            } else if (op_type == E_READ) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of read");
+                }
+                return Expr(new ReadDatum(parameters[0]));
+            } else if (op_type == E_EOF_OBJECTQ) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of eof-object?");
+                }
+                return Expr(new IsEof(parameters[0]));
+            } else if (op_type == E_CALL_WITH_INPUT_FILE) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of call-with-input-file");
+                }
+                return Expr(new CallWithInputFile(parameters[0], parameters[1]));
+            } else if (op_type == E_EOF_OBJECT) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of eof-object");
+                }
+                return Expr(new MakeEof(parameters));
+            } else if (op_type == E_COMMAND_LINE) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of command-line");
+                }
+                return Expr(new CommandLine(parameters));
             } else if (op_type == E_VOID) {
                 if (!parameters.empty()) {
                     throw RuntimeError("Wrong number of void");
@@ -269,13 +498,244 @@ Expr List::parse(Assoc &env) {
                     throw RuntimeError("Wrong number of exit");
                 }
                 return Expr(new Exit());
+            } else if (op_type == E_HASHMAP) {
+                return Expr(new MakeHashMap(parameters));
+            } else if (op_type == E_HASHMAPQ) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of hash-map?");
+                }
+                return Expr(new IsHashMap(parameters[0]));
+            } else if (op_type == E_HASHMAP_REF) {
+                return Expr(new HashMapRef(parameters));
+            } else if (op_type == E_HASHMAP_SET) {
+                return Expr(new HashMapSet(parameters));
+            } else if (op_type == E_HASHMAP_REMOVE) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of hash-map-remove");
+                }
+                return Expr(new HashMapRemove(parameters[0], parameters[1]));
+            } else if (op_type == E_HASHMAP_CONTAINSQ) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of hash-map-contains?");
+                }
+                return Expr(new HashMapContains(parameters[0], parameters[1]));
+            } else if (op_type == E_HASHMAP_COUNT) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of hash-map-count");
+                }
+                return Expr(new HashMapCount(parameters[0]));
+            } else if (op_type == E_HASHMAP_TO_LIST) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of hash-map->alist");
+                }
+                return Expr(new HashMapToList(parameters[0]));
+            } else if (op_type == E_HASHMAP_SET_BANG) {
+                return Expr(new HashMapSetBang(parameters));
+            } else if (op_type == E_HASHMAP_REMOVE_BANG) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of hash-map-remove!");
+                }
+                return Expr(new HashMapRemoveBang(parameters[0], parameters[1]));
+            } else if (op_type == E_PVECTOR) {
+                return Expr(new MakePVector(parameters));
+            } else if (op_type == E_PVECTORQ) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of pvector?");
+                }
+                return Expr(new IsPVector(parameters[0]));
+            } else if (op_type == E_PVECTOR_REF) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of pvector-ref");
+                }
+                return Expr(new PVectorRef(parameters[0], parameters[1]));
+            } else if (op_type == E_PVECTOR_SET) {
+                return Expr(new PVectorSet(parameters));
+            } else if (op_type == E_PVECTOR_PUSH) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of pvector-push");
+                }
+                return Expr(new PVectorPush(parameters[0], parameters[1]));
+            } else if (op_type == E_PVECTOR_LENGTH) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of pvector-length");
+                }
+                return Expr(new PVectorLength(parameters[0]));
+            } else if (op_type == E_PVECTOR_TO_LIST) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of pvector->list");
+                }
+                return Expr(new PVectorToList(parameters[0]));
+            } else if (op_type == E_LIST_TO_PVECTOR) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of list->pvector");
+                }
+                return Expr(new ListToPVector(parameters[0]));
+            } else if (op_type == E_PVECTOR_SET_BANG) {
+                return Expr(new PVectorSetBang(parameters));
+            } else if (op_type == E_PVECTOR_PUSH_BANG) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of pvector-push!");
+                }
+                return Expr(new PVectorPushBang(parameters[0], parameters[1]));
+            } else if (op_type == E_TRANSIENT) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of transient");
+                }
+                return Expr(new Transient(parameters[0]));
+            } else if (op_type == E_PERSISTENT) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of persistent!");
+                }
+                return Expr(new Persistent(parameters[0]));
+            } else if (op_type == E_STRING_LENGTH) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of string-length");
+                }
+                return Expr(new StringLength(parameters[0]));
+            } else if (op_type == E_STRING_REF) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of string-ref");
+                }
+                return Expr(new StringRef(parameters[0], parameters[1]));
+            } else if (op_type == E_SUBSTRING) {
+                if (parameters.size() != 2 && parameters.size() != 3) {
+                    throw RuntimeError("Wrong number of substring");
+                }
+                return Expr(new Substring(parameters));
+            } else if (op_type == E_STRING_APPEND) {
+                return Expr(new StringAppend(parameters));
+            } else if (op_type == E_STRING_EQ) {
+                if (parameters.empty()) {
+                    throw RuntimeError("Wrong number of string=?");
+                }
+                return Expr(new StringEq(parameters));
+            } else if (op_type == E_STRING_LT) {
+                if (parameters.empty()) {
+                    throw RuntimeError("Wrong number of string<?");
+                }
+                return Expr(new StringLess(parameters));
+            } else if (op_type == E_STRING_TO_SYMBOL) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of string->symbol");
+                }
+                return Expr(new StringToSymbol(parameters[0]));
+            } else if (op_type == E_SYMBOL_TO_STRING) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of symbol->string");
+                }
+                return Expr(new SymbolToString(parameters[0]));
+            } else if (op_type == E_NUMBER_TO_STRING) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of number->string");
+                }
+                return Expr(new NumberToString(parameters[0]));
+            } else if (op_type == E_STRING_TO_NUMBER) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of string->number");
+                }
+                return Expr(new StringToNumber(parameters[0]));
+            } else if (op_type == E_STRING_SEARCH_FORWARD) {
+                if (parameters.size() != 2 && parameters.size() != 3) {
+                    throw RuntimeError("Wrong number of string-search-forward");
+                }
+                return Expr(new StringSearchForward(parameters));
+            } else if (op_type == E_STRING_INDEX) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of string-index");
+                }
+                return Expr(new StringIndex(parameters[0], parameters[1]));
+            } else if (op_type == E_STRING_CONTAINS) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of string-contains");
+                }
+                return Expr(new StringContains(parameters[0], parameters[1]));
+            } else if (op_type == E_TOUCH) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of touch");
+                }
+                return Expr(new Touch(parameters[0]));
+            } else if (op_type == E_PMAP) {
+                if (parameters.size() < 2) {
+                    throw RuntimeError("Wrong number of pmap");
+                }
+                return Expr(new PMap(parameters));
+            } else if (op_type == E_PFOR_EACH) {
+                if (parameters.size() < 2) {
+                    throw RuntimeError("Wrong number of pfor-each");
+                }
+                return Expr(new PForEach(parameters));
+            } else if (op_type == E_SPAWN) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of spawn");
+                }
+                return Expr(new Spawn(parameters[0]));
+            } else if (op_type == E_YIELD) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of yield");
+                }
+                return Expr(new Yield(parameters));
+            } else if (op_type == E_MAKE_CHANNEL) {
+                if (parameters.size() > 1) {
+                    throw RuntimeError("Wrong number of make-channel");
+                }
+                return Expr(new MakeChannel(parameters));
+            } else if (op_type == E_CHANNEL_PUT) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of channel-put");
+                }
+                return Expr(new ChannelPut(parameters[0], parameters[1]));
+            } else if (op_type == E_CHANNEL_GET) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of channel-get");
+                }
+                return Expr(new ChannelGet(parameters[0]));
+            } else if (op_type == E_CALLEC) {
+                if (parameters.size() != 1) {
+                    throw RuntimeError("Wrong number of " + op);
+                }
+                return Expr(new CallEC(parameters[0]));
+            } else if (op_type == E_AFTER) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of after");
+                }
+                return Expr(new After(parameters[0], parameters[1]));
+            } else if (op_type == E_READ_FILE_ASYNC) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of read-file-async");
+                }
+                return Expr(new ReadFileAsync(parameters[0], parameters[1]));
+            } else if (op_type == E_ON_READABLE) {
+                if (parameters.size() != 2) {
+                    throw RuntimeError("Wrong number of on-readable");
+                }
+                return Expr(new OnReadable(parameters[0], parameters[1]));
+            } else if (op_type == E_RUN_EVENT_LOOP) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of run-event-loop");
+                }
+                return Expr(new RunEventLoop(parameters));
+            } else if (op_type == E_PROFILE_START) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of profile-start");
+                }
+                return Expr(new ProfileStart(parameters));
+            } else if (op_type == E_PROFILE_STOP) {
+                if (parameters.size() > 1) {
+                    throw RuntimeError("Wrong number of profile-stop");
+                }
+                return Expr(new ProfileStop(parameters));
+            } else if (op_type == E_RUNTIME_STATS) {
+                if (!parameters.empty()) {
+                    throw RuntimeError("Wrong number of runtime-stats");
+                }
+                return Expr(new RuntimeStats(parameters));
             } else {
                 //TODO: TO COMPLETE THE LOGIC
                 throw RuntimeError("Unknown primitives: "+op);
             } 
         }
         if (reserved_words.count(op) != 0) {
-            switch (reserved_words[op]) {
+            switch (reserved_words.at(op)) {
                 //TODO: TO COMPLETE THE reserve_words PARSER LOGIC
                 case E_BEGIN:{
                     vector<Expr> exprs;
@@ -310,6 +770,7 @@ Expr List::parse(Assoc &env) {
                     for (const auto &param : parms) {
                         new_env = extend(param, VoidV(), new_env);//用空来在新环境占位
                     }
+                    new_env = extendBodyDefines(stxs, 2, new_env);
                     if (stxs.size() > 3) {
                         vector<Expr> expr;
                         for(size_t i = 2; i < stxs.size(); i++) {
@@ -351,10 +812,11 @@ Expr List::parse(Assoc &env) {
                             params.push_back(sym->s);
                         }
 
-                        Assoc new_env = env;
+                        Assoc new_env = extend(name->s, VoidV(), env);//函数名在函数体内可见（递归）
                         for (const auto& name : params) {
                             new_env = extend(name, VoidV(), new_env);//新环境
                         }
+                        new_env = extendBodyDefines(stxs, 2, new_env);
                         vector<Expr> expr;
                         for (size_t i = 2; i < stxs.size(); i++) {
                             expr.push_back(stxs[i]->parse(new_env));
@@ -371,7 +833,8 @@ Expr List::parse(Assoc &env) {
                         if (name == nullptr) {
                             throw RuntimeError("");
                         }
-                        return Expr(new Define(name->s, stxs[2]->parse(env)));
+                        Assoc new_env = extend(name->s, VoidV(), env);
+                        return Expr(new Define(name->s, stxs[2]->parse(new_env)));
                     }
                 }
                 case E_COND:{
@@ -422,6 +885,7 @@ Expr List::parse(Assoc &env) {
                         bindings.push_back({var->s,pair->stxs[1]->parse(env)});
                         new_env = extend(var->s, VoidV(), new_env);//先进行新环境的创建
                     }
+                    new_env = extendBodyDefines(stxs, 2, new_env);
                     if (stxs.size() > 3) {//多个表达式
                         vector<Expr> exprs;
                         for(size_t i = 2; i < stxs.size(); i++) {
@@ -462,6 +926,7 @@ Expr List::parse(Assoc &env) {
                         SymbolSyntax *var = dynamic_cast<SymbolSyntax*>(pair->stxs[0].get());
                         bindings.push_back({var->s, pair->stxs[1]->parse(new_env)});
                     }
+                    new_env = extendBodyDefines(stxs, 2, new_env);
                     if (stxs.size() > 3) {
                         vector<Expr> exprs;
                         for(size_t i = 2; i < stxs.size(); i++) {
@@ -482,6 +947,18 @@ Expr List::parse(Assoc &env) {
                         }
                         return Expr(new Set(name->s, stxs[2]->parse(env)));
                 }
+                case E_FUTURE: {
+                    if (stxs.size() != 2) {
+                        throw RuntimeError("Wrong number of arguments for future");
+                    }
+                    return Expr(new FutureExpr(stxs[1]->parse(env)));
+                }
+                case E_TIME: {
+                    if (stxs.size() != 2) {
+                        throw RuntimeError("Wrong number of arguments for time");
+                    }
+                    return Expr(new TimeExpr(stxs[1]->parse(env)));
+                }
                 default:
                     throw RuntimeError("Unknown reserved word: " + op);
             }
@@ -495,4 +972,40 @@ Expr List::parse(Assoc &env) {
             args.push_back(stxs[i]->parse(env));
         return Expr(new Apply(rator,args));
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Extends env with the names a top-level form will define
+ */
+static Assoc predictDefines(const Syntax &stx, Assoc env) {
+    List *form = dynamic_cast<List*>(stx.get());
+    if (form == nullptr || form->stxs.empty()) return env;
+    SymbolSyntax *head = dynamic_cast<SymbolSyntax*>(form->stxs[0].get());
+    if (head != nullptr && head->s == "begin" && !isBound(head->s, env)) {
+        for (size_t i = 1; i < form->stxs.size(); i++)
+            env = predictDefines(form->stxs[i], env);
+        return env;
+    }
+    return extendBodyDefines(vector<Syntax>(1, stx), 0, env);
+}
+
+Expr parseAhead(const Syntax &stx, Assoc &env, ParseLookups &lookups) {
+    ParseRecord record(env, &lookups);
+    parse_record = &record;
+    try {
+        Expr expr = stx->parse(env);
+        env = predictDefines(stx, env);
+        parse_record = nullptr;
+        return expr;
+    } catch (...) {
+        parse_record = nullptr;
+        throw;
+    }
+}
+
+bool lookupsHold(const ParseLookups &lookups, Assoc &env) {
+    for (auto &l : lookups) {
+        if ((find(l.first, env).get() != nullptr) != l.second) return false;
+    }
+    return true;
+}
@@ -0,0 +1,389 @@
+/**
+ * @file persistent.cpp
+ * @brief Implementation of the persistent hash map and vector tries
+ *
+ * Both tries follow the same update discipline: a node is written in place
+ * only when it was created under the caller's (non-zero) edit id, otherwise
+ * it is copied first. Lookups never allocate.
+ */
+
+#include "persistent.hpp"
+#include "RE.hpp"
+#include <atomic>
+#include <functional>
+#include <string>
+
+// ============================================================================
+// Key hashing and equality
+// ============================================================================
+
+static unsigned mixHash(unsigned long long x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (unsigned)x;
+}
+
+unsigned valueHash(const Value &v) {
+    switch (v->v_type) {
+        case V_INT:
+            return mixHash((unsigned long long)(long long)static_cast<Integer*>(v.get())->n);
+        case V_RATIONAL: {
+            Rational *r = static_cast<Rational*>(v.get());
+            return mixHash(((unsigned long long)(unsigned)r->numerator << 32) ^ (unsigned)r->denominator);
+        }
+        case V_BOOL:
+            return static_cast<Boolean*>(v.get())->b ? 0x9e3779b9u : 0x7f4a7c15u;
+        case V_SYM:
+            return mixHash((unsigned long long)(size_t)v.get()); // interned
+        case V_STRING:
+            return mixHash(std::hash<std::string>()(static_cast<String*>(v.get())->str()) ^ 1);
+        case V_NULL:
+            return 0x85ebca6bu;
+        case V_VOID:
+            return 0xc2b2ae35u;
+        default:
+            return mixHash((unsigned long long)(size_t)v.get());
+    }
+}
+
+bool valueKeyEqual(const Value &a, const Value &b) {
+    if (a.get() == b.get()) return true;
+    if (a->v_type != b->v_type) return false;
+    switch (a->v_type) {
+        case V_INT:
+            return static_cast<Integer*>(a.get())->n == static_cast<Integer*>(b.get())->n;
+        case V_RATIONAL:
+            return static_cast<Rational*>(a.get())->numerator == static_cast<Rational*>(b.get())->numerator &&
+                   static_cast<Rational*>(a.get())->denominator == static_cast<Rational*>(b.get())->denominator;
+        case V_BOOL:
+            return static_cast<Boolean*>(a.get())->b == static_cast<Boolean*>(b.get())->b;
+        case V_STRING:
+            return stringEqual(static_cast<String*>(a.get()), static_cast<String*>(b.get()));
+        case V_NULL:
+        case V_VOID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+unsigned long long newEditId() {
+    static std::atomic<unsigned long long> next_edit(0); // 各解释器实例共用
+    return ++next_edit;
+}
+
+// ============================================================================
+// Hash array mapped trie
+// ============================================================================
+
+static const int HAMT_BITS = 5;
+static const int HAMT_MAX_SHIFT = 32; // shift at which only collision buckets remain
+
+HamtEntry::HamtEntry(unsigned h, const Value &k, const Value &v)
+    : hash(h), key(k), val(v), child(nullptr) {}
+
+HamtEntry::HamtEntry(const HamtPtr &c)
+    : hash(0), key(nullptr), val(nullptr), child(c) {}
+
+HamtNode::HamtNode(unsigned long long e) : bitmap(0), edit(e) {}
+
+static inline unsigned hamtBit(unsigned hash, int shift) {
+    return 1u << ((hash >> shift) & 31);
+}
+
+static inline int hamtIndex(unsigned bitmap, unsigned bit) {
+    return __builtin_popcount(bitmap & (bit - 1));
+}
+
+// Returns n itself when it may be written under edit, otherwise a copy
+static HamtPtr hamtEditable(const HamtPtr &n, unsigned long long edit) {
+    if (edit != 0 && n->edit == edit) {
+        return n;
+    }
+    HamtPtr copy(new HamtNode(edit));
+    copy->bitmap = n->bitmap;
+    copy->entries = n->entries;
+    return copy;
+}
+
+// Builds the smallest sub-trie holding two leaves whose hashes agree below shift
+static HamtPtr hamtMerge(int shift, const HamtEntry &e1, const HamtEntry &e2,
+                         unsigned long long edit) {
+    HamtPtr node(new HamtNode(edit));
+    if (shift >= HAMT_MAX_SHIFT) {
+        node->entries.push_back(e1);
+        node->entries.push_back(e2);
+        return node;
+    }
+    unsigned b1 = hamtBit(e1.hash, shift);
+    unsigned b2 = hamtBit(e2.hash, shift);
+    if (b1 == b2) {
+        node->bitmap = b1;
+        node->entries.push_back(HamtEntry(hamtMerge(shift + HAMT_BITS, e1, e2, edit)));
+    } else {
+        node->bitmap = b1 | b2;
+        if (b1 < b2) {
+            node->entries.push_back(e1);
+            node->entries.push_back(e2);
+        } else {
+            node->entries.push_back(e2);
+            node->entries.push_back(e1);
+        }
+    }
+    return node;
+}
+
+Value hamtFind(const HamtPtr &root, unsigned hash, const Value &key) {
+    HamtNode *node = root.get();
+    int shift = 0;
+    while (node != nullptr) {
+        if (shift >= HAMT_MAX_SHIFT) {
+            for (auto &e : node->entries) {
+                if (valueKeyEqual(e.key, key)) return e.val;
+            }
+            return Value(nullptr);
+        }
+        unsigned bit = hamtBit(hash, shift);
+        if ((node->bitmap & bit) == 0) return Value(nullptr);
+        HamtEntry &e = node->entries[hamtIndex(node->bitmap, bit)];
+        if (e.child.get() == nullptr) {
+            if (e.hash == hash && valueKeyEqual(e.key, key)) return e.val;
+            return Value(nullptr);
+        }
+        node = e.child.get();
+        shift += HAMT_BITS;
+    }
+    return Value(nullptr);
+}
+
+HamtPtr hamtAssoc(const HamtPtr &root, int shift, unsigned hash, const Value &key,
+                  const Value &val, unsigned long long edit, bool &added) {
+    if (root.get() == nullptr) {
+        HamtPtr node(new HamtNode(edit));
+        HamtEntry leaf(hash, key, val);
+        if (shift >= HAMT_MAX_SHIFT) {
+            node->entries.push_back(leaf);
+        } else {
+            node->bitmap = hamtBit(hash, shift);
+            node->entries.push_back(leaf);
+        }
+        added = true;
+        return node;
+    }
+    if (shift >= HAMT_MAX_SHIFT) { // collision bucket
+        for (size_t i = 0; i < root->entries.size(); i++) {
+            if (valueKeyEqual(root->entries[i].key, key)) {
+                if (root->entries[i].val.get() == val.get()) return root;
+                HamtPtr node = hamtEditable(root, edit);
+                node->entries[i].val = val;
+                return node;
+            }
+        }
+        HamtPtr node = hamtEditable(root, edit);
+        node->entries.push_back(HamtEntry(hash, key, val));
+        added = true;
+        return node;
+    }
+    unsigned bit = hamtBit(hash, shift);
+    int idx = hamtIndex(root->bitmap, bit);
+    if ((root->bitmap & bit) == 0) {
+        HamtPtr node = hamtEditable(root, edit);
+        node->bitmap |= bit;
+        node->entries.insert(node->entries.begin() + idx, HamtEntry(hash, key, val));
+        added = true;
+        return node;
+    }
+    const HamtEntry &e = root->entries[idx];
+    if (e.child.get() != nullptr) {
+        HamtPtr child = hamtAssoc(e.child, shift + HAMT_BITS, hash, key, val, edit, added);
+        if (child.get() == e.child.get()) return root;
+        HamtPtr node = hamtEditable(root, edit);
+        node->entries[idx].child = child;
+        return node;
+    }
+    if (e.hash == hash && valueKeyEqual(e.key, key)) {
+        if (e.val.get() == val.get()) return root;
+        HamtPtr node = hamtEditable(root, edit);
+        node->entries[idx].val = val;
+        return node;
+    }
+    HamtPtr child = hamtMerge(shift + HAMT_BITS, e, HamtEntry(hash, key, val), edit);
+    HamtPtr node = hamtEditable(root, edit);
+    node->entries[idx] = HamtEntry(child);
+    added = true;
+    return node;
+}
+
+HamtPtr hamtDissoc(const HamtPtr &root, int shift, unsigned hash, const Value &key,
+                   unsigned long long edit, bool &removed) {
+    if (root.get() == nullptr) return root;
+    if (shift >= HAMT_MAX_SHIFT) { // collision bucket
+        for (size_t i = 0; i < root->entries.size(); i++) {
+            if (valueKeyEqual(root->entries[i].key, key)) {
+                removed = true;
+                if (root->entries.size() == 1) return HamtPtr(nullptr);
+                HamtPtr node = hamtEditable(root, edit);
+                node->entries.erase(node->entries.begin() + i);
+                return node;
+            }
+        }
+        return root;
+    }
+    unsigned bit = hamtBit(hash, shift);
+    if ((root->bitmap & bit) == 0) return root;
+    int idx = hamtIndex(root->bitmap, bit);
+    const HamtEntry &e = root->entries[idx];
+    if (e.child.get() != nullptr) {
+        HamtPtr child = hamtDissoc(e.child, shift + HAMT_BITS, hash, key, edit, removed);
+        if (child.get() == e.child.get()) return root;
+        if (child.get() == nullptr) {
+            if (root->entries.size() == 1) return HamtPtr(nullptr);
+            HamtPtr node = hamtEditable(root, edit);
+            node->bitmap &= ~bit;
+            node->entries.erase(node->entries.begin() + idx);
+            return node;
+        }
+        HamtPtr node = hamtEditable(root, edit);
+        if (child->entries.size() == 1 && child->entries[0].child.get() == nullptr) {
+            node->entries[idx] = child->entries[0]; // pull a lone leaf back up
+        } else {
+            node->entries[idx].child = child;
+        }
+        return node;
+    }
+    if (e.hash != hash || !valueKeyEqual(e.key, key)) return root;
+    removed = true;
+    if (root->entries.size() == 1) return HamtPtr(nullptr);
+    HamtPtr node = hamtEditable(root, edit);
+    node->bitmap &= ~bit;
+    node->entries.erase(node->entries.begin() + idx);
+    return node;
+}
+
+void hamtEntries(const HamtPtr &root, std::vector<std::pair<Value, Value>> &out) {
+    if (root.get() == nullptr) return;
+    for (auto &e : root->entries) {
+        if (e.child.get() != nullptr) {
+            hamtEntries(e.child, out);
+        } else {
+            out.push_back(std::make_pair(e.key, e.val));
+        }
+    }
+}
+
+// ============================================================================
+// Radix-balanced vector trie
+// ============================================================================
+
+static const int PVEC_BITS = 5;
+static const size_t PVEC_WIDTH = 32;
+
+PVecNode::PVecNode(unsigned long long e) : edit(e) {}
+
+typedef std::shared_ptr<PVecNode> PVecPtr;
+
+static PVecPtr pvecEditable(const PVecPtr &n, unsigned long long edit) {
+    if (edit != 0 && n->edit == edit) {
+        return n;
+    }
+    PVecPtr copy(new PVecNode(edit));
+    copy->kids = n->kids;
+    copy->vals = n->vals;
+    return copy;
+}
+
+static inline size_t pvecTailOff(const PVector *v) {
+    return v->cnt < PVEC_WIDTH ? 0 : ((v->cnt - 1) >> PVEC_BITS) << PVEC_BITS;
+}
+
+const Value &pvecNth(const PVector *v, size_t i) {
+    if (i >= v->cnt) {
+        throw RuntimeError("pvector index out of range");
+    }
+    if (i >= pvecTailOff(v)) {
+        return v->tail->vals[i & (PVEC_WIDTH - 1)];
+    }
+    PVecNode *node = v->root.get();
+    for (int level = v->shift; level > 0; level -= PVEC_BITS) {
+        node = node->kids[(i >> level) & (PVEC_WIDTH - 1)].get();
+    }
+    return node->vals[i & (PVEC_WIDTH - 1)];
+}
+
+static PVecPtr pvecDoAssoc(int level, const PVecPtr &node, size_t i, const Value &val,
+                           unsigned long long edit) {
+    PVecPtr ret = pvecEditable(node, edit);
+    if (level == 0) {
+        ret->vals[i & (PVEC_WIDTH - 1)] = val;
+    } else {
+        size_t sub = (i >> level) & (PVEC_WIDTH - 1);
+        ret->kids[sub] = pvecDoAssoc(level - PVEC_BITS, node->kids[sub], i, val, edit);
+    }
+    return ret;
+}
+
+void pvecAssocN(PVector *v, size_t i, const Value &val, unsigned long long edit) {
+    if (i >= v->cnt) {
+        throw RuntimeError("pvector index out of range");
+    }
+    if (i >= pvecTailOff(v)) {
+        v->tail = pvecEditable(v->tail, edit);
+        v->tail->vals[i & (PVEC_WIDTH - 1)] = val;
+        return;
+    }
+    v->root = pvecDoAssoc(v->shift, v->root, i, val, edit);
+}
+
+static PVecPtr pvecNewPath(int level, const PVecPtr &node, unsigned long long edit) {
+    if (level == 0) return node;
+    PVecPtr ret(new PVecNode(edit));
+    ret->kids.push_back(pvecNewPath(level - PVEC_BITS, node, edit));
+    return ret;
+}
+
+static PVecPtr pvecPushTail(const PVector *v, int level, const PVecPtr &parent,
+                            const PVecPtr &tailnode, unsigned long long edit) {
+    PVecPtr ret = pvecEditable(parent, edit);
+    size_t sub = ((v->cnt - 1) >> level) & (PVEC_WIDTH - 1);
+    PVecPtr insert(nullptr);
+    if (level == PVEC_BITS) {
+        insert = tailnode;
+    } else if (sub < parent->kids.size()) {
+        insert = pvecPushTail(v, level - PVEC_BITS, parent->kids[sub], tailnode, edit);
+    } else {
+        insert = pvecNewPath(level - PVEC_BITS, tailnode, edit);
+    }
+    if (sub < ret->kids.size()) {
+        ret->kids[sub] = insert;
+    } else {
+        ret->kids.push_back(insert);
+    }
+    return ret;
+}
+
+void pvecPush(PVector *v, const Value &val, unsigned long long edit) {
+    if (v->cnt - pvecTailOff(v) < PVEC_WIDTH) {
+        v->tail = pvecEditable(v->tail, edit);
+        v->tail->vals.push_back(val);
+        v->cnt++;
+        return;
+    }
+    // tail is full: move it into the trie, growing a level on root overflow
+    if ((v->cnt >> PVEC_BITS) > ((size_t)1 << v->shift)) {
+        PVecPtr root(new PVecNode(edit));
+        root->kids.push_back(v->root);
+        root->kids.push_back(pvecNewPath(v->shift, v->tail, edit));
+        v->root = root;
+        v->shift += PVEC_BITS;
+    } else {
+        v->root = pvecPushTail(v, v->shift, v->root, v->tail, edit);
+    }
+    PVecPtr tail(new PVecNode(edit));
+    tail->vals.reserve(edit != 0 ? PVEC_WIDTH : 1);
+    tail->vals.push_back(val);
+    v->tail = tail;
+    v->cnt++;
+}
@@ -0,0 +1,91 @@
+#ifndef PERSISTENT
+#define PERSISTENT
+
+/**
+ * @file persistent.hpp
+ * @brief Persistent hash maps and vectors with structural sharing
+ *
+ * HamtNode is a node of a hash array mapped trie (32-way, 5 hash bits per
+ * level); PVecNode is a node of a 32-way radix-balanced vector trie. Updates
+ * copy only the path from the root to the touched slot, so old versions stay
+ * valid and share every untouched node with the new one.
+ *
+ * Transients: every node carries the edit id it was created under. An update
+ * performed with a non-zero edit id mutates nodes stamped with that same id in
+ * place instead of copying them, which turns a batch of updates into a
+ * sequence of in-place writes after the first path copy.
+ */
+
+#include "value.hpp"
+#include <memory>
+#include <vector>
+#include <utility>
+
+// ============================================================================
+// Key hashing and equality (eqv? on atoms, content equality on strings)
+// ============================================================================
+
+unsigned valueHash(const Value &);
+bool valueKeyEqual(const Value &, const Value &);
+
+/**
+ * @brief Returns a fresh, never reused, non-zero edit id for a transient
+ */
+unsigned long long newEditId();
+
+// ============================================================================
+// Hash array mapped trie
+// ============================================================================
+
+struct HamtNode;
+typedef std::shared_ptr<HamtNode> HamtPtr;
+
+/**
+ * @brief Slot of a HamtNode: either a key/value leaf or a sub-trie
+ */
+struct HamtEntry {
+    unsigned hash;      ///< Full hash of key (leaf only)
+    Value key;          ///< Key, or nullptr for a sub-trie slot
+    Value val;          ///< Bound value (leaf only)
+    HamtPtr child;      ///< Sub-trie, or nullptr for a leaf slot
+    HamtEntry(unsigned, const Value &, const Value &);
+    HamtEntry(const HamtPtr &);
+};
+
+/**
+ * @brief Trie node; below depth 7 all hash bits are used up and the node
+ *        degenerates into an unordered collision bucket (bitmap unused)
+ */
+struct HamtNode {
+    unsigned bitmap;
+    std::vector<HamtEntry> entries;
+    unsigned long long edit;
+    HamtNode(unsigned long long);
+};
+
+Value hamtFind(const HamtPtr &, unsigned, const Value &);
+HamtPtr hamtAssoc(const HamtPtr &, int, unsigned, const Value &, const Value &,
+                  unsigned long long, bool &);
+HamtPtr hamtDissoc(const HamtPtr &, int, unsigned, const Value &,
+                   unsigned long long, bool &);
+void hamtEntries(const HamtPtr &, std::vector<std::pair<Value, Value>> &);
+
+// ============================================================================
+// Radix-balanced vector trie
+// ============================================================================
+
+/**
+ * @brief Vector trie node; internal nodes use kids, leaves use vals
+ */
+struct PVecNode {
+    std::vector<std::shared_ptr<PVecNode>> kids;
+    std::vector<Value> vals;
+    unsigned long long edit;
+    PVecNode(unsigned long long);
+};
+
+const Value &pvecNth(const PVector *, size_t);
+void pvecAssocN(PVector *, size_t, const Value &, unsigned long long);
+void pvecPush(PVector *, const Value &, unsigned long long);
+
+#endif // PERSISTENT
@@ -0,0 +1,108 @@
+/**
+ * @file pipeline.cpp
+ * @brief Read/parse-ahead thread feeding the evaluator (see pipeline.hpp)
+ */
+
+#include "pipeline.hpp"
+#include "RE.hpp"
+#include "optimize.hpp"
+#include "loader.hpp"
+#include <chrono>
+#include <istream>
+#include <memory>
+
+ParsedForm::ParsedForm() : stx(nullptr), expr(nullptr), unreadable(false) {}
+
+/**
+ * @brief Waits a little longer each time: yields first, then sleeps, so a
+ *        side that is far ahead does not burn a core while the other catches up
+ */
+static void backoff(unsigned &spins) {
+    if (spins++ < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+FormPipeline::FormPipeline(const char *data, size_t size, const Assoc &env, unsigned read_threads)
+    : data(data), size(size), predicted(env), read_threads(read_threads), ring(CAPACITY),
+      head(0), tail(0), done(false), stop(false) {
+    worker = std::thread(&FormPipeline::produce, this);
+}
+
+FormPipeline::~FormPipeline() {
+    stop.store(true, std::memory_order_release);
+    worker.join();
+}
+
+// 至少这么大的输入才切块并行读取
+static const size_t PARALLEL_READ_MIN_SIZE = 1 << 20;
+
+void FormPipeline::produce() {
+    initStackLimit(); // 本线程上的读取与解析也受栈深检查
+    MemoryStreamBuf buf(data, size);
+    std::istream is(&buf);
+    std::unique_ptr<ParallelReader> reader;
+    if (size >= PARALLEL_READ_MIN_SIZE && read_threads > 0)
+        reader.reset(new ParallelReader(data, size, read_threads));
+    while (!stop.load(std::memory_order_acquire)) {
+        ParsedForm form;
+        try {
+            if (reader) {
+                if (!reader->next(form.stx)) break;
+            } else {
+                if (readSpace(is).peek() == EOF) break;
+                form.stx = readSyntax(is);
+            }
+        } catch (const RuntimeError &) {
+            form.unreadable = true; // 求值线程在这里报错并结束，这之后的输入不再读
+        }
+        if (!form.unreadable) {
+            try {
+                form.expr = parseAhead(form.stx, predicted, form.lookups);
+                fusePipelines(form.expr);
+            } catch (const RuntimeError &) {
+                form.expr = Expr(nullptr); // 交给求值线程在真实环境里重新解析
+            }
+        }
+        size_t t = tail.load(std::memory_order_relaxed);
+        unsigned spins = 0;
+        while (t - head.load(std::memory_order_acquire) == CAPACITY) {
+            if (stop.load(std::memory_order_acquire)) break;
+            backoff(spins);
+        }
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) break;
+        bool last = form.unreadable;
+        ring[t % CAPACITY] = std::move(form);
+        tail.store(t + 1, std::memory_order_release);
+        if (last) break;
+    }
+    done.store(true, std::memory_order_release);
+}
+
+Expr FormPipeline::next(Assoc &env) {
+    size_t h = head.load(std::memory_order_relaxed);
+    unsigned spins = 0;
+    while (tail.load(std::memory_order_acquire) == h) {
+        if (done.load(std::memory_order_acquire) && tail.load(std::memory_order_acquire) == h)
+            return Expr(nullptr);
+        backoff(spins);
+    }
+    ParsedForm &slot = ring[h % CAPACITY];
+    Syntax stx = slot.stx;
+    Expr expr = slot.expr;
+    bool unreadable = slot.unreadable;
+    bool valid = expr.get() != nullptr && lookupsHold(slot.lookups, env);
+    slot.stx = Syntax(nullptr);
+    slot.expr = Expr(nullptr);
+    head.store(h + 1, std::memory_order_release);
+    if (unreadable)
+        throw RuntimeError("Malformed form");
+    if (!valid) {
+        // 预测的遮蔽关系与实际不符（或预解析失败）：按真实环境重新解析
+        expr = stx->parse(env);
+        fusePipelines(expr);
+    }
+    return expr;
+}
@@ -0,0 +1,101 @@
+#ifndef PIPELINE
+#define PIPELINE
+
+/**
+ * @file pipeline.hpp
+ * @brief Batch mode that reads and parses ahead of the evaluator
+ *
+ * A producer thread reads top-level forms from a byte range (inputs of 1 MiB
+ * or more on a pool of reader threads when asked for, see loader.hpp),
+ * parses them against a predicted
+ * global environment and hands them to the evaluating thread through a
+ * bounded single-producer/single-consumer ring.
+ *
+ * Parsing a form depends on the global environment only through one question:
+ * is a primitive or reserved word currently shadowed by a global binding? The
+ * prediction assumes every earlier top-level define has run. Each parsed form
+ * carries the answers it relied on, and the evaluator re-checks them against
+ * the real environment just before evaluation, parsing the form again on any
+ * disagreement, so the result is the same as strict read-parse-eval order.
+ */
+
+#include "Def.hpp"
+#include "syntax.hpp"
+#include "expr.hpp"
+#include "value.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Global lookups a parse depended on: (name, was it bound)
+ */
+typedef std::vector<std::pair<std::string, bool>> ParseLookups;
+
+/**
+ * @brief Parses a top-level form against the predicted global env
+ *
+ * Records into lookups every primitive or reserved word whose meaning was
+ * decided by a global binding, then extends env with the names the form
+ * defines at top level (including those inside a top-level begin).
+ */
+Expr parseAhead(const Syntax &, Assoc &env, ParseLookups &lookups);
+
+/**
+ * @brief Returns true if every recorded lookup still has the same answer in env
+ */
+bool lookupsHold(const ParseLookups &, Assoc &env);
+
+/**
+ * @brief One slot of the ring: a parsed form, or a parse to be redone
+ */
+struct ParsedForm {
+    Syntax stx;
+    Expr expr;             ///< nullptr if the ahead-of-time parse threw
+    ParseLookups lookups;
+    bool unreadable;       ///< The form did not read; the producer stopped here
+    ParsedForm();
+};
+
+/**
+ * @brief Reads and parses forms of a byte range on a background thread
+ *
+ * The range must stay valid until the pipeline is destroyed. Destroying the
+ * pipeline before the end of input (e.g. after (exit)) stops the producer.
+ * With read_threads > 0, inputs of 1 MiB or more are read on that many
+ * ParallelReader threads.
+ */
+class FormPipeline {
+public:
+    FormPipeline(const char *, size_t, const Assoc &, unsigned read_threads = 0);
+    ~FormPipeline();
+
+    /**
+     * @brief Returns the next form parsed for env, or nullptr at end of input
+     *
+     * Throws RuntimeError if the form does not parse in env, or does not read
+     * at all (unterminated, or a stray ')'); in that case the input ends
+     * there, as it does for evalForms.
+     */
+    Expr next(Assoc &env);
+
+private:
+    static const size_t CAPACITY = 256;
+
+    void produce();
+
+    const char *data;
+    size_t size;
+    Assoc predicted;
+    unsigned read_threads;
+    std::vector<ParsedForm> ring;
+    std::atomic<size_t> head;   ///< next slot to pop (consumer)
+    std::atomic<size_t> tail;   ///< next slot to fill (producer)
+    std::atomic<bool> done;     ///< producer reached end of input
+    std::atomic<bool> stop;     ///< consumer is gone
+    std::thread worker;
+};
+
+#endif // PIPELINE
@@ -0,0 +1,246 @@
+/**
+ * @file printer.cpp
+ * @brief Iterative printer for values that may be deep, shared or cyclic
+ *
+ * Printing runs in two passes over an explicit stack, so neither depth nor
+ * length of a structure is limited by the C++ stack:
+ *
+ * 1. A depth-first walk (car before cdr, containers in element order) marks
+ *    every container reached again while it is still on the current path.
+ *    Those are exactly the nodes that close a cycle.
+ * 2. The print walk follows the same order. A marked node gets a datum label
+ *    "#n=" the first time and is printed as "#n#" afterwards. Shared but
+ *    acyclic structure is printed in full, as before, so output for acyclic
+ *    data is unchanged.
+ */
+
+#include "value.hpp"
+#include "persistent.hpp"
+#include "interpreter.hpp"
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+size_t formatInt(long long v, char *out) {
+    char tmp[24];
+    size_t n = 0;
+    unsigned long long u = v < 0 ? 0ull - static_cast<unsigned long long>(v)
+                                 : static_cast<unsigned long long>(v);
+    do {
+        tmp[n++] = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    size_t len = 0;
+    if (v < 0) out[len++] = '-';
+    while (n > 0) out[len++] = tmp[--n];
+    return len;
+}
+
+static bool isContainer(ValueBase *v) {
+    return v->v_type == V_PAIR || v->v_type == V_HASHMAP || v->v_type == V_PVECTOR;
+}
+
+// 按打印顺序列出容器的直接子节点
+static void children(ValueBase *v, std::vector<ValueBase*> &out) {
+    out.clear();
+    if (v->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(v);
+        out.push_back(p->car.get());
+        out.push_back(p->cdr.get());
+    } else if (v->v_type == V_HASHMAP) {
+        std::vector<std::pair<Value, Value>> entries;
+        hamtEntries(static_cast<HashMap*>(v)->root, entries);
+        for (auto &kv : entries) {
+            out.push_back(kv.first.get());
+            out.push_back(kv.second.get());
+        }
+    } else if (v->v_type == V_PVECTOR) {
+        PVector *vec = static_cast<PVector*>(v);
+        for (size_t i = 0; i < vec->cnt; i++) {
+            out.push_back(pvecNth(vec, i).get());
+        }
+    }
+}
+
+// 第 i 个子节点；hash map 的子节点预先展开在 kids 里
+static ValueBase *childAt(ValueBase *v, size_t i, const std::vector<ValueBase*> &kids) {
+    if (v->v_type == V_PAIR) {
+        Pair *p = static_cast<Pair*>(v);
+        return i == 0 ? p->car.get() : (i == 1 ? p->cdr.get() : nullptr);
+    }
+    if (v->v_type == V_PVECTOR) {
+        PVector *vec = static_cast<PVector*>(v);
+        return i < vec->cnt ? pvecNth(vec, i).get() : nullptr;
+    }
+    return i < kids.size() ? kids[i] : nullptr;
+}
+
+// 第一遍：找出构成环的节点（值为 -1，打印时再编号）
+static void findCycles(ValueBase *root, std::unordered_map<ValueBase*, int> &labels) {
+    enum { ON_PATH = 1, DONE = 2 };
+    std::unordered_map<ValueBase*, char> color;
+    struct Frame {
+        ValueBase *node;
+        size_t next;
+        std::vector<ValueBase*> kids;
+    };
+    std::vector<Frame> stack;
+    ValueBase *enter = root;
+    while (true) {
+        if (enter != nullptr) {
+            color[enter] = ON_PATH;
+            stack.push_back(Frame{enter, 0, {}});
+            if (enter->v_type == V_HASHMAP) {
+                children(enter, stack.back().kids);
+            }
+            enter = nullptr;
+        }
+        if (stack.empty()) {
+            break;
+        }
+        Frame &top = stack.back();
+        ValueBase *kid = childAt(top.node, top.next++, top.kids);
+        if (kid == nullptr) {
+            color[top.node] = DONE;
+            stack.pop_back();
+            continue;
+        }
+        if (!isContainer(kid)) {
+            continue;
+        }
+        auto it = color.find(kid);
+        if (it == color.end()) {
+            enter = kid;
+        } else if (it->second == ON_PATH) {
+            labels[kid] = -1;
+        }
+    }
+}
+
+// 攒满一段再交给 ostream，减少虚调用
+struct PrintBuffer {
+    std::ostream &os;
+    std::string out;
+    PrintBuffer(std::ostream &o) : os(o) {}
+    ~PrintBuffer() { drain(); }
+    void text(const char *s) { out.append(s); check(); }
+    void integer(long long v) {
+        char digits[24];
+        out.append(digits, formatInt(v, digits));
+        check();
+    }
+    void check() { if (out.size() >= 8192) drain(); }
+    void drain() {
+        if (!out.empty()) {
+            os.write(out.data(), out.size());
+            out.clear();
+        }
+    }
+};
+
+// 环只能由原地修改产生；从未修改过时跳过第一遍
+void noteStructureMutation() {
+    Interpreter::current().structure_mutated = true;
+}
+
+void printValue(ValueBase *root, std::ostream &os) {
+    std::unordered_map<ValueBase*, int> labels;
+    if (isContainer(root) && Interpreter::current().structure_mutated) {
+        findCycles(root, labels);
+    }
+    int next_label = 0;
+    PrintBuffer pb(os);
+
+    enum Kind { PRINT, TAIL, TEXT };
+    struct Item {
+        Kind kind;
+        ValueBase *v;     // PRINT: 要打印的值；TAIL: 已打印 car 的序对
+        const char *text; // TEXT
+    };
+    std::vector<Item> work;
+    std::vector<ValueBase*> kids;
+    work.push_back(Item{PRINT, root, nullptr});
+    while (!work.empty()) {
+        Item item = work.back();
+        work.pop_back();
+        if (item.kind == TEXT) {
+            pb.text(item.text);
+            continue;
+        }
+        if (item.kind == TAIL) {
+            ValueBase *rest = static_cast<Pair*>(item.v)->cdr.get();
+            if (rest->v_type == V_NULL) {
+                pb.text(")");
+            } else if (rest->v_type == V_PAIR && labels.count(rest) == 0) {
+                pb.text(" ");
+                work.push_back(Item{TAIL, rest, nullptr});
+                work.push_back(Item{PRINT, static_cast<Pair*>(rest)->car.get(), nullptr});
+            } else { // 点对，或者尾部回到一个带标签的节点
+                pb.text(" . ");
+                work.push_back(Item{TEXT, nullptr, ")"});
+                work.push_back(Item{PRINT, rest, nullptr});
+            }
+            continue;
+        }
+        ValueBase *v = item.v;
+        switch (v->v_type) {
+            case V_INT:
+                pb.integer(static_cast<Integer*>(v)->n);
+                continue;
+            case V_RATIONAL: {
+                Rational *r = static_cast<Rational*>(v);
+                pb.integer(r->numerator);
+                if (r->denominator != 1) {
+                    pb.text("/");
+                    pb.integer(r->denominator);
+                }
+                continue;
+            }
+            case V_PAIR:
+            case V_HASHMAP:
+            case V_PVECTOR:
+                break;
+            default:
+                pb.drain();
+                v->show(os);
+                continue;
+        }
+        auto lab = labels.find(v);
+        if (lab != labels.end()) {
+            if (lab->second >= 0) { // 已经打印过：引用标签
+                pb.text("#");
+                pb.integer(lab->second);
+                pb.text("#");
+                continue;
+            }
+            lab->second = next_label++;
+            pb.text("#");
+            pb.integer(lab->second);
+            pb.text("=");
+        }
+        if (v->v_type == V_PAIR) {
+            pb.text("(");
+            work.push_back(Item{TAIL, v, nullptr});
+            work.push_back(Item{PRINT, static_cast<Pair*>(v)->car.get(), nullptr});
+            continue;
+        }
+        children(v, kids);
+        work.push_back(Item{TEXT, nullptr, ")"});
+        if (v->v_type == V_HASHMAP) {
+            pb.text("#hash(");
+            for (size_t i = kids.size() / 2; i > 0; i--) {
+                work.push_back(Item{TEXT, nullptr, ")"});
+                work.push_back(Item{PRINT, kids[2 * i - 1], nullptr});
+                work.push_back(Item{TEXT, nullptr, " . "});
+                work.push_back(Item{PRINT, kids[2 * i - 2], nullptr});
+                work.push_back(Item{TEXT, nullptr, i > 1 ? " (" : "("});
+            }
+        } else {
+            pb.text("#(");
+            for (size_t i = kids.size(); i > 0; i--) {
+                work.push_back(Item{PRINT, kids[i - 1], nullptr});
+                if (i > 1) work.push_back(Item{TEXT, nullptr, " "});
+            }
+        }
+    }
+}
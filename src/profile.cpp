@@ -0,0 +1,190 @@
+/**
+ * @file profile.cpp
+ * @brief SIGPROF sampling of the shadow stack and the profile reports
+ */
+
+#include "profile.hpp"
+#include "RE.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <signal.h>
+#include <sys/time.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+thread_local ShadowFrame *shadow_top __attribute__((tls_model("initial-exec"))) = nullptr;
+volatile bool profile_active = false;
+
+// 样本缓冲区：每个样本先写帧数，再从最内层起写各帧的名字
+static const size_t SAMPLE_SLOTS = size_t(1) << 22;
+static uintptr_t *samples = nullptr;
+static std::atomic<size_t> samples_used(0);
+static std::atomic<size_t> samples_dropped(0);
+
+static const std::string ANONYMOUS("lambda");
+static const std::string TRUNCATED("[truncated]");
+static const std::string TOP_LEVEL("[top level]");
+
+const std::string *profileName(const std::string &name) {
+    static std::mutex lock;
+    static auto *names = new std::unordered_set<std::string>; // 永不释放：指针一直有效
+    std::lock_guard<std::mutex> guard(lock);
+    return &*names->insert(name).first;
+}
+
+// 信号处理函数：只读影子栈、写预先分配好的缓冲区
+static void takeSample(int) {
+    if (!profile_active) {
+        return;
+    }
+    size_t depth = 0;
+    for (ShadowFrame *f = shadow_top; f != nullptr && depth <= PROFILE_MAX_DEPTH; f = f->caller) {
+        depth++;
+    }
+    size_t kept = std::min(depth, PROFILE_MAX_DEPTH);
+    size_t need = 1 + (depth > PROFILE_MAX_DEPTH ? kept + 1 : std::max<size_t>(kept, 1));
+    size_t start = samples_used.load(std::memory_order_relaxed);
+    do {
+        if (start + need > SAMPLE_SLOTS) {
+            samples_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!samples_used.compare_exchange_weak(start, start + need, std::memory_order_relaxed));
+    uintptr_t *out = samples + start;
+    *out++ = need - 1;
+    if (depth == 0) { // 不在任何过程中
+        *out = reinterpret_cast<uintptr_t>(&TOP_LEVEL);
+        return;
+    }
+    ShadowFrame *f = shadow_top;
+    for (size_t i = 0; i < kept; i++, f = f->caller) {
+        *out++ = reinterpret_cast<uintptr_t>(f->name != nullptr ? f->name : &ANONYMOUS);
+    }
+    if (depth > PROFILE_MAX_DEPTH) {
+        *out = reinterpret_cast<uintptr_t>(&TRUNCATED);
+    }
+}
+
+void profileStart() {
+    if (samples == nullptr) {
+        samples = new uintptr_t[SAMPLE_SLOTS]; // 不初始化：用到的页才分配
+    }
+    profileStop();
+    samples_used.store(0);
+    samples_dropped.store(0);
+    struct sigaction sa = {};
+    sa.sa_handler = takeSample;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    itimerval timer = {};
+    timer.it_interval.tv_usec = PROFILE_INTERVAL_US;
+    timer.it_value.tv_usec = PROFILE_INTERVAL_US;
+    profile_active = true;
+    if (sigaction(SIGPROF, &sa, nullptr) != 0 || setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        profile_active = false;
+        throw RuntimeError("Cannot start the profiler");
+    }
+}
+
+void profileStop() {
+    itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    profile_active = false;
+}
+
+// 依次访问每个样本的帧（最内层在前）
+template <typename F>
+static void forEachSample(F visit) {
+    size_t used = samples_used.load();
+    std::vector<const std::string*> frames;
+    for (size_t i = 0; i < used; ) {
+        size_t n = samples[i++];
+        frames.clear();
+        for (size_t k = 0; k < n; k++) {
+            frames.push_back(reinterpret_cast<const std::string*>(samples[i++]));
+        }
+        visit(frames);
+    }
+}
+
+void writeCollapsedStacks(std::ostream &os) {
+    std::map<std::string, size_t> stacks;
+    std::string line;
+    forEachSample([&](const std::vector<const std::string*> &frames) {
+        line.clear();
+        for (size_t k = frames.size(); k-- > 0; ) {
+            line += *frames[k];
+            if (k > 0) {
+                line += ';';
+            }
+        }
+        stacks[line]++;
+    });
+    for (auto &s : stacks) {
+        os << s.first << ' ' << s.second << '\n';
+    }
+}
+
+void writeProfileTable(std::ostream &os, size_t top) {
+    struct Row {
+        const std::string *name;
+        size_t self;
+        size_t total;
+    };
+    std::unordered_map<const std::string*, Row> rows;
+    std::unordered_set<const std::string*> seen;
+    size_t count = 0;
+    forEachSample([&](const std::vector<const std::string*> &frames) {
+        count++;
+        seen.clear();
+        for (size_t k = 0; k < frames.size(); k++) {
+            Row &r = rows.emplace(frames[k], Row{frames[k], 0, 0}).first->second;
+            if (k == 0) {
+                r.self++;
+            }
+            if (seen.insert(frames[k]).second) { // 递归调用只算一次
+                r.total++;
+            }
+        }
+    });
+    os << "profile: " << count << " samples, " << PROFILE_INTERVAL_US << " us of CPU time each";
+    if (samples_dropped.load() > 0) {
+        os << ", " << samples_dropped.load() << " dropped (buffer full)";
+    }
+    os << '\n';
+    if (count == 0) {
+        return;
+    }
+    std::vector<Row> table;
+    for (auto &r : rows) {
+        table.push_back(r.second);
+    }
+    std::ios::fmtflags flags = os.flags(); // os 可能是 Scheme 的输出端口，用完恢复格式
+    std::streamsize precision = os.precision();
+    auto print = [&](const char *title) {
+        os << title << '\n' << "   self%  total%     self    total  procedure\n";
+        for (size_t k = 0; k < table.size() && k < top; k++) {
+            os << std::fixed << std::setprecision(1)
+               << std::setw(8) << 100.0 * table[k].self / count
+               << std::setw(8) << 100.0 * table[k].total / count
+               << std::setw(9) << table[k].self << std::setw(9) << table[k].total
+               << "  " << *table[k].name << '\n';
+        }
+    };
+    std::sort(table.begin(), table.end(), [](const Row &a, const Row &b) {
+        return a.self != b.self ? a.self > b.self : *a.name < *b.name;
+    });
+    print("by self time:");
+    std::sort(table.begin(), table.end(), [](const Row &a, const Row &b) {
+        return a.total != b.total ? a.total > b.total : *a.name < *b.name;
+    });
+    print("by total time:");
+    os.flags(flags);
+    os.precision(precision);
+}
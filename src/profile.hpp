@@ -0,0 +1,108 @@
+#ifndef PROFILE
+#define PROFILE
+
+/**
+ * @file profile.hpp
+ * @brief Sampling profiler over a shadow stack of Scheme procedure names
+ *
+ * Closures take their name from the define or letrec that binds them
+ * (the first one; anonymous lambdas show as "lambda"). While the profiler
+ * runs, applyProcedure links a ShadowFrame per closure call into a list on
+ * the C++ stack, and a SIGPROF timer (ITIMER_PROF, every
+ * PROFILE_INTERVAL_US of CPU time) copies the list into a preallocated
+ * sample buffer. Primitives do not appear; time spent in them counts for
+ * the closure that called them.
+ *
+ * Reports: collapsed stacks ("outer;inner;leaf count" per line, the input
+ * of flamegraph.pl and speedscope) and a table of the procedures with the
+ * most self and total samples. code --profile FILE profiles a whole run;
+ * (profile-start) and (profile-stop [file]) profile a part of one.
+ *
+ * The profiler is process-wide. Each thread and each green thread has its
+ * own shadow stack; a sample taken on a thread whose stack is empty (top
+ * level code, primitives called from it, the event loop) counts as
+ * "[top level]".
+ */
+
+#include <ostream>
+#include <string>
+
+/**
+ * @brief CPU time between two samples
+ */
+const long PROFILE_INTERVAL_US = 1000;
+
+/**
+ * @brief Innermost frames kept per sample; deeper stacks are truncated
+ */
+const size_t PROFILE_MAX_DEPTH = 1024;
+
+/**
+ * @brief One closure call on the shadow stack
+ */
+struct ShadowFrame {
+    const std::string *name;    ///< nullptr for an anonymous procedure
+    ShadowFrame *caller;
+};
+
+/**
+ * @brief Innermost frame of the running (green) thread, nullptr if none
+ */
+extern thread_local ShadowFrame *shadow_top __attribute__((tls_model("initial-exec")));
+
+/**
+ * @brief True while samples are being taken
+ */
+extern volatile bool profile_active;
+
+/**
+ * @brief Pushes a frame for the scope of a closure call, if profiling
+ */
+struct ProfileScope {
+    ShadowFrame frame;
+    bool pushed;
+    explicit ProfileScope(const std::string *name) : pushed(profile_active) {
+        if (pushed) {
+            frame.name = name;
+            frame.caller = shadow_top;
+            __atomic_signal_fence(__ATOMIC_SEQ_CST); // 信号处理函数只会看到完整的帧
+            shadow_top = &frame;
+        }
+    }
+    ~ProfileScope() {
+        if (pushed) {
+            shadow_top = frame.caller;
+        }
+    }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+/**
+ * @brief Interned copy of a procedure name; the pointer stays valid for
+ *        the life of the process
+ */
+const std::string *profileName(const std::string &);
+
+/**
+ * @brief Discards earlier samples and starts sampling; throws RuntimeError
+ *        if the timer cannot be set up
+ */
+void profileStart();
+
+/**
+ * @brief Stops sampling; the samples stay available for the reports
+ */
+void profileStop();
+
+/**
+ * @brief Writes the samples as collapsed stacks
+ */
+void writeCollapsedStacks(std::ostream &);
+
+/**
+ * @brief Writes the top procedures by self and by total samples
+ */
+void writeProfileTable(std::ostream &, size_t top = 20);
+
+#endif // PROFILE
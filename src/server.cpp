@@ -0,0 +1,424 @@
+/**
+ * @file server.cpp
+ * @brief Unix domain socket evaluation server (see server.hpp)
+ */
+
+#include "server.hpp"
+#include "events.hpp"
+#include "green.hpp"
+#include "immortal.hpp"
+#include "RE.hpp"
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern const std::map<std::string, ExprType> primitives;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int sig) {
+    if (sig != SIGCHLD) stopping = 1;
+}
+
+// 请求超时：让求值中的下一次过程调用抛出 RuntimeError
+static void onAlarm(int) {
+    eval_interrupt = true;
+}
+
+bool writeFull(int fd, const void *p, size_t n) {
+    const char *s = static_cast<const char*>(p);
+    while (n > 0) {
+        ssize_t k = ::write(fd, s, n);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        s += k;
+        n -= static_cast<size_t>(k);
+    }
+    return true;
+}
+
+bool readFull(int fd, void *p, size_t n) {
+    char *s = static_cast<char*>(p);
+    while (n > 0) {
+        ssize_t k = ::read(fd, s, n);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (k == 0) return false;
+        s += k;
+        n -= static_cast<size_t>(k);
+    }
+    return true;
+}
+
+void putLength(unsigned char *out, size_t n) {
+    for (int i = 0; i < 4; i++) out[i] = static_cast<unsigned char>(n >> (8 * i));
+}
+
+size_t getLength(const unsigned char *in) {
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) n |= static_cast<size_t>(in[i]) << (8 * i);
+    return n;
+}
+
+/**
+ * @brief A connected client and the bytes of its unfinished request
+ */
+struct ServeClient {
+    int fd;
+    std::string pending;
+    std::string unsent; ///< Reply bytes the socket has not taken yet
+    pid_t job;          ///< Child answering its current request (fork mode), or 0
+    std::chrono::steady_clock::time_point deadline; ///< When the server kills job
+    volatile char *replying;    ///< Shared with the job: set once it starts its reply
+};
+
+/**
+ * @brief Server state shared by the serving loop and its helpers
+ */
+struct Server {
+    Interpreter &interp;
+    Assoc prelude;
+    int listener;
+    bool fork_jobs;
+    bool report;
+    double timeout;
+    unsigned long jobs;
+    Server(Interpreter &i) : interp(i), prelude(i.global_env), listener(-1),
+                             fork_jobs(false), report(false), timeout(0), jobs(0) {}
+};
+
+static void setAlarm(double seconds) {
+    itimerval timer = {};
+    timer.it_value.tv_sec = static_cast<time_t>(seconds);
+    timer.it_value.tv_usec = static_cast<suseconds_t>((seconds - timer.it_value.tv_sec) * 1e6);
+    setitimer(ITIMER_REAL, &timer, nullptr);
+}
+
+// 在叠加于 prelude 之上的环境中求值一个请求，返回整个回复帧
+static std::string answer(Server &server, const char *code, size_t n) {
+    Interpreter &interp = server.interp;
+    interp.global_env = server.prelude;
+    interp.out = OutputPortV(-1);
+    interp.current_out = interp.out;
+    if (server.timeout > 0) setAlarm(server.timeout);
+    unsigned char status = SERVE_OK;
+    try {
+        status = interp.evalBuffer(code, n, false) ? SERVE_OK : SERVE_EXIT;
+    } catch (const RuntimeError &) { // 表达式之外的错误（如事件循环）也不能带走整个服务
+        static_cast<OutputPort*>(interp.out.get()) -> write("RuntimeError\n", 13);
+    }
+    setAlarm(0);
+    if (eval_interrupt) { // 超时打断的请求留下的任务与事件不再运行
+        eval_interrupt = false;
+        delete interp.events;
+        interp.events = nullptr;
+        delete interp.green;
+        interp.green = nullptr;
+    }
+    interp.global_env = server.prelude; // 丢弃本次请求的定义
+    const std::string &text = interp.output();
+    unsigned char header[5];
+    putLength(header, text.size());
+    header[4] = status;
+    return std::string(reinterpret_cast<char*>(header), 5) + text;
+}
+
+// 尽量写出积压的回复，不阻塞；连接出错时返回 false
+static bool flushClient(ServeClient &client) {
+    size_t done = 0;
+    while (done < client.unsent.size()) {
+        ssize_t k = send(client.fd, client.unsent.data() + done, client.unsent.size() - done,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        done += static_cast<size_t>(k);
+    }
+    client.unsent.erase(0, done);
+    return true;
+}
+
+// 从 /proc/self 读取一项内存统计（kB），读不到时为 -1
+static long procKiB(const char *file, const char *key) {
+    std::ifstream in(file);
+    std::string line;
+    size_t n = std::strlen(key);
+    while (std::getline(in, line)) {
+        if (line.compare(0, n, key) == 0) return std::atol(line.c_str() + n);
+    }
+    return -1;
+}
+
+// 子进程：写时复制地继承预热好的堆，答完一个请求即退出
+static void runJob(Server &server, ServeClient &client, const char *code, size_t n,
+                   std::chrono::steady_clock::time_point forked) {
+    auto started = std::chrono::steady_clock::now();
+    std::string reply = answer(server, code, n);
+    *client.replying = 1; // 从此父进程不能再替它回复
+    bool ok = writeFull(client.fd, reply.data(), reply.size());
+    if (server.report) {
+        auto done = std::chrono::steady_clock::now();
+        char line[256];
+        int len = std::snprintf(line, sizeof(line),
+            "job %lu: startup %.1f us, run %.1f us, rss %ld kB, private dirty %ld kB\n",
+            server.jobs,
+            std::chrono::duration<double, std::micro>(started - forked).count(),
+            std::chrono::duration<double, std::micro>(done - started).count(),
+            procKiB("/proc/self/status", "VmRSS:"),
+            procKiB("/proc/self/smaps_rollup", "Private_Dirty:"));
+        writeFull(2, line, static_cast<size_t>(len));
+    }
+    _exit(ok ? 0 : 1); // 不运行析构函数，也不冲刷父进程留下的缓冲区
+}
+
+// 子进程已结束（或没能启动）：释放与它共享的标志页
+static void endJob(ServeClient &client) {
+    munmap(const_cast<char*>(client.replying), 1);
+    client.replying = nullptr;
+    client.job = 0;
+}
+
+// 子进程结束后：正常退出时它已回复；没开始回复就死掉时代它回复错误，
+// 回复写到一半时连接已不可用。连接应关闭时返回 false
+static bool reapJob(ServeClient &client, int status) {
+    bool replied = *client.replying != 0;
+    endJob(client);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return true;
+    if (replied) return false;
+    static const char text[] = "RuntimeError\n";
+    unsigned char header[5];
+    putLength(header, sizeof(text) - 1);
+    header[4] = SERVE_JOB_FAILED;
+    client.unsent = std::string(reinterpret_cast<char*>(header), 5) + text;
+    return flushClient(client);
+}
+
+// 处理缓冲区中所有完整的请求；连接出错或请求过长时返回 false。
+// 上一个回复还没写完时先不处理，等套接字可写
+static bool serveFrames(Server &server, ServeClient &client) {
+    size_t used = 0;
+    while (client.job == 0 && client.unsent.empty() && client.pending.size() - used >= 4) {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(client.pending.data() + used);
+        size_t len = getLength(p);
+        if (len > SERVE_MAX_REQUEST) return false;
+        if (client.pending.size() - used - 4 < len) break;
+        const char *code = client.pending.data() + used + 4;
+        if (server.fork_jobs) {
+            server.jobs++;
+            void *flag = mmap(nullptr, 1, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (flag == MAP_FAILED) return false;
+            client.replying = static_cast<volatile char*>(flag);
+            auto forked = std::chrono::steady_clock::now();
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(server.listener);
+                sigset_t none;
+                sigemptyset(&none);
+                sigprocmask(SIG_SETMASK, &none, nullptr);
+                signal(SIGINT, SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                runJob(server, client, code, len, forked);
+            }
+            if (pid < 0) {
+                endJob(client);
+                return false;
+            }
+            client.job = pid; // 子进程答完之前不再读这个连接
+            client.deadline = server.timeout > 0
+                ? forked + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<double>(server.timeout + SERVE_KILL_GRACE))
+                : std::chrono::steady_clock::time_point::max();
+        } else {
+            client.unsent = answer(server, code, len);
+            if (!flushClient(client)) return false;
+        }
+        used += 4 + len;
+    }
+    client.pending.erase(0, used);
+    return true;
+}
+
+int serveUnixSocket(Interpreter &interp, const std::string &path, bool fork_jobs, bool report,
+                    double timeout) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "serve: socket path too long: " << path << "\n";
+        return 1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        std::cerr << "serve: socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str()); // 上次运行留下的套接字文件
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 64) < 0) {
+        std::cerr << "serve: " << path << ": " << std::strerror(errno) << "\n";
+        close(listener);
+        return 1;
+    }
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal; // 不设 SA_RESTART，ppoll 会以 EINTR 返回
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGCHLD, &sa, nullptr);
+    sa.sa_handler = onAlarm;
+    sigaction(SIGALRM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    // SIGCHLD 只在 ppoll 等待期间放开，子进程结束不会在两次检查之间丢失
+    sigset_t blocked, waiting;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting);
+    sigdelset(&waiting, SIGCHLD);
+
+    // 进入服务前的环境与输出端口就是 prelude
+    static_cast<OutputPort*>(interp.out.get()) -> flush();
+    Value saved_out = interp.out;
+    Value saved_current = interp.current_out;
+    Server server(interp);
+    server.listener = listener;
+    server.fork_jobs = fork_jobs;
+    server.report = report;
+    server.timeout = timeout;
+    if (fork_jobs) {
+        // 预先建好所有原语过程值，再钉住整个 prelude，子进程只读它们
+        for (auto &name : primitives) {
+            try {
+                interp.lookup(name.first);
+            } catch (const RuntimeError &) {
+            }
+        }
+        server.prelude = interp.global_env;
+        size_t pinned = immortalize(interp);
+        server.prelude = interp.global_env;
+        if (report) std::cerr << "serve: " << pinned << " prelude pointers pinned\n";
+    }
+
+    std::vector<ServeClient> clients;
+    std::vector<pollfd> fds;
+    std::vector<size_t> polled; // fds[k + 1] 对应 clients[polled[k]]
+    char chunk[1 << 16];
+    while (!stopping) {
+        fds.clear();
+        polled.clear();
+        pollfd lp = {listener, POLLIN, 0};
+        fds.push_back(lp);
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (clients[i].job != 0) continue;
+            // 回复没写完的连接只等它可写，不再读新的请求
+            pollfd cp = {clients[i].fd, static_cast<short>(clients[i].unsent.empty() ? POLLIN : POLLOUT), 0};
+            fds.push_back(cp);
+            polled.push_back(i);
+        }
+        // 有 job 在运行时最多等到最早的那个期限
+        auto now = std::chrono::steady_clock::now();
+        auto next = std::chrono::steady_clock::time_point::max();
+        for (auto &c : clients) {
+            if (c.job != 0 && c.deadline < next) next = c.deadline;
+        }
+        timespec wait_for = {};
+        if (next > now) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(next - now).count();
+            wait_for.tv_sec = static_cast<time_t>(ns / 1000000000);
+            wait_for.tv_nsec = static_cast<long>(ns % 1000000000);
+        }
+        bool bounded = next != std::chrono::steady_clock::time_point::max();
+        int ready = ppoll(fds.data(), fds.size(), bounded ? &wait_for : nullptr, &waiting);
+        if (ready < 0 && errno != EINTR) break;
+        std::vector<bool> alive(clients.size(), true);
+        if (ready > 0) {
+            for (size_t k = 0; k < polled.size(); k++) {
+                ServeClient &c = clients[polled[k]];
+                if (!c.unsent.empty()) {
+                    if (fds[k + 1].revents & (POLLOUT | POLLHUP | POLLERR)) {
+                        alive[polled[k]] = flushClient(c) && serveFrames(server, c);
+                    }
+                    continue;
+                }
+                if (!(fds[k + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                ssize_t n = ::read(c.fd, chunk, sizeof(chunk));
+                if (n > 0) {
+                    c.pending.append(chunk, static_cast<size_t>(n));
+                    alive[polled[k]] = serveFrames(server, c);
+                } else if (n == 0 || errno != EINTR) {
+                    alive[polled[k]] = false;
+                }
+            }
+        }
+        // 超过期限的 job 直接杀掉，下面回收时代它回复 SERVE_JOB_FAILED
+        now = std::chrono::steady_clock::now();
+        for (auto &c : clients) {
+            if (c.job != 0 && c.deadline <= now) {
+                kill(c.job, SIGKILL);
+                c.deadline = std::chrono::steady_clock::time_point::max();
+            }
+        }
+        // 回收结束的子进程，继续处理它们连接上积压的请求
+        pid_t pid;
+        int status;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (size_t i = 0; i < clients.size(); i++) {
+                if (clients[i].job != pid) continue;
+                bool ok = reapJob(clients[i], status);
+                if (alive[i]) alive[i] = ok && serveFrames(server, clients[i]);
+            }
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (alive[i]) {
+                clients[kept++] = clients[i];
+            } else {
+                close(clients[i].fd);
+            }
+        }
+        clients.resize(kept);
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                ServeClient c;
+                c.fd = fd;
+                c.job = 0;
+                c.replying = nullptr;
+                clients.push_back(c);
+            }
+        }
+    }
+    for (auto &c : clients) close(c.fd);
+    close(listener);
+    unlink(path.c_str());
+    while (waitpid(-1, nullptr, 0) > 0) {
+    }
+    sigprocmask(SIG_UNBLOCK, &blocked, nullptr);
+    interp.global_env = server.prelude;
+    interp.out = saved_out;
+    interp.current_out = saved_current;
+    return 0;
+}
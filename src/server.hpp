@@ -0,0 +1,112 @@
+#ifndef SERVER
+#define SERVER
+
+/**
+ * @file server.hpp
+ * @brief Evaluation server on a Unix domain socket
+ *
+ * The server keeps one interpreter whose global environment (the prelude:
+ * -e expressions and the script given with --serve) is loaded once. Every
+ * request is evaluated in an environment layered on the prelude: its
+ * defines are dropped when the request ends, so requests do not see each
+ * other's definitions. (set! on a prelude variable and in-place changes to
+ * prelude data do persist, as they would in any shared environment.)
+ *
+ * With fork_jobs set (code --serve SOCKET --fork), the prelude is loaded,
+ * its primitive procedures created and its heap pinned (immortal.hpp) once;
+ * then each request is answered by a fork()ed child that inherits that heap
+ * copy-on-write and exits afterwards, so nothing a request does, including
+ * set! on the prelude, is seen by later requests.
+ *
+ * Protocol, in both directions over one stream connection, any number of
+ * requests per connection, one request evaluated at a time:
+ *   request:  u32 length, then length bytes of Scheme source
+ *   response: u32 length, u8 status, then length bytes of output
+ * Lengths are little-endian. The output is what the REPL would print for
+ * the request's forms, including display output and "RuntimeError" lines.
+ *
+ * One request cannot stall or crash the others. Reading and evaluating a
+ * request are limited in time (timeout seconds; every procedure call and
+ * every datum read after that raises RuntimeError) and in nesting and
+ * recursion depth (see stack_limit in value.hpp). A form that does not
+ * read (an unfinished list or string, a stray ")") prints RuntimeError and
+ * ends the request; the forms before it have run.
+ * Replies are written without blocking: while a client does not read its
+ * reply, the server keeps the rest and answers nothing more for that
+ * client, but serves the others.
+ */
+
+#include "interpreter.hpp"
+#include <string>
+
+/**
+ * @brief Response status: every form ran (some may have printed RuntimeError)
+ */
+const unsigned char SERVE_OK = 0;
+
+/**
+ * @brief Response status: the request called (exit); the server keeps running
+ */
+const unsigned char SERVE_EXIT = 1;
+
+/**
+ * @brief Response status (fork mode): the job answering the request died
+ *        (killed by a signal, or exited with an error) or was killed for
+ *        running past its time limit before it replied; the output is
+ *        "RuntimeError"
+ *
+ * A job that dies after it started writing its reply leaves the stream in
+ * an unknown state, so the server closes that connection instead.
+ */
+const unsigned char SERVE_JOB_FAILED = 2;
+
+/**
+ * @brief Fork mode: the server kills a job (SIGKILL) this many seconds
+ *        after its request's time limit, if the job has not ended by then
+ *
+ * The job's own timer interrupts its evaluation at the time limit; the
+ * grace lets it still send the partial output. A job that is stuck where
+ * the timer cannot reach it (stopped, blocked in a system call, writing to
+ * a client that does not read) is killed instead.
+ */
+const double SERVE_KILL_GRACE = 1;
+
+/**
+ * @brief Largest request accepted; a longer one closes the connection
+ */
+const size_t SERVE_MAX_REQUEST = size_t(1) << 26;
+
+/**
+ * @brief Default time limit of one request, in seconds
+ */
+const double SERVE_TIMEOUT = 10;
+
+/**
+ * @brief Serves requests on a socket at path until SIGINT or SIGTERM;
+ *        returns a process exit status
+ *
+ * With fork_jobs, each request runs in a child process; report then prints
+ * one line per job on stderr with its startup time, run time, RSS and
+ * private dirty memory (the pages it did not share with the server).
+ * timeout limits the evaluation of each request (0: no limit).
+ */
+int serveUnixSocket(Interpreter &, const std::string &path, bool fork_jobs, bool report,
+                    double timeout = SERVE_TIMEOUT);
+
+/**
+ * @brief Writes all n bytes to fd, retrying on EINTR; false on error
+ */
+bool writeFull(int fd, const void *, size_t n);
+
+/**
+ * @brief Reads exactly n bytes from fd; false on error or end of stream
+ */
+bool readFull(int fd, void *, size_t n);
+
+/**
+ * @brief Encodes / decodes a 4-byte little-endian frame length
+ */
+void putLength(unsigned char *out, size_t n);
+size_t getLength(const unsigned char *in);
+
+#endif // SERVER
@@ -0,0 +1,148 @@
+/**
+ * @file stats.cpp
+ * @brief Allocation counters, (runtime-stats) and the --stats report
+ */
+
+#include "stats.hpp"
+#include <climits>
+#include <iomanip>
+#include <sys/resource.h>
+
+AllocStats alloc_stats[STAT_KINDS];
+unsigned long long live_bytes = 0;
+unsigned long long peak_live_bytes = 0;
+
+// 与 ValueType 的顺序一致，最后是环境结点
+const size_t stat_size[STAT_KINDS] = {
+    sizeof(Integer), sizeof(Rational), sizeof(Boolean), sizeof(Symbol), sizeof(Null),
+    sizeof(String), sizeof(Pair), sizeof(Procedure), sizeof(Void), sizeof(Terminate),
+    sizeof(HashMap), sizeof(PVector), sizeof(OutputPort), sizeof(InputPort), sizeof(EofObject),
+    sizeof(Future), sizeof(Channel), sizeof(AssocList)
+};
+
+static const char *const stat_names[STAT_KINDS] = {
+    "integer", "rational", "boolean", "symbol", "null",
+    "string", "pair", "procedure", "void", "terminate",
+    "hashmap", "pvector", "output-port", "input-port", "eof",
+    "future", "channel", "environment"
+};
+
+// 峰值只会变大：比当前记录大时才写
+static void raisePeak(unsigned long long &peak, unsigned long long now) {
+    unsigned long long old = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+    while (now > old && !__atomic_compare_exchange_n(&peak, &old, now, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void statAllocShared(int kind) {
+    AllocStats &s = alloc_stats[kind];
+    __atomic_fetch_add(&s.allocated, 1, __ATOMIC_RELAXED);
+    raisePeak(s.peak, __atomic_add_fetch(&s.live, 1, __ATOMIC_RELAXED));
+    raisePeak(peak_live_bytes, __atomic_add_fetch(&live_bytes, stat_size[kind], __ATOMIC_RELAXED));
+}
+
+void statFreeShared(int kind) {
+    __atomic_fetch_sub(&alloc_stats[kind].live, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&live_bytes, stat_size[kind], __ATOMIC_RELAXED);
+}
+
+static unsigned long long load(const unsigned long long &counter) {
+    return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+}
+
+StatTotals statTotals() {
+    StatTotals t = {0, 0};
+    for (int k = 0; k < STAT_KINDS; k++) {
+        unsigned long long n = load(alloc_stats[k].allocated);
+        t.allocated += n;
+        t.bytes += n * stat_size[k];
+    }
+    return t;
+}
+
+#ifdef SCHEME_STATS
+// Scheme 的整数是 int：更大的计数截到 INT_MAX
+static Value countV(unsigned long long n) {
+    return IntegerV(n > static_cast<unsigned long long>(INT_MAX) ? INT_MAX : static_cast<int>(n));
+}
+
+static Value entryV(const char *key, unsigned long long n) {
+    return PairV(SymbolV(key), countV(n));
+}
+#endif
+
+Value runtimeStats() {
+#ifdef SCHEME_STATS
+    // 先取快照：构造结果本身也要分配
+    AllocStats now[STAT_KINDS];
+    unsigned long long live = 0;
+    for (int k = 0; k < STAT_KINDS; k++) {
+        now[k].allocated = load(alloc_stats[k].allocated);
+        now[k].live = load(alloc_stats[k].live);
+        now[k].peak = load(alloc_stats[k].peak);
+        live += now[k].live;
+    }
+    unsigned long long live_total = load(live_bytes);
+    unsigned long long peak = load(peak_live_bytes);
+    StatTotals totals = statTotals();
+    Value result = NullV();
+    for (int k = STAT_KINDS - 1; k >= 0; k--) {
+        Value fields = NullV();
+        fields = PairV(entryV("peak-live", now[k].peak), fields);
+        fields = PairV(entryV("live", now[k].live), fields);
+        fields = PairV(entryV("bytes", now[k].allocated * stat_size[k]), fields);
+        fields = PairV(entryV("allocations", now[k].allocated), fields);
+        result = PairV(PairV(SymbolV(stat_names[k]), fields), result);
+    }
+    result = PairV(entryV("peak-live-bytes", peak), result);
+    result = PairV(entryV("live-bytes", live_total), result);
+    result = PairV(entryV("live", live), result);
+    result = PairV(entryV("bytes", totals.bytes), result);
+    result = PairV(entryV("allocations", totals.allocated), result);
+    return result;
+#else
+    return BooleanV(false);
+#endif
+}
+
+bool statsEnabled() {
+#ifdef SCHEME_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+static double seconds(const timeval &tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void writeRuntimeStats(std::ostream &os, double wall_seconds) {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3)
+       << "stats: wall " << wall_seconds << " s, user " << seconds(usage.ru_utime)
+       << " s, sys " << seconds(usage.ru_stime) << " s, max rss " << usage.ru_maxrss << " KiB\n";
+#ifdef SCHEME_STATS
+    StatTotals totals = statTotals();
+    os << "stats: " << totals.allocated << " allocations, " << totals.bytes << " bytes, "
+       << load(live_bytes) << " bytes live, " << load(peak_live_bytes) << " bytes live at peak\n"
+       << "  kind          allocations          bytes       live  peak-live\n";
+    for (int k = 0; k < STAT_KINDS; k++) {
+        unsigned long long n = load(alloc_stats[k].allocated);
+        if (n == 0) {
+            continue;
+        }
+        os << "  " << std::left << std::setw(12) << stat_names[k] << std::right
+           << std::setw(13) << n << std::setw(15) << n * stat_size[k]
+           << std::setw(11) << load(alloc_stats[k].live)
+           << std::setw(11) << load(alloc_stats[k].peak) << '\n';
+    }
+#else
+    os << "stats: allocation counters were compiled out (SCHEME_STATS)\n";
+#endif
+    os.flags(flags);
+    os.precision(precision);
+}
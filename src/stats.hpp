@@ -0,0 +1,85 @@
+#ifndef STATS
+#define STATS
+
+/**
+ * @file stats.hpp
+ * @brief Allocation counters behind (runtime-stats), (time expr) and --stats
+ *
+ * Built with SCHEME_STATS (the CMake option of that name, off by default),
+ * the ValueBase constructor and destructor count every value by type, and
+ * the AssocList ones every environment frame made by extend(): how many
+ * were allocated, their bytes (sizeof the object; string buffers,
+ * collection nodes and shared_ptr control blocks are not included), how
+ * many are live and the most that were live at once. Memory goes back as
+ * soon as the last reference does, so there is no collector to report on;
+ * the peak of live bytes is the peak heap of values.
+ *
+ * The counters are process-wide: plain increments while the process has a
+ * single thread, relaxed atomics once it has more, the same switch
+ * shared_ptr makes for its reference counts. The hooks live in value.cpp
+ * and the macro only matters to the library's own sources, so headers (and
+ * embedders) look the same either way. Without SCHEME_STATS the hooks are
+ * empty, (runtime-stats) returns #f, time reports times only and --stats
+ * says the counters were compiled out.
+ *
+ * With the counters, (runtime-stats) returns an association list:
+ *   ((allocations . n) (bytes . n) (live . n) (live-bytes . n)
+ *    (peak-live-bytes . n) (pair (allocations . n) (bytes . n) (live . n)
+ *    (peak-live . n)) (integer ...) ... (environment ...))
+ * (time expr) evaluates expr, writes its wall time, CPU time (of the whole
+ * process) and allocations to the current output port and returns its value.
+ */
+
+#include "Def.hpp"
+#include "value.hpp"
+#include <cstddef>
+#include <ostream>
+
+const int STAT_ENV = V_CHANNEL + 1;     ///< Kind counting environment frames
+const int STAT_KINDS = STAT_ENV + 1;
+
+/**
+ * @brief Counters of one kind of object
+ */
+struct AllocStats {
+    unsigned long long allocated;
+    unsigned long long live;
+    unsigned long long peak;            ///< Most live at once
+};
+
+extern AllocStats alloc_stats[STAT_KINDS];
+extern unsigned long long live_bytes;
+extern unsigned long long peak_live_bytes;
+extern const size_t stat_size[STAT_KINDS];  ///< Bytes of one object of each kind
+
+void statAllocShared(int kind);
+void statFreeShared(int kind);
+
+/**
+ * @brief Whether the library was built with SCHEME_STATS; without it
+ *        statTotals() stays zero
+ */
+bool statsEnabled();
+
+/**
+ * @brief Allocations and bytes allocated so far, over all kinds
+ */
+struct StatTotals {
+    unsigned long long allocated;
+    unsigned long long bytes;
+};
+StatTotals statTotals();
+
+/**
+ * @brief The counters as the association list described above, #f when
+ *        they were compiled out
+ */
+Value runtimeStats();
+
+/**
+ * @brief Report for --stats: times, maximum resident set size and the
+ *        counters of every kind that was allocated
+ */
+void writeRuntimeStats(std::ostream &, double wall_seconds);
+
+#endif // STATS
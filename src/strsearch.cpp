@@ -0,0 +1,211 @@
+/**
+ * @file strsearch.cpp
+ * @brief Scalar, SSE2 and AVX2 byte kernels with runtime dispatch
+ *
+ * Substring search compares a block of candidate positions at once against
+ * the first and the last byte of the needle and only runs memcmp on the
+ * positions where both match, which skips almost all of a typical haystack.
+ */
+
+#include "strsearch.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STRSEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// Scalar
+// ============================================================================
+
+static size_t findByteScalar(const char *p, size_t n, char c) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == c) return i;
+    }
+    return std::string::npos;
+}
+
+// 从 from 开始逐个位置比较，SIMD 版本用它处理尾部
+static size_t findBytesTail(const char *hay, size_t n, const char *needle, size_t m, size_t from) {
+    for (size_t i = from; i + m <= n; i++) {
+        if (hay[i] == needle[0] && memcmp(hay + i + 1, needle + 1, m - 1) == 0) return i;
+    }
+    return std::string::npos;
+}
+
+static size_t findBytesScalar(const char *hay, size_t n, const char *needle, size_t m) {
+    return findBytesTail(hay, n, needle, m, 0);
+}
+
+static bool bytesEqualScalar(const char *a, const char *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+#ifdef STRSEARCH_X86
+
+// ============================================================================
+// SSE2 (always available on x86-64)
+// ============================================================================
+
+__attribute__((target("sse2")))
+static size_t findByteSSE2(const char *p, size_t n, char c) {
+    __m128i key = _mm_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, key));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    size_t rest = findByteScalar(p + i, n - i, c);
+    return rest == std::string::npos ? rest : i + rest;
+}
+
+__attribute__((target("sse2")))
+static size_t findBytesSSE2(const char *hay, size_t n, const char *needle, size_t m) {
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b0, first),
+                                                        _mm_cmpeq_epi8(b1, last)));
+        while (mask != 0) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findBytesTail(hay, n, needle, m, i);
+}
+
+__attribute__((target("sse2")))
+static bool bytesEqualSSE2(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return false;
+    }
+    return bytesEqualScalar(a + i, b + i, n - i);
+}
+
+// ============================================================================
+// AVX2
+// ============================================================================
+
+__attribute__((target("avx2")))
+static size_t findByteAVX2(const char *p, size_t n, char c) {
+    __m256i key = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, key));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    size_t rest = findByteSSE2(p + i, n - i, c);
+    return rest == std::string::npos ? rest : i + rest;
+}
+
+__attribute__((target("avx2")))
+static size_t findBytesAVX2(const char *hay, size_t n, const char *needle, size_t m) {
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + m - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(b0, first),
+                                                              _mm256_cmpeq_epi8(b1, last)));
+        while (mask != 0) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findBytesTail(hay, n, needle, m, i);
+}
+
+__attribute__((target("avx2")))
+static bool bytesEqualAVX2(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y))) != 0xFFFFFFFFu) {
+            return false;
+        }
+    }
+    return bytesEqualSSE2(a + i, b + i, n - i);
+}
+
+#endif // STRSEARCH_X86
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+struct StringKernels {
+    const char *name;
+    size_t (*find_byte)(const char *, size_t, char);
+    size_t (*find_bytes)(const char *, size_t, const char *, size_t);
+    bool (*bytes_equal)(const char *, const char *, size_t);
+};
+
+static const StringKernels scalar_kernels = {"scalar", findByteScalar, findBytesScalar, bytesEqualScalar};
+#ifdef STRSEARCH_X86
+static const StringKernels sse2_kernels = {"sse2", findByteSSE2, findBytesSSE2, bytesEqualSSE2};
+static const StringKernels avx2_kernels = {"avx2", findByteAVX2, findBytesAVX2, bytesEqualAVX2};
+#endif
+
+static const StringKernels *kernelsByName(const std::string &name) {
+#ifdef STRSEARCH_X86
+    __builtin_cpu_init();
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) return &avx2_kernels;
+    if (name == "sse2" && __builtin_cpu_supports("sse2")) return &sse2_kernels;
+#endif
+    if (name == "scalar") return &scalar_kernels;
+    return nullptr;
+}
+
+static const StringKernels *detectKernels() {
+    const StringKernels *k = kernelsByName("avx2");
+    if (k == nullptr) k = kernelsByName("sse2");
+    if (k == nullptr) k = &scalar_kernels;
+    return k;
+}
+
+static const StringKernels *&activeKernels() {
+    static const StringKernels *active = detectKernels(); // 首次使用时检测一次
+    return active;
+}
+
+size_t findByte(const char *p, size_t n, char c) {
+    return activeKernels()->find_byte(p, n, c);
+}
+
+size_t findBytes(const char *hay, size_t n, const char *needle, size_t m) {
+    if (m == 0) return 0;
+    if (m > n) return std::string::npos;
+    if (m == 1) return activeKernels()->find_byte(hay, n, needle[0]);
+    return activeKernels()->find_bytes(hay, n, needle, m);
+}
+
+bool bytesEqual(const char *a, const char *b, size_t n) {
+    return activeKernels()->bytes_equal(a, b, n);
+}
+
+const char *stringKernelName() {
+    return activeKernels()->name;
+}
+
+bool selectStringKernels(const std::string &name) {
+    const StringKernels *k = kernelsByName(name);
+    if (k == nullptr) return false;
+    activeKernels() = k;
+    return true;
+}
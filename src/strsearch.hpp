@@ -0,0 +1,43 @@
+#ifndef STRSEARCH
+#define STRSEARCH
+
+/**
+ * @file strsearch.hpp
+ * @brief Byte search and comparison kernels used by the string primitives
+ *
+ * Each operation has a scalar, an SSE2 and an AVX2 implementation; the best
+ * one the CPU supports is picked on first use. The kernels work on plain
+ * contiguous bytes (String::data()) and do not depend on the value types.
+ */
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Index of the first c in [p, p + n), or std::string::npos
+ */
+size_t findByte(const char *p, size_t n, char c);
+
+/**
+ * @brief Index of the first occurrence of needle[0, m) in hay[0, n),
+ *        or std::string::npos
+ */
+size_t findBytes(const char *hay, size_t n, const char *needle, size_t m);
+
+/**
+ * @brief True if the n bytes at a and b are equal
+ */
+bool bytesEqual(const char *a, const char *b, size_t n);
+
+/**
+ * @brief Name of the active kernel set: "avx2", "sse2" or "scalar"
+ */
+const char *stringKernelName();
+
+/**
+ * @brief Forces a kernel set by name (for benchmarks); returns false and
+ *        keeps the current one if the CPU does not support it
+ */
+bool selectStringKernels(const std::string &);
+
+#endif // STRSEARCH
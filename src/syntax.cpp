@@ -1,5 +1,9 @@
 #include "syntax.hpp"
+#include "value.hpp"
+#include "RE.hpp"
+#include <cctype>
 #include <cstring>
+#include <memory>
 #include <vector>
 
 Syntax::Syntax(SyntaxBase *stx) : ptr(stx) {}
@@ -130,12 +134,52 @@ Syntax createIdentifierSyntax(const std::string &s) {
   return Syntax(new SymbolSyntax(s));
 }
 
+// 记号的结束字符，readItem 与 readDatum 共用
+static bool isDelimiter(int c) {
+  return c == '(' || c == ')' || c == '[' || c == ']' || c == ';' || isspace(c) || c == EOF;
+}
+
+// 字符串中反斜杠后的转义
+static char unescape(char next) {
+  switch (next) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    default: return next;
+  }
+}
+
+static int hexDigit(int c) {
+  return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+// \x 之后的十六进制字符码，以 ; 结束（write 对控制字符的写法）；没有数字时就是字母 x
+static char unescapeHex(std::istream &is) {
+  if (!isxdigit(is.peek()))
+    return 'x';
+  int v = 0;
+  while (isxdigit(is.peek()))
+    v = v * 16 + hexDigit(is.get());
+  if (is.peek() == ';')
+    is.get();
+  return static_cast<char>(v);
+}
+
 // no leading space
 Syntax readItem(std::istream &is) {
+  char here;
+  if (&here < stack_limit || eval_interrupt) // 嵌套太深，或被超时打断（同 applyProcedure）
+    throw RuntimeError(eval_interrupt ? "Reading interrupted" : "Nesting too deep");
+  if (is.peek() == EOF)
+    throw RuntimeError("Unexpected end of input");
   if (is.peek() == '(' || is.peek() == '[') {
     is.get();
     return readList(is);
   }
+  if (is.peek() == ')' || is.peek() == ']') {
+    is.get(); // 消费掉，调用方可以从下一个字符接着读
+    throw RuntimeError("Unexpected )");
+  }
   if (is.peek() == '\'')
   {
     is.get();
@@ -158,21 +202,14 @@ Syntax readItem(std::istream &is) {
       if (c == '\\') {
         // 处理转义字符
         char next = is.get();
-        switch (next) {
-          case 'n': str.push_back('\n'); break;
-          case 't': str.push_back('\t'); break;
-          case 'r': str.push_back('\r'); break;
-          case '\\': str.push_back('\\'); break;
-          case '"': str.push_back('"'); break;
-          default: str.push_back(next); break;
-        }
+        str.push_back(next == 'x' ? unescapeHex(is) : unescape(next));
       } else {
         str.push_back(c);
       }
     }
-    if (is.peek() == '"') {
-      is.get(); // 消费结束的双引号
-    }
+    if (is.peek() == EOF)
+      throw RuntimeError("Unterminated string");
+    is.get(); // 消费结束的双引号
     return Syntax(new StringSyntax(str));
   }
   
@@ -180,11 +217,7 @@ Syntax readItem(std::istream &is) {
   std::string s;
   do {
     int c = is.peek();
-    if (c == '(' || c == ')' ||
-        c == '[' || c == ']' || 
-        c == ';' ||  // 添加分号作为分隔符
-        isspace(c) ||
-        c == EOF)
+    if (isDelimiter(c))
       break;
     is.get();
     s.push_back(c);
@@ -207,18 +240,141 @@ Syntax readItem(std::istream &is) {
 }
 
 Syntax readList(std::istream &is) {
-    List *stx = new List();
-    while (readSpace(is).peek() != ')' && readSpace(is).peek() != ')')
+    std::unique_ptr<List> stx(new List());
+    while (readSpace(is).peek() != ')' && is.peek() != ']') {
+        if (is.peek() == EOF)
+            throw RuntimeError("Unexpected end of input in list");
         stx->stxs.push_back(readItem(is));
-    is.get(); // ')'
-    return Syntax(stx);
+    }
+    is.get(); // ')' 或 ']'
+    return Syntax(stx.release());
 }
 
 Syntax readSyntax(std::istream &is) {
   return readItem(readSpace(is));
 }
 
+MemoryStreamBuf::MemoryStreamBuf(const char *p, size_t n) {
+  char *b = const_cast<char*>(p); // 只读：不提供 put area，也不覆盖 pbackfail
+  setg(b, b, b + n);
+}
+
 std::istream &operator>>(std::istream &is, Syntax &stx) {
   stx = readSyntax(is);
   return is;
 }
+
+// ============================================================================
+// Datum reader: same lexical rules as readItem, but works on a byte range in
+// place and builds runtime values directly (used by read on input ports)
+// ============================================================================
+
+static void skipSpace(const char *p, size_t n, size_t &pos) {
+  while (pos < n) {
+    if (isspace(static_cast<unsigned char>(p[pos]))) {
+      pos++;
+    } else if (p[pos] == ';') {
+      while (pos < n && p[pos] != '\n') pos++;
+    } else {
+      break;
+    }
+  }
+}
+
+static Value readDatumItem(const char *p, size_t n, size_t &pos);
+
+static Value readDatumList(const char *p, size_t n, size_t &pos) {
+  Value head = NullV();
+  Pair *last = nullptr;
+  while (true) {
+    skipSpace(p, n, pos);
+    if (pos >= n) {
+      throw RuntimeError("read: unexpected end of input in list");
+    }
+    if (p[pos] == ')' || p[pos] == ']') {
+      pos++;
+      return head;
+    }
+    // 单独的 "." 表示点对的尾部，与 Quote::eval 的处理一致
+    if (p[pos] == '.' && last != nullptr && (pos + 1 >= n || isDelimiter(static_cast<unsigned char>(p[pos + 1])))) {
+      pos++;
+      last->cdr = readDatumItem(p, n, pos);
+      skipSpace(p, n, pos);
+      if (pos >= n || (p[pos] != ')' && p[pos] != ']')) {
+        throw RuntimeError("read: bad dotted list");
+      }
+      pos++;
+      return head;
+    }
+    Value cell = PairV(readDatumItem(p, n, pos), NullV());
+    if (last == nullptr) {
+      head = cell;
+    } else {
+      last->cdr = cell;
+    }
+    last = static_cast<Pair*>(cell.get());
+  }
+}
+
+static Value readDatumItem(const char *p, size_t n, size_t &pos) {
+  skipSpace(p, n, pos);
+  if (pos >= n) {
+    throw RuntimeError("read: unexpected end of input");
+  }
+  char c = p[pos];
+  if (c == '(' || c == '[') {
+    pos++;
+    return readDatumList(p, n, pos);
+  }
+  if (c == ')' || c == ']') {
+    throw RuntimeError("read: unexpected )");
+  }
+  if (c == '\'') {
+    pos++;
+    Value quoted = readDatumItem(p, n, pos);
+    return PairV(SymbolV("quote"), PairV(quoted, NullV()));
+  }
+  if (c == '"') {
+    pos++;
+    std::string str;
+    while (pos < n && p[pos] != '"') {
+      if (p[pos] == '\\' && pos + 1 < n && p[pos + 1] == 'x' && pos + 2 < n &&
+          isxdigit(static_cast<unsigned char>(p[pos + 2]))) {
+        int v = 0;
+        for (pos += 2; pos < n && isxdigit(static_cast<unsigned char>(p[pos])); pos++)
+          v = v * 16 + hexDigit(static_cast<unsigned char>(p[pos]));
+        if (pos < n && p[pos] == ';') pos++;
+        str.push_back(static_cast<char>(v));
+      } else if (p[pos] == '\\' && pos + 1 < n) {
+        str.push_back(unescape(p[pos + 1]));
+        pos += 2;
+      } else {
+        str.push_back(p[pos++]);
+      }
+    }
+    if (pos < n) pos++; // 结束的双引号
+    return StringV(str);
+  }
+  size_t start = pos;
+  while (pos < n && !isDelimiter(static_cast<unsigned char>(p[pos]))) pos++;
+  std::string s(p + start, pos - start);
+  int numerator, denominator;
+  if (tryParseRational(s, numerator, denominator)) {
+    return RationalV(numerator, denominator);
+  }
+  int number_value;
+  if (tryParseNumber(s, number_value)) {
+    return IntegerV(number_value);
+  }
+  if (s == "#t") return BooleanV(true);
+  if (s == "#f") return BooleanV(false);
+  return SymbolV(s);
+}
+
+Value readDatum(const char *p, size_t n, size_t &pos) {
+  skipSpace(p, n, pos);
+  if (pos >= n) {
+    return EofV();
+  }
+  return readDatumItem(p, n, pos);
+}
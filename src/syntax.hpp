@@ -4,6 +4,7 @@
 #include <cstring>
 #include <memory>
 #include <vector>
+#include <streambuf>
 #include "Def.hpp"
 
 struct SyntaxBase {
@@ -70,6 +71,24 @@ struct List : SyntaxBase {
 };
 
 Syntax readSyntax(std::istream &);
+std::istream &readSpace(std::istream &);
+bool tryParseNumber(const std::string &, int &);
+bool tryParseRational(const std::string &, int &, int &);
+
+/**
+ * @brief Reads one datum from bytes [pos, n) of p as a runtime value, with
+ *        the same lexical rules as readSyntax; advances pos past it and
+ *        returns the eof object if only whitespace and comments remain
+ */
+Value readDatum(const char *p, size_t n, size_t &pos);
+
+/**
+ * @brief Read-only streambuf over a byte range, so readSyntax can run on a
+ *        whole file image without copying it
+ */
+struct MemoryStreamBuf : std::streambuf {
+    MemoryStreamBuf(const char *, size_t);
+};
 
 std::istream &operator>>(std::istream &, Syntax);
 #endif
\ No newline at end of file
@@ -7,19 +7,61 @@
  */
 
 #include "value.hpp"
+#include "persistent.hpp"
+#include "strsearch.hpp"
+#include "RE.hpp"
+#include "interpreter.hpp"
+#include "parallel.hpp"
+#include "stats.hpp"
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/single_threaded.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // ============================================================================
 // Base ValueBase Implementation
 // ============================================================================
 
-ValueBase::ValueBase(ValueType vt) : v_type(vt) {}
+// 计数钩子（stats.hpp）；SCHEME_STATS 只在库自己的源文件里定义，头文件不受影响
+#ifdef SCHEME_STATS
+static inline void statAlloc(int kind) {
+    if (!__libc_single_threaded) {
+        statAllocShared(kind);
+        return;
+    }
+    AllocStats &s = alloc_stats[kind];
+    s.allocated++;
+    if (++s.live > s.peak) s.peak = s.live;
+    live_bytes += stat_size[kind];
+    if (live_bytes > peak_live_bytes) peak_live_bytes = live_bytes;
+}
+
+static inline void statFree(int kind) {
+    if (!__libc_single_threaded) {
+        statFreeShared(kind);
+        return;
+    }
+    alloc_stats[kind].live--;
+    live_bytes -= stat_size[kind];
+}
+#else
+static inline void statAlloc(int) {}
+static inline void statFree(int) {}
+#endif
+
+ValueBase::ValueBase(ValueType vt) : v_type(vt), owner(task_owner) {
+    statAlloc(vt);
+}
 
-void ValueBase::showCdr(std::ostream &os) {
-    os << " . ";
-    show(os);
-    os << ')';
+ValueBase::~ValueBase() {
+    statFree(v_type);
 }
 
+
 // ============================================================================
 // Value Smart Pointer Implementation
 // ============================================================================
@@ -47,7 +89,13 @@ void Value::show(std::ostream &os) {
 // ============================================================================
 
 AssocList::AssocList(const std::string &x, const Value &v, Assoc &next)
-    : x(x), v(v), next(next) {}
+    : x(x), v(v), next(next), owner(task_owner) {
+    statAlloc(STAT_ENV);
+}
+
+AssocList::~AssocList() {
+    statFree(STAT_ENV);
+}
 
 Assoc::Assoc(AssocList *x) : ptr(x) {}
 
@@ -71,8 +119,10 @@ Assoc extend(const std::string &x, const Value &v, Assoc &lst) {
     return Assoc(new AssocList(x, v, lst));
 }
 
+// 沿链查找时只用裸指针：lst 保证整条链存活，不必逐结点增减引用计数
+// （多线程下计数是原子操作，而且全局环境的结点被所有线程共享）
 void modify(const std::string &x, const Value &v, Assoc &lst) {
-    for (auto i = lst; i.get() != nullptr; i = i->next) {
+    for (AssocList *i = lst.get(); i != nullptr; i = i->next.get()) {
         if (x == i->x) {
             i->v = v;
             return;
@@ -81,7 +131,7 @@ void modify(const std::string &x, const Value &v, Assoc &lst) {
 }
 
 Value find(const std::string &x, Assoc &l) {
-    for (auto i = l; i.get() != nullptr; i = i->next) {
+    for (AssocList *i = l.get(); i != nullptr; i = i->next.get()) {
         if (x == i->x) {
             return i->v;
         }
@@ -108,7 +158,8 @@ Value VoidV() {
 Integer::Integer(int n) : ValueBase(V_INT), n(n) {}
 
 void Integer::show(std::ostream &os) {
-    os << n;
+    char digits[24];
+    os.write(digits, formatInt(n, digits));
 }
 
 Value IntegerV(int n) {
@@ -146,11 +197,7 @@ Rational::Rational(int num, int den) : ValueBase(V_RATIONAL) {
 }
 
 void Rational::show(std::ostream &os) {
-    if (denominator == 1) {
-        os << numerator;
-    } else {
-        os << numerator << "/" << denominator;
-    }
+    printValue(this, os);
 }
 
 Value RationalV(int num, int den) {
@@ -176,18 +223,152 @@ void Symbol::show(std::ostream &os) {
 }
 
 Value SymbolV(const std::string &s) {
-    return Value(new Symbol(s));
+    // symbols are interned (per interpreter), so eq? on symbols is a pointer comparison
+    Interpreter &interp = Interpreter::current();
+    std::unordered_map<std::string, Value> &symbol_table = interp.symbols;
+    ParallelGuard guard(interp.tables_lock);
+    auto it = symbol_table.find(s);
+    if (it != symbol_table.end()) {
+        return it->second;
+    }
+    Value sym(new Symbol(s));
+    symbol_table.insert(std::make_pair(s, sym));
+    return sym;
 }
 
 // String
-String::String(const std::string &s) : ValueBase(V_STRING), s(s) {}
+String::String(const std::shared_ptr<const std::string> &b, size_t st, size_t n)
+    : ValueBase(V_STRING), buf(b), start(st), len(n), left(nullptr), right(nullptr),
+      bytes(b->data() + st) {}
+
+String::String(const Value &l, const Value &r)
+    : ValueBase(V_STRING), start(0),
+      len(static_cast<String*>(l.get())->len + static_cast<String*>(r.get())->len),
+      left(l), right(r), bytes(nullptr) {}
+
+String::~String() {
+    // 与 Pair 相同：逐层摘下独占的子绳，避免长链递归析构
+    if (!left.ptr) {
+        return;
+    }
+    std::vector<std::shared_ptr<ValueBase>> pending;
+    pending.push_back(std::move(left.ptr));
+    pending.push_back(std::move(right.ptr));
+    while (!pending.empty()) {
+        std::shared_ptr<ValueBase> node = std::move(pending.back());
+        pending.pop_back();
+        if (node.use_count() == 1 && node->v_type == V_STRING) {
+            String *s = static_cast<String*>(node.get());
+            if (s->left.ptr) {
+                pending.push_back(std::move(s->left.ptr));
+                pending.push_back(std::move(s->right.ptr));
+            }
+        }
+    }
+}
+
+// 压平绳时读写其它结点的 left/right/buf，多个 future 同时压平时须串行
+static std::mutex rope_lock;
+
+const char *String::data() {
+    const char *p = bytes.load(std::memory_order_acquire);
+    if (p) {
+        return p;
+    }
+    std::lock_guard<std::mutex> guard(rope_lock);
+    if (left.ptr) { // 绳：按从左到右的顺序收集叶子
+        std::string *out = new std::string;
+        out->reserve(len);
+        std::vector<String*> todo(1, this);
+        while (!todo.empty()) {
+            String *s = todo.back();
+            todo.pop_back();
+            if (s->left.ptr) {
+                todo.push_back(static_cast<String*>(s->right.get()));
+                todo.push_back(static_cast<String*>(s->left.get()));
+            } else {
+                out->append(s->buf->data() + s->start, s->len);
+            }
+        }
+        buf.reset(out);
+        start = 0;
+        std::shared_ptr<ValueBase> l = std::move(left.ptr);
+        std::shared_ptr<ValueBase> r = std::move(right.ptr);
+        bytes.store(buf->data() + start, std::memory_order_release);
+    }
+    return buf->data() + start;
+}
 
+std::string String::str() {
+    const char *p = data();
+    return std::string(p, len);
+}
+
+// write 的形式：" 与 \ 加反斜杠，控制字符写成 \n \t \r 或 \xHH;，读回来还是同一个字符串
 void String::show(std::ostream &os) {
-    os << "\"" << s << "\"";
+    const char *p = data();
+    os.put('"');
+    size_t run = 0; // 还没写出的、不需要转义的一段
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        if (c != '"' && c != '\\' && c >= 0x20 && c != 0x7f) {
+            continue;
+        }
+        os.write(p + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\t': os << "\\t"; break;
+            case '\r': os << "\\r"; break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                char esc[6] = {'\\', 'x', hex[c >> 4], hex[c & 15], ';', 0};
+                os.write(esc, 5);
+            }
+        }
+    }
+    os.write(p + run, len - run);
+    os.put('"');
 }
 
 Value StringV(const std::string &s) {
-    return Value(new String(s));
+    return Value(new String(std::make_shared<const std::string>(s), 0, s.size()));
+}
+
+Value StringV(const std::shared_ptr<const std::string> &buf, size_t start, size_t len) {
+    return Value(new String(buf, start, len));
+}
+
+bool stringEqual(String *a, String *b) {
+    return a->len == b->len && (a == b || bytesEqual(a->data(), b->data(), a->len));
+}
+
+int stringCompare(String *a, String *b) { // 按无符号字节的字典序
+    size_t n = a->len < b->len ? a->len : b->len;
+    int c = memcmp(a->data(), b->data(), n);
+    if (c != 0) {
+        return c;
+    }
+    return a->len < b->len ? -1 : (a->len > b->len ? 1 : 0);
+}
+
+Value StringAppendV(const Value &a, const Value &b) {
+    String *sa = static_cast<String*>(a.get());
+    String *sb = static_cast<String*>(b.get());
+    if (sb->len == 0) {
+        return a;
+    }
+    if (sa->len == 0) {
+        return b;
+    }
+    if (sa->len + sb->len <= 64) { // 短串直接拼接，不值得建绳节点
+        std::string *out = new std::string(sa->data(), sa->len);
+        out->append(sb->data(), sb->len);
+        return StringV(std::shared_ptr<const std::string>(out), 0, out->size());
+    }
+    return Value(new String(a, b));
 }
 
 // ============================================================================
@@ -201,10 +382,6 @@ void Null::show(std::ostream &os) {
     os << "()";
 }
 
-void Null::showCdr(std::ostream &os) {
-    os << ')';
-}
-
 Value NullV() {
     return Value(new Null());
 }
@@ -229,13 +406,16 @@ Pair::Pair(const Value &car, const Value &cdr)
     : ValueBase(V_PAIR), car(car), cdr(cdr) {}
 
 void Pair::show(std::ostream &os) {
-    os << '(' << car;
-    cdr->showCdr(os);
+    printValue(this, os);
 }
 
-void Pair::showCdr(std::ostream &os) {
-    os << ' ' << car;
-    cdr->showCdr(os);
+Pair::~Pair() {
+    // 逐个释放独占的 cdr 链，长表析构时不再按长度递归
+    std::shared_ptr<ValueBase> next = std::move(cdr.ptr);
+    while (next && next.use_count() == 1 && next->v_type == V_PAIR) {
+        std::shared_ptr<ValueBase> after = std::move(static_cast<Pair*>(next.get())->cdr.ptr);
+        next = std::move(after);
+    }
 }
 
 Value PairV(const Value &car, const Value &cdr) {
@@ -244,16 +424,223 @@ Value PairV(const Value &car, const Value &cdr) {
 
 // Procedure
 Procedure::Procedure(const std::vector<std::string> &xs, const Expr &e, const Assoc &env)
-    : ValueBase(V_PROC), parameters(xs), e(e), env(env) {}
+    : ValueBase(V_PROC), parameters(xs), e(e), env(env), is_primitive(false), name(nullptr) {}
 
 void Procedure::show(std::ostream &os) {
     os << "#<procedure>";
 }
 
+// Future
+Future::Future(const std::function<Value()> &w, const Value &out)
+    : ValueBase(V_FUTURE), state(PENDING), work(w), output(out), result(nullptr), failed(false) {}
+
+void Future::show(std::ostream &os) {
+    os << "#<future>";
+}
+
+// Channel
+Channel::Channel(size_t n) : ValueBase(V_CHANNEL), capacity(n) {}
+
+void Channel::show(std::ostream &os) {
+    os << "#<channel>";
+}
+
 Value ProcedureV(const std::vector<std::string> &xs, const Expr &e, const Assoc &env) {
     return Value(new Procedure(xs, e, env));
 }
 
+// ============================================================================
+// Persistent Collections Implementation
+// ============================================================================
+
+// HashMap
+HashMap::HashMap(const std::shared_ptr<HamtNode> &root, size_t count, unsigned long long edit)
+    : ValueBase(V_HASHMAP), root(root), count(count), edit(edit) {}
+
+void HashMap::show(std::ostream &os) {
+    printValue(this, os);
+}
+
+Value HashMapV(const std::shared_ptr<HamtNode> &root, size_t count, unsigned long long edit) {
+    return Value(new HashMap(root, count, edit));
+}
+
+// PVector
+PVector::PVector(size_t cnt, int shift, const std::shared_ptr<PVecNode> &root,
+                 const std::shared_ptr<PVecNode> &tail, unsigned long long edit)
+    : ValueBase(V_PVECTOR), cnt(cnt), shift(shift), root(root), tail(tail), edit(edit) {}
+
+void PVector::show(std::ostream &os) {
+    printValue(this, os);
+}
+
+Value PVectorV(size_t cnt, int shift, const std::shared_ptr<PVecNode> &root,
+               const std::shared_ptr<PVecNode> &tail, unsigned long long edit) {
+    return Value(new PVector(cnt, shift, root, tail, edit));
+}
+
+Value EmptyPVectorV() {
+    return PVectorV(0, 5, std::shared_ptr<PVecNode>(new PVecNode(0)),
+                    std::shared_ptr<PVecNode>(new PVecNode(0)), 0);
+}
+
+// ============================================================================
+// Ports Implementation
+// ============================================================================
+
+static const size_t PORT_BUFFER_SIZE = 1 << 16;
+
+PortStreamBuf::PortStreamBuf(OutputPort *p) : port(p) {}
+
+PortStreamBuf::int_type PortStreamBuf::overflow(int_type c) {
+    if (c != traits_type::eof()) {
+        port->put(static_cast<char>(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize PortStreamBuf::xsputn(const char *s, std::streamsize n) {
+    port->write(s, static_cast<size_t>(n));
+    return n;
+}
+
+OutputPort::OutputPort(int f) : ValueBase(V_OUTPUT_PORT), fd(f), sbuf(this), os(&sbuf) {
+    if (fd >= 0) {
+        buf.reserve(PORT_BUFFER_SIZE);
+    }
+}
+
+OutputPort::~OutputPort() {
+    flush();
+}
+
+void OutputPort::write(const char *s, size_t n) {
+    buf.append(s, n);
+    if (fd >= 0 && buf.size() >= PORT_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void OutputPort::put(char c) {
+    buf.push_back(c);
+    if (fd >= 0 && buf.size() >= PORT_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void OutputPort::flush() {
+    if (fd < 0) {
+        return;
+    }
+    size_t done = 0;
+    while (done < buf.size()) {
+        ssize_t n = ::write(fd, buf.data() + done, buf.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // 输出端已关闭，丢弃剩余内容
+        }
+        done += static_cast<size_t>(n);
+    }
+    buf.clear();
+}
+
+void OutputPort::show(std::ostream &os) {
+    os << "#<output-port>";
+}
+
+Value OutputPortV(int fd) {
+    return Value(new OutputPort(fd));
+}
+
+static const size_t MMAP_THRESHOLD = 1 << 16;
+
+InputPort::InputPort() : ValueBase(V_INPUT_PORT), data(""), size(0), pos(0), map(nullptr), closed(false) {}
+
+InputPort::~InputPort() {
+    close();
+}
+
+void InputPort::close() {
+    if (map != nullptr) {
+        munmap(map, size);
+        map = nullptr;
+    }
+    buf.clear();
+    data = "";
+    size = pos = 0;
+    closed = true;
+}
+
+void InputPort::show(std::ostream &os) {
+    os << "#<input-port>";
+}
+
+Value OpenInputFileV(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RuntimeError("Cannot open input file: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw RuntimeError("Cannot open input file: " + path);
+    }
+    InputPort *port = new InputPort();
+    Value result(port);
+    size_t len = static_cast<size_t>(st.st_size);
+    if (len >= MMAP_THRESHOLD) {
+        void *m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED) {
+            madvise(m, len, MADV_SEQUENTIAL);
+            port->map = m;
+            port->data = static_cast<const char*>(m);
+            port->size = len;
+        }
+    }
+    if (port->map == nullptr) { // 小文件，或 mmap 失败时直接读入
+        char chunk[1 << 14];
+        ssize_t n;
+        while ((n = read(fd, chunk, sizeof(chunk))) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ::close(fd);
+                throw RuntimeError("Cannot read input file: " + path);
+            }
+            port->buf.append(chunk, static_cast<size_t>(n));
+        }
+        port->data = port->buf.data();
+        port->size = port->buf.size();
+    }
+    ::close(fd);
+    return result;
+}
+
+EofObject::EofObject() : ValueBase(V_EOF) {}
+
+void EofObject::show(std::ostream &os) {
+    os << "#<eof>";
+}
+
+Value EofV() {
+    static Value eof(new EofObject());
+    return eof;
+}
+
+Value &commandLine() {
+    return Interpreter::current().command_line;
+}
+
+Value stdoutPort() {
+    return Interpreter::current().out;
+}
+
+Value &currentOutputPort() {
+    if (task_output != nullptr) {
+        return *task_output;
+    }
+    return Interpreter::current().current_out;
+}
+
 // ============================================================================
 // Utility Functions Implementation
 // ============================================================================
@@ -11,23 +11,61 @@
 
 #include "Def.hpp"
 #include "expr.hpp"
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <cstring>
+#include <deque>
 #include <vector>
+#include <string>
+#include <ostream>
+#include <streambuf>
 
 // ============================================================================
 // Base classes and smart pointer wrappers
 // ============================================================================
 
+/**
+ * @brief Tag of the task the calling thread is running, stamped on new
+ *        values and bindings (see parallel.hpp)
+ */
+extern thread_local unsigned task_owner;
+
+/**
+ * @brief Identity of the stack the calling thread evaluates on: nullptr for
+ *        the interpreter's own stack, else the running future or green thread
+ */
+extern thread_local const void *stack_segment;
+
+/**
+ * @brief Lowest address evaluation may push the calling thread's current
+ *        stack to; a procedure call below it raises "Recursion too deep"
+ *
+ * Set from the thread's stack bounds by initStackLimit() (InterpreterScope
+ * calls it), and to the task's own stack while a green thread runs.
+ * STACK_RESERVE bytes stay free for the primitive, printing and unwinding
+ * work that happens past the last check.
+ */
+extern thread_local const char *stack_limit;
+const size_t STACK_RESERVE = size_t(256) << 10;
+void initStackLimit();
+
+/**
+ * @brief While set (e.g. by a timer signal handler), every procedure call
+ *        raises RuntimeError; whoever sets it clears it again
+ */
+extern volatile bool eval_interrupt;
+
 /**
  * @brief Base class for all values in the Scheme interpreter
  */
 struct ValueBase {
     ValueType v_type;
+    unsigned owner;     ///< task_owner when allocated
     ValueBase(ValueType);
     virtual void show(std::ostream &) = 0;
-    virtual void showCdr(std::ostream &);
-    virtual ~ValueBase() = default;
+    virtual ~ValueBase();   ///< Counts the value as freed (stats.hpp)
 };
 
 /**
@@ -42,6 +80,35 @@ struct Value {
     ValueBase* get() const;
 };
 
+/**
+ * @brief The call/ec a continuation belongs to
+ */
+struct ContinuationFrame {
+    bool live;                  ///< The call/ec has not returned yet
+    const void *segment;        ///< stack_segment of the call/ec
+    Value value;                ///< Argument of the continuation while escaping
+    ContinuationFrame();
+};
+
+/**
+ * @brief Frame a continuation is escaping to, nullptr when none is
+ *
+ * Calling a continuation stores its argument in the frame, sets
+ * escaping_frame and returns EscapeV(). Evaluator functions hand that
+ * marker straight back to their caller until the call/ec of the frame turns
+ * it into the argument, so an escape costs one compare per pending frame.
+ * C++ code that cannot return early (sort's comparator, native callbacks)
+ * calls throwIfEscape() instead; call/ec catches that as well.
+ */
+extern thread_local ContinuationFrame *escaping_frame;
+extern ValueBase *const escape_marker;
+Value EscapeV();
+void throwIfEscape(const Value &);
+
+inline bool isEscape(const Value &v) {
+    return v.ptr.get() == escape_marker;
+}
+
 // ============================================================================
 // Environment (Association Lists)
 // ============================================================================
@@ -64,7 +131,9 @@ struct AssocList {
     std::string x;      ///< Variable name
     Value v;            ///< Variable value
     Assoc next;         ///< Next binding in the chain
+    unsigned owner;     ///< task_owner when bound
     AssocList(const std::string &, const Value &, Assoc &);
+    ~AssocList();
 };
 
 // Environment operations
@@ -118,7 +187,7 @@ struct Boolean : ValueBase {
 Value BooleanV(bool);
 
 /**
- * @brief Symbol value
+ * @brief Symbol value (interned: equal names share one Symbol object)
  */
 struct Symbol : ValueBase {
     std::string s;
@@ -128,14 +197,34 @@ struct Symbol : ValueBase {
 Value SymbolV(const std::string &);
 
 /**
- * @brief String value
+ * @brief String value (immutable)
+ *
+ * A flat string is the slice [start, start + len) of a shared byte buffer
+ * that is never modified, so literals, copies and substrings share bytes.
+ * string-append builds a rope node instead (left/right set, buf null); its
+ * bytes are gathered into a fresh buffer the first time they are needed.
+ * bytes is set once the string is flat, so data() is safe to call from
+ * several futures at once.
  */
 struct String : ValueBase {
-    std::string s;
-    String(const std::string &);
+    std::shared_ptr<const std::string> buf;  ///< Shared bytes, nullptr while a rope
+    size_t start;                            ///< Offset of the slice in buf
+    size_t len;                              ///< Length in bytes
+    Value left;                              ///< Rope children, nullptr once flat
+    Value right;
+    std::atomic<const char*> bytes;          ///< buf->data() + start, nullptr while a rope
+    String(const std::shared_ptr<const std::string> &, size_t, size_t);
+    String(const Value &, const Value &);
+    virtual ~String();
+    const char *data();                      ///< Contiguous bytes; flattens a rope
+    std::string str();
     virtual void show(std::ostream &) override;
 };
 Value StringV(const std::string &);
+Value StringV(const std::shared_ptr<const std::string> &, size_t, size_t);
+Value StringAppendV(const Value &, const Value &);
+bool stringEqual(String *, String *);
+int stringCompare(String *, String *);
 
 // ============================================================================
 // Special Value Types
@@ -147,7 +236,6 @@ Value StringV(const std::string &);
 struct Null : ValueBase {
     Null();
     virtual void show(std::ostream &) override;
-    virtual void showCdr(std::ostream &) override;
 };
 Value NullV();
 
@@ -171,27 +259,222 @@ struct Pair : ValueBase {
     Value car;  ///< First element
     Value cdr;  ///< Second element
     Pair(const Value &, const Value &);
+    virtual ~Pair();
     virtual void show(std::ostream &) override;
-    virtual void showCdr(std::ostream &) override;
 };
 Value PairV(const Value &, const Value &);
 
 /**
  * @brief Procedure (function) value
+ *
+ * Primitives referenced as values (e.g. passing car to map) are Procedures
+ * whose body is the primitive's own Unary/Binary/Variadic node; they are
+ * marked so applyProcedure can call evalRator without building an env.
  */
 struct Procedure : ValueBase {
     std::vector<std::string> parameters;   ///< Parameter names
     Expr e;                                ///< Function body expression
     Assoc env;                             ///< Closure environment
+    bool is_primitive;                     ///< Body is a primitive's evalRator
+    const std::string *name;               ///< Name shown by the profiler, nullptr if anonymous
     Procedure(const std::vector<std::string> &, const Expr &, const Assoc &);
     virtual void show(std::ostream &) override;
 };
 Value ProcedureV(const std::vector<std::string> &, const Expr &, const Assoc &);
 
+struct GreenTask;
+
+/**
+ * @brief FIFO channel between green threads (see green.hpp)
+ */
+struct Channel : ValueBase {
+    std::deque<Value> items;
+    size_t capacity;                    ///< Most items held, 0 for no limit
+    std::deque<GreenTask*> getters;     ///< Tasks waiting for an item
+    std::deque<GreenTask*> putters;     ///< Tasks waiting for room
+    Channel(size_t);
+    virtual void show(std::ostream &) override;
+};
+
+/**
+ * @brief Result of (future expr), or one slice of a pmap
+ *
+ * work runs at most once, on a pool thread or on the thread that touches
+ * the future first; see parallel.hpp.
+ */
+struct Future : ValueBase {
+    enum State { PENDING, RUNNING, DONE };
+    std::atomic<int> state;
+    std::function<Value()> work;       ///< Computes the result; released once run
+    Value output;                      ///< (current-output-port) of the spawner
+    Value result;                      ///< Valid once DONE and !failed
+    bool failed;                       ///< work threw; message says why
+    std::string message;
+    Future(const std::function<Value()> &, const Value &);
+    virtual void show(std::ostream &) override;
+};
+
+/**
+ * @brief Calls a procedure value on already evaluated arguments
+ *
+ * Shared by Apply::eval and every primitive that takes a procedure argument.
+ * args may be reused by the caller for the next call.
+ */
+Value applyProcedure(const Value &, const std::vector<Value> &);
+
+// ============================================================================
+// Persistent Collections (see persistent.hpp for the trie nodes)
+// ============================================================================
+
+struct HamtNode;
+struct PVecNode;
+
+/**
+ * @brief Persistent hash map (hash array mapped trie)
+ *
+ * A non-zero edit id marks the map as transient: the *! operations then
+ * update it in place until persistent! freezes it again.
+ */
+struct HashMap : ValueBase {
+    std::shared_ptr<HamtNode> root;   ///< Trie root, nullptr when empty
+    size_t count;                     ///< Number of keys
+    unsigned long long edit;          ///< Transient edit id, 0 if persistent
+    HashMap(const std::shared_ptr<HamtNode> &, size_t, unsigned long long);
+    virtual void show(std::ostream &) override;
+};
+Value HashMapV(const std::shared_ptr<HamtNode> &, size_t, unsigned long long);
+
+/**
+ * @brief Persistent vector (32-way radix-balanced trie plus tail buffer)
+ */
+struct PVector : ValueBase {
+    size_t cnt;                        ///< Number of elements
+    int shift;                         ///< Bit shift of the root level
+    std::shared_ptr<PVecNode> root;    ///< Trie holding all but the tail
+    std::shared_ptr<PVecNode> tail;    ///< Last (up to 32) elements
+    unsigned long long edit;           ///< Transient edit id, 0 if persistent
+    PVector(size_t, int, const std::shared_ptr<PVecNode> &,
+            const std::shared_ptr<PVecNode> &, unsigned long long);
+    virtual void show(std::ostream &) override;
+};
+Value PVectorV(size_t, int, const std::shared_ptr<PVecNode> &,
+               const std::shared_ptr<PVecNode> &, unsigned long long);
+Value EmptyPVectorV();
+
+// ============================================================================
+// Ports
+// ============================================================================
+
+struct OutputPort;
+
+/**
+ * @brief streambuf adapter so show() methods can print into an OutputPort
+ */
+struct PortStreamBuf : std::streambuf {
+    OutputPort *port;
+    PortStreamBuf(OutputPort *);
+protected:
+    virtual int_type overflow(int_type) override;
+    virtual std::streamsize xsputn(const char *, std::streamsize) override;
+};
+
+/**
+ * @brief Buffered output port
+ *
+ * A file port (fd >= 0) collects output in buf and hands it to write(2) once
+ * the buffer passes 64 KiB, on flush-output, or when the port is destroyed.
+ * A string port (fd < 0) just keeps everything in buf. While futures run,
+ * writers hold lock (see PortGuard in parallel.hpp).
+ */
+struct OutputPort : ValueBase {
+    int fd;                  ///< Target descriptor, -1 for a string port
+    std::string buf;         ///< Pending (file) or accumulated (string) output
+    PortStreamBuf sbuf;
+    std::ostream os;         ///< Stream view of the port for show()
+    std::mutex lock;
+    OutputPort(int);
+    virtual ~OutputPort();
+    void write(const char *, size_t);
+    void put(char);
+    void flush();
+    virtual void show(std::ostream &) override;
+};
+Value OutputPortV(int);
+
+/**
+ * @brief Input port over the whole contents of a file
+ *
+ * Files of 64 KiB and more are mapped with mmap and read in place; smaller
+ * ones are read into buf. Either way the bytes are data[0, size), and
+ * read-line, read-char and read advance pos over them.
+ */
+struct InputPort : ValueBase {
+    const char *data;   ///< File contents
+    size_t size;
+    size_t pos;         ///< Next unread byte
+    void *map;          ///< mmap'd region, nullptr if the file was read into buf
+    std::string buf;
+    bool closed;
+    InputPort();
+    virtual ~InputPort();
+    void close();
+    virtual void show(std::ostream &) override;
+};
+
+/**
+ * @brief Opens path for reading; throws RuntimeError if it cannot be read
+ */
+Value OpenInputFileV(const std::string &);
+
+/**
+ * @brief The eof object returned by readers at end of input
+ */
+struct EofObject : ValueBase {
+    EofObject();
+    virtual void show(std::ostream &) override;
+};
+Value EofV();
+
+/**
+ * @brief Value of (command-line) of the current interpreter
+ */
+Value &commandLine();
+
+/**
+ * @brief Standard output port of the current interpreter
+ */
+Value stdoutPort();
+
+/**
+ * @brief The port returned by (current-output-port); display and friends
+ *        write here when no port is given
+ */
+Value &currentOutputPort();
+
 // ============================================================================
 // Utility Functions
 // ============================================================================
 
 std::ostream &operator<<(std::ostream &, Value &);
 
+/**
+ * @brief Prints a value without recursion (printer.cpp)
+ *
+ * Lists, hash maps and pvectors that contain themselves are printed with
+ * datum labels (#0=(1 . #0#)); everything else prints as it always has.
+ */
+void printValue(ValueBase *, std::ostream &);
+
+/**
+ * @brief Tells the printer that a pair or transient was modified in place,
+ *        so cycles may exist from now on (in the current interpreter)
+ */
+void noteStructureMutation();
+
+/**
+ * @brief Writes the decimal digits of v to out (at least 21 bytes);
+ *        returns the length
+ */
+size_t formatInt(long long v, char *out);
+
 #endif // VALUE
\ No newline at end of file